@@ -12,6 +12,7 @@ static void DumpXYWaveform(uint32_t resolution, uint32_t undershoot) {
     struct WaveformParams params;
     params.width = resolution;
     params.height = resolution;
+    params.lineRepeats = 1;
     params.resolution = resolution;
     params.zoom = 1;
     params.undershoot = undershoot;
@@ -47,6 +48,7 @@ static void DumpClockWaveform(uint32_t resolution, uint32_t lineDelay) {
     struct WaveformParams WaveformParameters;
     WaveformParameters.width = resolution;
     WaveformParameters.height = resolution;
+    WaveformParameters.lineRepeats = 1;
     WaveformParameters.undershoot = lineDelay;
     WaveformParameters.xOffset = 0;
     WaveformParameters.yOffset = 0;
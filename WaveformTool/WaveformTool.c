@@ -26,6 +26,7 @@ struct Args {
     uint32_t resolution;
     uint32_t width;
     uint32_t height;
+    uint32_t lineRepeats;
     uint32_t xOffset;
     uint32_t yOffset;
     double zoom;
@@ -89,6 +90,7 @@ static void PrintUsage(void) {
         "  --resolution <n>         Scanner resolution\n"
         "  --width <n>              ROI width (default: resolution)\n"
         "  --height <n>             ROI height (default: resolution)\n"
+        "  --line-repeats <n>       Scans of each line (default: 1)\n"
         "  --xoffset <n>            ROI X offset (default: 0)\n"
         "  --yoffset <n>            ROI Y offset (default: 0)\n"
         "  --zoom <f>               Zoom factor (default: 1.0)\n"
@@ -189,6 +191,7 @@ static int ParseTformOffset(const char *str, double *tx, double *ty) {
 static int ParseArgs(int argc, char *argv[], struct Args *args) {
     memset(args, 0, sizeof(*args));
     args->zoom = 1.0;
+    args->lineRepeats = 1;
     args->xformMatrix[0] = 1.0;
     args->xformMatrix[1] = 0.0;
     args->xformMatrix[2] = 0.0;
@@ -243,6 +246,13 @@ static int ParseArgs(int argc, char *argv[], struct Args *args) {
             if (!ParseUint32(argv[++i], "--height", &args->height))
                 return 0;
             args->hasHeight = 1;
+        } else if (strcmp(argv[i], "--line-repeats") == 0 && i + 1 < argc) {
+            if (!ParseUint32(argv[++i], "--line-repeats", &args->lineRepeats))
+                return 0;
+            if (args->lineRepeats < 1) {
+                fprintf(stderr, "Error: --line-repeats must be at least 1\n");
+                return 0;
+            }
         } else if (strcmp(argv[i], "--xoffset") == 0 && i + 1 < argc) {
             if (!ParseUint32(argv[++i], "--xoffset", &args->xOffset))
                 return 0;
@@ -349,6 +359,7 @@ static void PopulateParams(const struct Args *args,
                            struct WaveformParams *params) {
     params->width = args->width;
     params->height = args->height;
+    params->lineRepeats = args->lineRepeats;
     params->resolution = args->resolution;
     params->zoom = args->zoom;
     params->undershoot = args->undershoot;
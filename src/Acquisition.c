@@ -5,19 +5,172 @@
 #include "DAQError.h"
 #include "Detector.h"
 #include "DeviceImplData.h"
+#include "EventQueue.h"
+#include "FrameAveraging.h"
+#include "FrameCompression.h"
+#include "FrameProcessing.h"
+#include "FrameRing.h"
+#include "MotionCorrection.h"
+#include "OpenScanNIDAQ.h"
 #include "ParkUnpark.h"
 #include "Scanner.h"
+#include "TaskDone.h"
 #include "Waveform.h"
 
 #include <NIDAQmx.h>
 #include <OpenScanDeviceLib.h>
+#include <ss8str.h>
 
-#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <Windows.h>
 
+// Move the galvos to the start of the raster and load the raster into the
+// scanner task, unless they are still there with the same raster
+static OScDev_RichError *SetUpScanPlan(OScDev_Device *device,
+                                       OScDev_Acquisition *acq) {
+    struct ScannerConfig *config = &GetImplData(device)->scannerConfig;
+    if (GetImplData(device)->scannerUnparked && config->aoTask &&
+        !config->mustReconfigureTiming && !config->mustRewriteOutput) {
+        // Only the start trigger may need to be changed
+        OScDev_Log_Debug(device, "Scan plan is resident");
+        return SetUpScanner(device, config, acq);
+    }
+
+    // Unpark starts from the last voltages output, which are those of the
+    // previous raster's start if we did not park
+    OScDev_RichError *err = CreateScannerTask(device, config);
+    if (err)
+        return err;
+    err = ConfigureUnparkTiming(device, config, acq);
+    if (err)
+        return err;
+    err = WriteUnparkOutput(device, config, acq);
+    if (err)
+        return err;
+    err = GenerateUnparkOutput(device, config, acq);
+    if (err)
+        return err;
+    GetImplData(device)->scannerUnparked = true;
+
+    return SetUpScanner(device, config, acq);
+}
+
+// Move the galvos from the start of the raster to the park position
+static void ParkScanner(OScDev_Device *device, OScDev_Acquisition *acq) {
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    GetImplData(device)->parkStartXVolts =
+        GetImplData(device)->prevXParkVoltage;
+    GetImplData(device)->parkStartYVolts =
+        GetImplData(device)->prevYParkVoltage;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+
+    struct ScannerConfig *config = &GetImplData(device)->scannerConfig;
+    OScDev_RichError *err = CreateScannerTask(device, config);
+    if (!err)
+        err = ConfigureParkTiming(device, config, acq);
+    if (!err)
+        err = WriteParkOutput(device, config, acq);
+    if (!err)
+        err = GenerateParkOutput(device, config, acq);
+    if (err) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        err = OScDev_Error_Wrap(err, "Failed to park scanner");
+        OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+        OScDev_Log_Error(device, msg);
+        OScDev_Error_Destroy(err);
+    }
+    GetImplData(device)->scannerUnparked = false;
+}
+
+static OScDev_RichError *SetUpClockForAcquisition(OScDev_Device *device,
+                                                  OScDev_Acquisition *acq) {
+    return SetUpClock(device, &GetImplData(device)->clockConfig, acq);
+}
+
+static OScDev_RichError *
+SetUpDetectorForAcquisition(OScDev_Device *device, OScDev_Acquisition *acq) {
+    return SetUpDetector(device, &GetImplData(device)->detectorConfig, acq);
+}
+
+static OScDev_RichError *
+SetUpFrameTriggerForAcquisition(OScDev_Device *device,
+                                OScDev_Acquisition *acq) {
+    (void)acq; // Unused
+    return SetUpFrameTrigger(device, &GetImplData(device)->frameTrigger);
+}
+
+// The clock, detector and scanner are set up independently (each writes its
+// own buffers and commits its own tasks), so they are set up in parallel
+struct SetUpJob {
+    const char *name;
+    OScDev_RichError *(*setUp)(OScDev_Device *, OScDev_Acquisition *);
+    OScDev_Device *device;
+    OScDev_Acquisition *acq;
+    HANDLE thread;
+    OScDev_RichError *err;
+    double seconds;
+};
+
+static DWORD WINAPI RunSetUpJob(void *param) {
+    struct SetUpJob *job = param;
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    job->err = job->setUp(job->device, job->acq);
+    QueryPerformanceCounter(&end);
+    job->seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    return 0;
+}
+
+// Run the jobs, the first on this thread and the others on their own
+// threads, and wait for all of them. The errors are combined in job order,
+// so that the result does not depend on which job failed first: the first
+// error is the cause, and each later one is added as a wrapping message.
+static OScDev_RichError *RunSetUpJobs(OScDev_Device *device,
+                                      struct SetUpJob *jobs, int numJobs) {
+    for (int i = 1; i < numJobs; ++i) {
+        DWORD id;
+        jobs[i].thread = CreateThread(NULL, 0, RunSetUpJob, &jobs[i], 0, &id);
+        if (!jobs[i].thread)
+            RunSetUpJob(&jobs[i]);
+    }
+    if (numJobs > 0)
+        RunSetUpJob(&jobs[0]);
+    for (int i = 1; i < numJobs; ++i) {
+        if (jobs[i].thread) {
+            WaitForSingleObject(jobs[i].thread, INFINITE);
+            CloseHandle(jobs[i].thread);
+            jobs[i].thread = NULL;
+        }
+    }
+
+    OScDev_RichError *err = OScDev_RichError_OK;
+    for (int i = 0; i < numJobs; ++i) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg), "Set up %s in %.3f ms", jobs[i].name,
+                 1e3 * jobs[i].seconds);
+        OScDev_Log_Debug(device, msg);
+        if (!jobs[i].err)
+            continue;
+
+        if (!err) {
+            snprintf(msg, sizeof(msg), "Failed to set up %s", jobs[i].name);
+            err = OScDev_Error_Wrap(jobs[i].err, msg);
+            continue;
+        }
+        char detail[OScDev_MAX_STR_LEN + 1];
+        OScDev_Error_FormatRecursive(jobs[i].err, detail, sizeof(detail));
+        OScDev_Error_Destroy(jobs[i].err);
+        snprintf(msg, sizeof(msg), "Also failed to set up %s: %s",
+                 jobs[i].name, detail);
+        err = OScDev_Error_Wrap(err, msg);
+    }
+    return err;
+}
+
 static OScDev_RichError *SetUpDAQ(OScDev_Device *device) {
     OScDev_Acquisition *acq = GetImplData(device)->acquisition.acquisition;
     double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
@@ -42,6 +195,18 @@ static OScDev_RichError *SetUpDAQ(OScDev_Device *device) {
         yOffset != GetImplData(device)->configuredYOffset) {
         GetImplData(device)->scannerConfig.mustRewriteOutput = true;
     }
+    OScDev_TriggerSource triggerSource;
+    OScDev_Acquisition_GetClockStartTriggerSource(acq, &triggerSource);
+    bool externalTrigger = triggerSource == OScDev_TriggerSource_External;
+    if (externalTrigger != GetImplData(device)->configuredExternalTrigger)
+        GetImplData(device)->scannerConfig.mustReconfigureTrigger = true;
+    OScDev_ClockSource clockSource;
+    OScDev_Acquisition_GetClockSource(acq, &clockSource);
+    bool externalClock = clockSource == OScDev_ClockSource_External;
+    if (externalClock != GetImplData(device)->configuredExternalClock) {
+        GetImplData(device)->clockConfig.mustReconfigureTiming = true;
+        GetImplData(device)->scannerConfig.mustReconfigureTiming = true;
+    }
     if (width != GetImplData(device)->configuredRasterWidth ||
         height != GetImplData(device)->configuredRasterHeight) {
         GetImplData(device)->clockConfig.mustReconfigureTiming = true;
@@ -57,15 +222,52 @@ static OScDev_RichError *SetUpDAQ(OScDev_Device *device) {
 
     OScDev_RichError *err;
 
-    err = SetUpClock(device, &GetImplData(device)->clockConfig, acq);
-    if (err)
-        return err;
     if (!GetImplData(device)->scannerOnly) {
-        err = SetUpDetector(device, &GetImplData(device)->detectorConfig, acq);
+        err = CheckPixelDepthSupported(device);
         if (err)
             return err;
     }
 
+    // Only the AO sample clock follows the external clock into the detector
+    if (externalClock && !GetImplData(device)->scannerOnly &&
+        !GetImplData(device)->detectorOnScannerClock)
+        return OScDev_Error_Create(
+            "An external sample clock requires the detector to run on the "
+            "scanner clock");
+
+    // Read by the set-up jobs
+    GetImplData(device)->configuredExternalTrigger = externalTrigger;
+    GetImplData(device)->configuredExternalClock = externalClock;
+
+    // The tasks are restarted between frames, which must fit in the interval
+    struct FrameTrigger *trig = &GetImplData(device)->frameTrigger;
+    if (trig->intervalSec > 0.0) {
+        struct WaveformParams params;
+        SetWaveformParamsFromDevice(device, &params, acq);
+        double frameSec = GetScannerWaveformSize(&params) / pixelRateHz;
+        if (trig->intervalSec <= frameSec)
+            return OScDev_Error_Create(
+                "Frame interval must be longer than the frame scan time");
+    }
+
+    // After this, starting the acquisition only starts the tasks
+    struct SetUpJob jobs[4] = {
+        {"clock", SetUpClockForAcquisition, device, acq},
+        {"detector", SetUpDetectorForAcquisition, device, acq},
+        {"scanner", SetUpScanPlan, device, acq},
+    };
+    int numJobs = 3;
+    if (GetImplData(device)->scannerOnly) {
+        jobs[1] = jobs[2];
+        numJobs = 2;
+    }
+    if (trig->intervalSec > 0.0)
+        jobs[numJobs++] = (struct SetUpJob){
+            "frame trigger", SetUpFrameTriggerForAcquisition, device, acq};
+    err = RunSetUpJobs(device, jobs, numJobs);
+    if (err)
+        return err;
+
     pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
     resolution = OScDev_Acquisition_GetResolution(acq);
     zoomFactor = OScDev_Acquisition_GetZoomFactor(acq);
@@ -78,6 +280,14 @@ static OScDev_RichError *SetUpDAQ(OScDev_Device *device) {
     GetImplData(device)->configuredRasterWidth = width;
     GetImplData(device)->configuredRasterHeight = height;
 
+    if (!GetImplData(device)->scannerOnly) {
+        err = ResetFrameAverager(&GetImplData(device)->frameAverager,
+                                 GetNumberOfEnabledChannels(device),
+                                 (size_t)width * height);
+        if (err)
+            return OScDev_Error_Wrap(err, "Failed to set up frame averaging");
+    }
+
     return OScDev_RichError_OK;
 }
 
@@ -101,35 +311,48 @@ static OScDev_RichError *StartScan(OScDev_Device *device) {
     return OScDev_RichError_OK;
 }
 
+// Wait for the scanner task to signal that it is done, or for the
+// acquisition to be aborted (*interrupted); add the time waited to
+// *waitCounts
 static OScDev_RichError *WaitScanToFinish(OScDev_Device *device,
-                                          OScDev_Acquisition *acq) {
-    double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
-    struct WaveformParams parameters;
-    SetWaveformParamsFromDevice(device, &parameters, acq);
-
+                                          DWORD timeoutMs,
+                                          LONGLONG *waitCounts,
+                                          bool *interrupted) {
     // When scanRate is low, it takes longer to finish generating scan
     // waveform. Since acquisition only takes a portion of the total scan time,
     // it may occur that waveform task is stopped right after acquisition is
     // done but the waveform generation is not done yet -- thus nierr 200010:
     // "Finite acquisition or generation has been stopped before the requested
-    // number of samples were acquired or generated." So need to wait some
-    // miliseconds till waveform generation is done before stop the task.
-    double yRetraceTime =
-        GetScannerWaveformSizeAfterLastPixel(&parameters) / pixelRateHz;
-    double estFrameTime = GetScannerWaveformSize(&parameters) / pixelRateHz;
-    double secondsToWait =
-        GetImplData(device)->scannerOnly ? estFrameTime : yRetraceTime;
+    // number of samples were acquired or generated." So the tasks must not be
+    // stopped until the scanner's done event has fired. (The clock DO task is
+    // retriggerable and never finishes on its own, so it has no done event;
+    // it is stopped together with the scanner.)
+    struct TaskDoneSignal *signals[] = {
+        &GetImplData(device)->scannerConfig.aoDone,
+    };
+
+    LARGE_INTEGER freq, waitStart, waitEnd;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&waitStart);
+    OScDev_RichError *err = WaitForTaskDoneSignals(
+        signals, 1, timeoutMs, GetImplData(device)->acquisition.abortEvent,
+        interrupted);
+    QueryPerformanceCounter(&waitEnd);
+    *waitCounts += waitEnd.QuadPart - waitStart.QuadPart;
+    if (err)
+        return OScDev_Error_Wrap(err, "Failed to wait for scan to finish");
+    if (*interrupted)
+        return OScDev_RichError_OK;
+
     char msg[OScDev_MAX_STR_LEN + 1];
-    snprintf(msg, OScDev_MAX_STR_LEN, "Wait %f s for scan to finish...",
-             secondsToWait);
+    snprintf(msg, OScDev_MAX_STR_LEN, "Scan finished after %.3f ms wait",
+             1e3 * (waitEnd.QuadPart - waitStart.QuadPart) / freq.QuadPart);
     OScDev_Log_Debug(device, msg);
-    Sleep((DWORD)ceil(secondsToWait * 1000));
-
     return OScDev_RichError_OK;
 }
 
-static OScDev_RichError *StopScan(OScDev_Device *device,
-                                  OScDev_Acquisition *acq) {
+// Stop the tasks after WaitScanToFinish()
+static OScDev_RichError *StopScan(OScDev_Device *device) {
     OScDev_RichError *err, *lastErr = OScDev_RichError_OK;
 
     // Stopping a task may return an error if it failed, so make sure to stop
@@ -141,17 +364,6 @@ static OScDev_RichError *StopScan(OScDev_Device *device,
             lastErr = err;
     }
 
-    // When scanRate is low, it takes longer to finish generating scan
-    // waveform. Since acquisition only takes a portion of the total scan time,
-    // it may occur that waveform task is stopped right after acquisition is
-    // done but the waveform generation is not done yet -- thus nierr 200010:
-    // "Finite acquisition or generation has been stopped before the requested
-    // number of samples were acquired or generated." So need to wait some
-    // miliseconds till waveform generation is done before stop the task.
-    err = WaitScanToFinish(device, acq);
-    if (err)
-        return err;
-
     err = StopClock(&GetImplData(device)->clockConfig);
     if (err)
         lastErr = err;
@@ -163,89 +375,680 @@ static OScDev_RichError *StopScan(OScDev_Device *device,
     return lastErr;
 }
 
+// Stop the tasks in the middle of a frame, leaving prevX/YParkVoltage at the
+// voltages last output so that the scanner can be parked from there. Errors
+// are only logged, as the tasks may well have failed already.
+static void AbortScan(OScDev_Device *device) {
+    OScDev_RichError *errs[3] = {OScDev_RichError_OK};
+    errs[0] = AbortScanner(&GetImplData(device)->scannerConfig,
+                           &GetImplData(device)->prevXParkVoltage,
+                           &GetImplData(device)->prevYParkVoltage);
+    errs[1] = StopClock(&GetImplData(device)->clockConfig);
+    if (!GetImplData(device)->scannerOnly)
+        errs[2] = StopDetector(&GetImplData(device)->detectorConfig);
+
+    for (int i = 0; i < 3; ++i) {
+        if (errs[i]) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            errs[i] = OScDev_Error_Wrap(errs[i], "While aborting scan");
+            OScDev_Error_FormatRecursive(errs[i], msg, sizeof(msg));
+            OScDev_Log_Debug(device, msg);
+            OScDev_Error_Destroy(errs[i]);
+        }
+    }
+
+    char msg[OScDev_MAX_STR_LEN + 1];
+    snprintf(msg, sizeof(msg), "Scan aborted at (%.3f V, %.3f V)",
+             GetImplData(device)->prevXParkVoltage,
+             GetImplData(device)->prevYParkVoltage);
+    OScDev_Log_Debug(device, msg);
+}
+
+// State of partial frame delivery during one frame
+struct LineStreamState {
+    OScNIDAQ_LinesCallback callback; // NULL if not streaming
+    void *callbackData;
+    LONGLONG intervalCounts; // Minimum time between deliveries
+    LONGLONG lastDeliveryCounts;
+    uint32_t linesDelivered;
+    uint32_t linesFilled;
+};
+
+static void StartLineStream(OScDev_Device *device,
+                            struct LineStreamState *stream) {
+    memset(stream, 0, sizeof(*stream));
+    if (GetImplData(device)->scannerOnly ||
+        !GetImplData(device)->streamPartialFrames)
+        return;
+
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    stream->callback = GetImplData(device)->linesCallback;
+    stream->callbackData = GetImplData(device)->linesCallbackData;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    stream->intervalCounts = (LONGLONG)(
+        1e-3 * GetImplData(device)->lineStreamingIntervalMs * freq.QuadPart);
+    stream->lastDeliveryCounts = now.QuadPart;
+}
+
+// Deliver the lines filled so far, unless we delivered too recently. If
+// 'flush' is true, deliver regardless of the interval.
+static void DeliverLines(OScDev_Device *device,
+                         struct LineStreamState *stream, bool flush) {
+    if (!stream->callback || stream->linesFilled <= stream->linesDelivered)
+        return;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    if (!flush &&
+        now.QuadPart - stream->lastDeliveryCounts < stream->intervalCounts)
+        return;
+
+    uint32_t pixelsPerLine = GetImplData(device)->configuredRasterWidth;
+    uint32_t firstLine = stream->linesDelivered;
+    uint32_t numLines = stream->linesFilled - firstLine;
+    int nChans = GetNumberOfEnabledChannels(device);
+    for (int ch = 0; ch < nChans; ++ch) {
+        const uint16_t *pixels =
+            (const uint16_t *)GetImplData(device)->frameBuffers[ch] +
+            (size_t)firstLine * pixelsPerLine;
+        stream->callback(ch, firstLine, numLines, pixels,
+                         stream->callbackData);
+    }
+    stream->linesDelivered = stream->linesFilled;
+    stream->lastDeliveryCounts = now.QuadPart;
+}
+
+static void ReportMotionShift(OScDev_Device *device,
+                              const struct MotionShift *shift) {
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    GetImplData(device)->lastMotionShift = *shift;
+    OScNIDAQ_MotionShiftCallback callback =
+        GetImplData(device)->motionShiftCallback;
+    void *callbackData = GetImplData(device)->motionShiftCallbackData;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+
+    if (callback)
+        callback(shift->frame, shift->dx, shift->dy, shift->peak,
+                 callbackData);
+}
+
+// Wait for the shift of the frame being registered, if any, and report it;
+// return false if no frame was being registered
+static bool CollectMotionShiftAndReport(OScDev_Device *device,
+                                        struct MotionShift *shift) {
+    if (!CollectMotionShift(&GetImplData(device)->motionCorrection, shift))
+        return false;
+    ReportMotionShift(device, shift);
+    return true;
+}
+
+// Compress each channel of the frame about to be delivered, and pass the
+// result to the file and callback
+static void DeliverCompressedFrames(OScDev_Device *device,
+                                    void *const *buffers, uint32_t frame) {
+    struct FrameCompressor *comp = &GetImplData(device)->frameCompressor;
+
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    OScNIDAQ_CompressedFrameCallback callback =
+        GetImplData(device)->compressedFrameCallback;
+    void *callbackData = GetImplData(device)->compressedFrameCallbackData;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    size_t rawSize = sizeof(uint16_t) * comp->width * comp->height;
+    double ratio = 0.0, mbPerSecond = 0.0;
+    int nChans = GetNumberOfEnabledChannels(device);
+    for (int ch = 0; ch < nChans; ++ch) {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        CompressFrame(comp, buffers[ch], frame, ch);
+        QueryPerformanceCounter(&end);
+        double seconds =
+            (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+        ratio = (double)rawSize / comp->outputSize;
+        mbPerSecond = seconds > 0.0 ? 1e-6 * rawSize / seconds : 0.0;
+
+        OScDev_RichError *err = WriteCompressedFrame(comp);
+        if (err) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+            OScDev_Log_Error(device, msg);
+            OScDev_Error_Destroy(err);
+        }
+        if (callback)
+            callback(ch, frame, comp->output, comp->outputSize, ratio,
+                     mbPerSecond, callbackData);
+    }
+
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    GetImplData(device)->lastCompressionRatio = ratio;
+    GetImplData(device)->lastCompressionMBPerSecond = mbPerSecond;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+}
+
+// What became of an acquired frame
+enum FrameOutcome {
+    FrameOutcome_Delivered,
+    FrameOutcome_Held,      // Accumulated by frame averaging
+    FrameOutcome_Discarded, // Incomplete after a detector error or timeout
+    FrameOutcome_Aborted,   // Interrupted by a stop request
+};
+
+// Count the detector errors of the frame just acquired
+static void CountFrameErrors(OScDev_Device *device,
+                             const struct OScNIDAQ_FrameMetadata *metadata,
+                             uint64_t samplesPerFrame, bool discarded) {
+    struct DeviceImplData *devData = GetImplData(device);
+    uint64_t lost = 0;
+    if (discarded && samplesPerFrame > metadata->samplesRead)
+        lost = samplesPerFrame - metadata->samplesRead;
+
+    EnterCriticalSection(&devData->acquisition.mutex);
+    if (metadata->flags & OSCNIDAQ_FRAME_OVERRUN)
+        ++devData->overrunFrames;
+    if (metadata->flags & OSCNIDAQ_FRAME_SHORT_READ)
+        ++devData->shortReadFrames;
+    if (discarded)
+        ++devData->discardedFrames;
+    devData->samplesLost += lost;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+
+    if (discarded) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg),
+                 "Discarded frame %u after detector error (%llu samples "
+                 "lost)",
+                 metadata->frame, (unsigned long long)lost);
+        OScDev_Log_Error(device, msg);
+    }
+}
+
+// Correct, average, compress and deliver a frame whose acquisition is
+// complete. 'buffers' holds the frame of each enabled channel: the device's
+// frameBuffers on the acquisition thread, or the processing stage's buffers
+// (which may be exchanged) if 'pipelined' is true. Return false if the frame
+// was not delivered: held by frame averaging, or packed with no ring to
+// publish it to.
+static bool ProcessFrame(OScDev_Device *device, void **buffers,
+                         const struct OScNIDAQ_FrameMetadata *metadata,
+                         bool pipelined) {
+    struct MotionCorrection *motion = &GetImplData(device)->motionCorrection;
+    struct MotionShift shift;
+    int nChans = GetNumberOfEnabledChannels(device);
+
+    // In the pipeline, the previous frame's shift (if not applied) is
+    // reported when the next frame reaches this stage
+    if (pipelined && motion->active) {
+        CollectMotionShiftAndReport(device, &shift);
+        SubmitMotionFrame(motion, buffers[motion->channel], metadata->frame);
+    }
+
+    if (motion->applyShift && CollectMotionShiftAndReport(device, &shift)) {
+        for (int ch = 0; ch < nChans; ++ch)
+            ApplyMotionShift(motion, buffers[ch], &shift);
+    }
+
+    if (!AccumulateFrame(&GetImplData(device)->frameAverager,
+                         (uint16_t *const *)buffers))
+        return false;
+
+    EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+    OScNIDAQ_FrameMetadataCallback metadataCallback =
+        GetImplData(device)->frameMetadataCallback;
+    void *metadataCallbackData =
+        GetImplData(device)->frameMetadataCallbackData;
+    LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+
+    struct FrameRing *ring = &GetImplData(device)->frameRing;
+    if (ring->active)
+        PublishRingFrame(ring, metadata);
+
+    struct FrameCompressor *comp = &GetImplData(device)->frameCompressor;
+    if (comp->active) {
+        DeliverCompressedFrames(device, buffers, metadata->frame);
+        if (!comp->deliverRawFrames)
+            return true;
+    }
+
+    // Packed frames are only published to the ring
+    if (GetImplData(device)->pixelDepth == PixelDepth_12BitPacked)
+        return ring->active;
+
+    struct FrameDeliveryQueue *queue = &GetImplData(device)->frameDelivery;
+    if (queue->active) {
+        // Our own buffers can be handed over, but ring slots cannot
+        if (ring->active) {
+            QueueFrame(queue, buffers, false, metadata, metadataCallback,
+                       metadataCallbackData);
+        } else if (pipelined) {
+            QueueFrame(queue, buffers, true, metadata, metadataCallback,
+                       metadataCallbackData);
+        } else {
+            QueueFrame(queue, GetImplData(device)->ownedFrameBuffers, true,
+                       metadata, metadataCallback, metadataCallbackData);
+            memcpy(GetImplData(device)->frameBuffers,
+                   GetImplData(device)->ownedFrameBuffers,
+                   sizeof(GetImplData(device)->frameBuffers));
+        }
+        return true;
+    }
+
+    // The host's frame callback is not known to be safe to call for several
+    // channels at once, so channels are delivered in order
+    if (metadataCallback)
+        metadataCallback(metadata, metadataCallbackData);
+    OScDev_Acquisition *acq = GetImplData(device)->acquisition.acquisition;
+    for (int ch = 0; ch < nChans; ++ch) {
+        bool shouldContinue =
+            OScDev_Acquisition_CallFrameCallback(acq, ch, buffers[ch]);
+        if (!shouldContinue) {
+            EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+            GetImplData(device)->acquisition.stopRequested = true;
+            LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+            break;
+        }
+    }
+    return true;
+}
+
+static void
+ProcessFrameInPipeline(void **buffers,
+                       const struct OScNIDAQ_FrameMetadata *metadata,
+                       void *data) {
+    ProcessFrame(data, buffers, metadata, true);
+}
+
+// Acquire one frame and report whether it was (or, when the processing
+// stage is active, will be) passed to the application (with frame averaging,
+// only some frames are), discarded, or aborted midway (in which case the
+// tasks are stopped and the scanner must be parked). 'sequence' is the
+// number of frames
+// delivered so far. The time spent waiting for the hardware or the
+// processing stage is added to *waitCounts.
 static OScDev_RichError *AcquireFrame(OScDev_Device *device,
-                                      OScDev_Acquisition *acq) {
+                                      OScDev_Acquisition *acq, uint32_t frame,
+                                      uint32_t sequence,
+                                      enum FrameOutcome *outcome,
+                                      LONGLONG *waitCounts) {
+    *outcome = FrameOutcome_Held;
     double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
     struct WaveformParams params;
     SetWaveformParamsFromDevice(device, &params, acq);
-    GetImplData(device)->oneFrameScanDone = false;
     GetImplData(device)->framePixelsFilled = 0;
+    if (!GetImplData(device)->scannerOnly)
+        PrepareDetectorConversion(device);
+    struct FrameRing *ring = &GetImplData(device)->frameRing;
+    if (ring->active)
+        BeginRingFrame(ring, GetImplData(device)->frameBuffers);
+
+    // The detector task is stopped, so no events can be published until we
+    // start the scan; discard any stale events from the previous frame.
+    DrainEventQueue(&GetImplData(device)->acqEvents);
 
     uint32_t totalElementsPerFramePerChan = GetScannerWaveformSize(&params);
     uint32_t estFrameTimeMs =
         (uint32_t)(1e3 * totalElementsPerFramePerChan / pixelRateHz);
-    uint32_t totalWaitTimeMs = 0;
+    uint32_t maxWaitTimeMs = 2 * estFrameTimeMs;
+    if (maxWaitTimeMs < 1000) {
+        maxWaitTimeMs = 1000;
+    }
+    // In timelapse mode, the scan waits for the next frame trigger pulse.
+    // The first frame waits for any external trigger until stopped.
+    struct FrameTrigger *trig = &GetImplData(device)->frameTrigger;
+    if (trig->intervalSec > 0.0)
+        maxWaitTimeMs += (uint32_t)(2e3 * trig->intervalSec);
+    if (frame == 0 && GetImplData(device)->configuredExternalTrigger)
+        maxWaitTimeMs = INFINITE;
+
+    struct LineStreamState stream;
+    StartLineStream(device, &stream);
+
+    struct MotionCorrection *motion = &GetImplData(device)->motionCorrection;
+    struct MotionShift shift;
 
     OScDev_RichError *err;
     err = StartScan(device);
     if (err)
         return err;
-
-    // Wait for scan to complete
-    err = CreateDAQmxError(DAQmxWaitUntilTaskDone(
-        GetImplData(device)->scannerConfig.aoTask, 2 * estFrameTimeMs * 1e-3));
-    if (err) {
-        err = OScDev_Error_Wrap(err,
-                                "Failed to wait for scanner task to finish");
-        return err;
+    if (trig->intervalSec > 0.0) {
+        // The first pulse must come after the tasks are waiting for it
+        err = StartFrameTrigger(trig);
+        if (err) {
+            AbortScan(device);
+            return err;
+        }
+    }
+    if (frame == 0) {
+        LARGE_INTEGER freq, now;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&now);
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->startLatencySec =
+            (double)(now.QuadPart - GetImplData(device)->startRequestCounts) /
+            freq.QuadPart;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
     }
 
-    // Wait for data
+    // Wait for data. The last line is acquired before the scanner finishes
+    // (the X retrace follows), so waiting for data first lets us deliver
+    // lines while the frame is being scanned.
+    HANDLE abortEvent = GetImplData(device)->acquisition.abortEvent;
+    bool frameDone = false;
+    bool aborted = false;
     if (!GetImplData(device)->scannerOnly) {
-        while (!GetImplData(device)->oneFrameScanDone) {
-            Sleep(1);
-            totalWaitTimeMs += 1;
-            if (totalWaitTimeMs > 2 * estFrameTimeMs) {
-                OScDev_Log_Error(device, "Error: Acquisition timeout!");
+        LARGE_INTEGER freq, waitStart, waitEnd;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&waitStart);
+
+        // The timeout is for the whole frame, however many events arrive
+        LONGLONG deadline = waitStart.QuadPart +
+                            maxWaitTimeMs * freq.QuadPart / 1000;
+        struct AcqEvent event;
+        while (!frameDone) {
+            DWORD remainingMs = INFINITE;
+            if (maxWaitTimeMs != INFINITE) {
+                LARGE_INTEGER now;
+                QueryPerformanceCounter(&now);
+                remainingMs = now.QuadPart >= deadline
+                                  ? 0
+                                  : (DWORD)(1000 * (deadline - now.QuadPart) /
+                                            freq.QuadPart);
+            }
+            if (!WaitForAcqEvent(&GetImplData(device)->acqEvents, &event,
+                                 remainingMs, abortEvent)) {
+                aborted = WaitForSingleObject(abortEvent, 0) == WAIT_OBJECT_0;
+                if (!aborted)
+                    OScDev_Log_Error(device, "Error: Acquisition timeout!");
                 break;
             }
+            if (event.type == AcqEvent_FrameFailed)
+                break;
+            frameDone = event.type == AcqEvent_FrameDone;
+            stream.linesFilled = event.firstLine + event.numLines;
+            DeliverLines(device, &stream, frameDone);
         }
+
+        QueryPerformanceCounter(&waitEnd);
+        *waitCounts += waitEnd.QuadPart - waitStart.QuadPart;
         char msg[OScDev_MAX_STR_LEN + 1];
-        snprintf(msg, OScDev_MAX_STR_LEN, "Total wait time is %d ",
-                 totalWaitTimeMs);
+        snprintf(msg, OScDev_MAX_STR_LEN, "Total wait time is %.3f ms",
+                 1e3 * (waitEnd.QuadPart - waitStart.QuadPart) /
+                     freq.QuadPart);
         OScDev_Log_Debug(device, msg);
+
+        // Start registering the frame while the scan finishes. The previous
+        // frame's shift (if not applied) is reported now, so that its
+        // computation overlapped this frame's scan. (In the pipeline, this
+        // is done by the processing stage.)
+        if (frameDone && !aborted && motion->active &&
+            !GetImplData(device)->frameProcessor.active) {
+            CollectMotionShiftAndReport(device, &shift);
+            SubmitMotionFrame(
+                motion, GetImplData(device)->frameBuffers[motion->channel],
+                frame);
+        }
     }
 
-    err = StopScan(device, acq);
-    if (err)
+    // Wait for scan to complete. In scanner-only mode this is the only wait.
+    if (!aborted) {
+        err = WaitScanToFinish(device, maxWaitTimeMs, waitCounts, &aborted);
+        if (err)
+            return err;
+    }
+    if (aborted) {
+        AbortScan(device);
+        *outcome = FrameOutcome_Aborted;
+        return OScDev_RichError_OK;
+    }
+    if (trig->running && GetImplData(device)->scannerOnly) {
+        // Without detector samples, the frame start is estimated from the
+        // end of the scan
+        LARGE_INTEGER freq, now;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&now);
+        RecordFrameTriggerStart(
+            trig, now.QuadPart - (LONGLONG)(totalElementsPerFramePerChan /
+                                            pixelRateHz * freq.QuadPart));
+    }
+
+    // Stopping a detector task that failed may itself report the error
+    bool failed = !GetImplData(device)->scannerOnly && !frameDone;
+    err = StopScan(device);
+    if (err && failed) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+        OScDev_Log_Debug(device, msg);
+        OScDev_Error_Destroy(err);
+    } else if (err) {
         return err;
+    }
 
-    if (!GetImplData(device)->scannerOnly) {
-        int nChans = GetNumberOfEnabledChannels(device);
-        for (int ch = 0; ch < nChans; ++ch) {
-            bool shouldContinue = OScDev_Acquisition_CallFrameCallback(
-                acq, ch, GetImplData(device)->frameBuffers[ch]);
-            if (!shouldContinue) {
-                // TODO Stop acquisition
-            }
+    // Without the frame trigger, only the first frame waits for the
+    // external trigger
+    if (frame == 0 && GetImplData(device)->configuredExternalTrigger &&
+        trig->intervalSec == 0.0) {
+        err = DisableScannerTrigger(&GetImplData(device)->scannerConfig);
+        if (err)
+            return err;
+    }
+
+    if (GetImplData(device)->scannerOnly) {
+        *outcome = FrameOutcome_Delivered;
+    } else {
+        // The tasks are restarted for the next frame, which resynchronizes
+        // the detector to the frame boundary
+        struct OScNIDAQ_FrameMetadata metadata;
+        FillFrameMetadata(device, &metadata);
+        metadata.frame = frame;
+        metadata.sequence = sequence;
+        uint64_t samplesPerFrame =
+            (uint64_t)GetImplData(device)->detectorSamplesPerLine *
+            GetScanLinesPerFrame(&params);
+        CountFrameErrors(device, &metadata, samplesPerFrame, failed);
+        if (failed) {
+            *outcome = FrameOutcome_Discarded;
+            return OScDev_RichError_OK;
+        }
+        LONGLONG frameStart = metadata.estimatedFrameStartTimestamp;
+        if (trig->running && frameStart != 0)
+            RecordFrameTriggerStart(trig, frameStart);
+
+        // Per-frame detector state must be read before the next frame
+        OScDev_RichError *darkErr = StoreDarkReference(device);
+        if (darkErr) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            OScDev_Error_FormatRecursive(darkErr, msg, sizeof(msg));
+            OScDev_Log_Error(device, msg);
+            OScDev_Error_Destroy(darkErr);
+        }
+        PublishFrameStatistics(device);
+
+        struct FrameProcessor *proc = &GetImplData(device)->frameProcessor;
+        if (!proc->active) {
+            if (ProcessFrame(device, GetImplData(device)->frameBuffers,
+                             &metadata, false))
+                *outcome = FrameOutcome_Delivered;
+            return OScDev_RichError_OK;
         }
+
+        *waitCounts += SubmitFrameForProcessing(
+            proc, GetImplData(device)->ownedFrameBuffers, &metadata);
+        memcpy(GetImplData(device)->frameBuffers,
+               GetImplData(device)->ownedFrameBuffers,
+               sizeof(GetImplData(device)->frameBuffers));
+
+        // Frame averaging holds frames at a fixed rhythm, so we know whether
+        // the frame will be delivered before it is processed
+        uint32_t framesPerOutput =
+            GetFramesPerOutputFrame(&GetImplData(device)->frameAverager);
+        if (proc->framesSubmitted % framesPerOutput == 0)
+            *outcome = FrameOutcome_Delivered;
     }
 
     return OScDev_RichError_OK;
 }
 
+// In timelapse mode, park the galvos while waiting for the next frame
+// trigger pulse, if there is time to park, and then to unpark and load the
+// raster again before the pulse. *parkCounts and *unparkCounts are the times
+// last taken to do so (initially estimates) and are updated.
+static OScDev_RichError *ParkUntilNextFrame(OScDev_Device *device,
+                                            OScDev_Acquisition *acq,
+                                            LONGLONG *parkCounts,
+                                            LONGLONG *unparkCounts) {
+    struct FrameTrigger *trig = &GetImplData(device)->frameTrigger;
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    LONGLONG next = GetNextFrameTriggerCounts(trig, start.QuadPart);
+    // Allow for unpark taking twice as long as last time, plus 10 ms
+    LONGLONG lead = 2 * *unparkCounts + freq.QuadPart / 100;
+    if (next - start.QuadPart < *parkCounts + lead)
+        return OScDev_RichError_OK;
+
+    ParkScanner(device, acq);
+    QueryPerformanceCounter(&end);
+    *parkCounts = end.QuadPart - start.QuadPart;
+
+    // A stop leaves the galvos parked
+    LONGLONG idle = next - lead - end.QuadPart;
+    DWORD idleMs = idle > 0 ? (DWORD)(1000 * idle / freq.QuadPart) : 0;
+    HANDLE abortEvent = GetImplData(device)->acquisition.abortEvent;
+    if (WaitForSingleObject(abortEvent, idleMs) == WAIT_OBJECT_0)
+        return OScDev_RichError_OK;
+
+    QueryPerformanceCounter(&start);
+    OScDev_RichError *err = SetUpScanPlan(device, acq);
+    QueryPerformanceCounter(&end);
+    *unparkCounts = end.QuadPart - start.QuadPart;
+    if (err)
+        return OScDev_Error_Wrap(err, "Failed to unpark for next frame");
+    return OScDev_RichError_OK;
+}
+
 static DWORD WINAPI AcquisitionLoop(void *param) {
     OScDev_Device *device = (OScDev_Device *)param;
     OScDev_Acquisition *acq = GetImplData(device)->acquisition.acquisition;
 
     uint32_t totalFrames = OScDev_Acquisition_GetNumberOfFrames(acq);
 
-    // insert from parking to start here
-    CreateScannerTask(device, &GetImplData(device)->scannerConfig);
-    ConfigureUnparkTiming(device, &GetImplData(device)->scannerConfig, acq);
-    WriteUnparkOutput(device, &GetImplData(device)->scannerConfig, acq);
-    GenerateUnparkOutput(device, &GetImplData(device)->scannerConfig, acq);
+    // The scanner was unparked and the raster loaded when armed
+    OScDev_RichError *recErr = StartRawRecording(
+        device, &GetImplData(device)->rawRecording, acq);
+    if (recErr) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        recErr = OScDev_Error_Wrap(recErr, "Raw recording disabled");
+        OScDev_Error_FormatRecursive(recErr, msg, sizeof(msg));
+        OScDev_Log_Error(device, msg);
+        OScDev_Error_Destroy(recErr);
+    }
 
-    // prepare raster waveform
-    SetUpScanner(device, &GetImplData(device)->scannerConfig, acq);
+    struct MotionCorrection *motion = &GetImplData(device)->motionCorrection;
+    if (!GetImplData(device)->scannerOnly && motion->enabled) {
+        if ((int)motion->channel >= GetNumberOfEnabledChannels(device)) {
+            OScDev_Log_Error(device, "Motion correction channel is not "
+                                     "enabled; motion correction disabled");
+        } else if (!StartMotionCorrection(
+                       motion, GetImplData(device)->configuredRasterWidth,
+                       GetImplData(device)->configuredRasterHeight)) {
+            OScDev_Log_Error(device, "Cannot start motion correction");
+        }
+    }
 
-    for (uint32_t frame = 0; frame < totalFrames; ++frame) {
+    struct FrameCompressor *comp = &GetImplData(device)->frameCompressor;
+    if (!GetImplData(device)->scannerOnly && comp->enabled) {
+        OScDev_RichError *compErr = StartFrameCompressor(
+            comp, GetImplData(device)->configuredRasterWidth,
+            GetImplData(device)->configuredRasterHeight);
+        if (compErr) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            compErr = OScDev_Error_Wrap(compErr, "Compression disabled");
+            OScDev_Error_FormatRecursive(compErr, msg, sizeof(msg));
+            OScDev_Log_Error(device, msg);
+            OScDev_Error_Destroy(compErr);
+        }
+    }
+
+    // Started (if enabled) by StartAcquisition()
+    struct FrameRing *ring = &GetImplData(device)->frameRing;
+
+    struct FrameDeliveryQueue *queue = &GetImplData(device)->frameDelivery;
+    if (!GetImplData(device)->scannerOnly) {
+        size_t pixelsPerFrame =
+            (size_t)GetImplData(device)->configuredRasterWidth *
+            GetImplData(device)->configuredRasterHeight;
+        OScDev_RichError *queueErr = StartFrameDelivery(
+            queue, acq, GetNumberOfEnabledChannels(device),
+            GetFrameBufferSize(GetImplData(device)->pixelDepth,
+                               pixelsPerFrame));
+        if (queueErr) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            queueErr = OScDev_Error_Wrap(
+                queueErr, "Frames will be delivered without queueing");
+            OScDev_Error_FormatRecursive(queueErr, msg, sizeof(msg));
+            OScDev_Log_Error(device, msg);
+            OScDev_Error_Destroy(queueErr);
+        }
+    }
+
+    // While the ring is active, a slot is reused until its frame is
+    // published, so frames must be processed before the next one starts
+    struct FrameProcessor *proc = &GetImplData(device)->frameProcessor;
+    if (!GetImplData(device)->scannerOnly && proc->enabled && !ring->active) {
+        size_t pixelsPerFrame =
+            (size_t)GetImplData(device)->configuredRasterWidth *
+            GetImplData(device)->configuredRasterHeight;
+        OScDev_RichError *procErr = StartFrameProcessor(
+            proc, GetNumberOfEnabledChannels(device),
+            GetFrameBufferSize(GetImplData(device)->pixelDepth,
+                               pixelsPerFrame),
+            ProcessFrameInPipeline, device);
+        if (procErr) {
+            char msg[OScDev_MAX_STR_LEN + 1];
+            procErr = OScDev_Error_Wrap(
+                procErr, "Frames will be processed on the acquisition thread");
+            OScDev_Error_FormatRecursive(procErr, msg, sizeof(msg));
+            OScDev_Log_Error(device, msg);
+            OScDev_Error_Destroy(procErr);
+        }
+    }
+
+    // Until measured, take parking and unparking to be as slow as arming
+    struct FrameTrigger *trig = &GetImplData(device)->frameTrigger;
+    LARGE_INTEGER timerFreq;
+    QueryPerformanceFrequency(&timerFreq);
+    LONGLONG parkCounts, unparkCounts;
+
+    EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
+    GetImplData(device)->discardedFrames = 0;
+    GetImplData(device)->overrunFrames = 0;
+    GetImplData(device)->shortReadFrames = 0;
+    GetImplData(device)->samplesLost = 0;
+    GetImplData(device)->controlBusyCounts = 0;
+    parkCounts =
+        (LONGLONG)(GetImplData(device)->armLatencySec * timerFreq.QuadPart);
+    unparkCounts = parkCounts;
+    LeaveCriticalSection(&(GetImplData(device)->acquisition.mutex));
+
+    // With frame averaging, totalFrames counts the frames delivered
+    uint32_t framesDelivered = 0;
+    uint32_t consecutiveErrors = 0;
+    for (uint32_t frame = 0; framesDelivered < totalFrames; ++frame) {
         bool stopRequested;
         EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
         stopRequested = GetImplData(device)->acquisition.stopRequested;
         LeaveCriticalSection(&(GetImplData(device)->acquisition.mutex));
         if (stopRequested)
             break;
+        if (queue->active && IsFrameDeliveryStopped(queue)) {
+            OScDev_Log_Debug(device, "Stop requested by frame callback");
+            break;
+        }
 
         char msg[OScDev_MAX_STR_LEN + 1];
         snprintf(msg, OScDev_MAX_STR_LEN, "Sequence acquiring frame # %d",
@@ -253,19 +1056,114 @@ static DWORD WINAPI AcquisitionLoop(void *param) {
         OScDev_Log_Debug(device, msg);
 
         OScDev_RichError *err;
-        err = AcquireFrame(device, acq);
+        enum FrameOutcome outcome;
+        LARGE_INTEGER frameStart, frameEnd;
+        LONGLONG waitCounts = 0;
+        QueryPerformanceCounter(&frameStart);
+        err = AcquireFrame(device, acq, frame, framesDelivered, &outcome,
+                           &waitCounts);
+        QueryPerformanceCounter(&frameEnd);
+        EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
+        GetImplData(device)->controlBusyCounts +=
+            frameEnd.QuadPart - frameStart.QuadPart - waitCounts;
+        LeaveCriticalSection(&(GetImplData(device)->acquisition.mutex));
+        if (outcome == FrameOutcome_Delivered)
+            ++framesDelivered;
+        if (outcome == FrameOutcome_Aborted) {
+            // Park from wherever the scanner was stopped, without waiting
+            // for frame processing and delivery to wind down
+            ParkScanner(device, acq);
+            break;
+        }
         if (err) {
             err = OScDev_Error_Wrap(err, "Error during sequence acquisition");
             OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
             OScDev_Log_Error(device, msg);
             break;
         }
+        if (outcome != FrameOutcome_Discarded) {
+            consecutiveErrors = 0;
+        } else if (++consecutiveErrors >
+                   GetImplData(device)->maxConsecutiveFrameErrors) {
+            OScDev_Log_Error(device, "Too many consecutive frame errors; "
+                                     "stopping acquisition");
+            break;
+        }
+
+        if (trig->running && trig->parkBetweenFrames &&
+            framesDelivered < totalFrames) {
+            err = ParkUntilNextFrame(device, acq, &parkCounts, &unparkCounts);
+            if (err) {
+                err = OScDev_Error_Wrap(err,
+                                        "Error during sequence acquisition");
+                OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+                OScDev_Log_Error(device, msg);
+                OScDev_Error_Destroy(err);
+                break;
+            }
+        }
+    }
+
+    if (trig->running) {
+        StopFrameTrigger(trig);
+        uint32_t numIntervals, missed;
+        double meanSec, rmsSec, maxSec;
+        GetFrameIntervalStatistics(trig, &numIntervals, &meanSec, &rmsSec,
+                                   &maxSec, &missed);
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg),
+                 "Frame intervals: %u, mean %.3f ms, jitter RMS %.3f ms, "
+                 "max %.3f ms; %u trigger pulses missed",
+                 numIntervals, 1e3 * meanSec, 1e3 * rmsSec, 1e3 * maxSec,
+                 missed);
+        OScDev_Log_Info(device, msg);
     }
 
-    // insert from start to parking here
-    ConfigureParkTiming(device, &GetImplData(device)->scannerConfig, acq);
-    WriteParkOutput(device, &GetImplData(device)->scannerConfig, acq);
-    GenerateParkOutput(device, &GetImplData(device)->scannerConfig, acq);
+    StopFrameProcessor(proc);
+    struct MotionShift lastShift;
+    CollectMotionShiftAndReport(device, &lastShift);
+    StopMotionCorrection(motion);
+    StopFrameCompressor(comp);
+
+    // Deliver the frames still waiting, unless asked to stop
+    bool stopRequested;
+    EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
+    stopRequested = GetImplData(device)->acquisition.stopRequested;
+    LeaveCriticalSection(&(GetImplData(device)->acquisition.mutex));
+    if (queue->active) {
+        StopFrameDelivery(queue, stopRequested);
+        uint32_t delivered, dropped;
+        GetFrameDeliveryCounts(queue, &delivered, &dropped);
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg), "Delivered %u frames, dropped %u",
+                 delivered, dropped);
+        OScDev_Log_Info(device, msg);
+    }
+    if (!GetImplData(device)->scannerOnly) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
+        LONGLONG controlCounts = GetImplData(device)->controlBusyCounts;
+        LeaveCriticalSection(&(GetImplData(device)->acquisition.mutex));
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg),
+                 "Busy time: acquisition %.3f s, processing %.3f s, "
+                 "delivery %.3f s",
+                 (double)controlCounts / freq.QuadPart,
+                 GetFrameProcessorBusySeconds(proc),
+                 GetFrameDeliveryBusySeconds(queue));
+        OScDev_Log_Info(device, msg);
+    }
+    StopFrameRing(ring);
+    memcpy(GetImplData(device)->frameBuffers,
+           GetImplData(device)->ownedFrameBuffers,
+           sizeof(GetImplData(device)->frameBuffers));
+
+    StopRawRecording(device, &GetImplData(device)->rawRecording);
+
+    if (GetImplData(device)->scannerUnparked &&
+        !GetImplData(device)->keepScanPlanResident)
+        ParkScanner(device, acq);
 
     EnterCriticalSection(&(GetImplData(device)->acquisition.mutex));
     GetImplData(device)->acquisition.running = false;
@@ -288,6 +1186,7 @@ OScDev_RichError *ArmAcquisition(OScDev_Device *device,
             err = OScDev_Error_Create("Acquisition already armed or running");
         } else {
             GetImplData(device)->acquisition.stopRequested = false;
+            ResetEvent(GetImplData(device)->acquisition.abortEvent);
             GetImplData(device)->acquisition.running = true;
             GetImplData(device)->acquisition.armed = false;
             GetImplData(device)->acquisition.started = false;
@@ -299,8 +1198,15 @@ OScDev_RichError *ArmAcquisition(OScDev_Device *device,
 
     GetImplData(device)->acquisition.acquisition = acq;
     GetImplData(device)->scannerOnly = scannerOnly;
+    LARGE_INTEGER freq, armStart, armEnd;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&armStart);
     err = SetUpDAQ(device);
+    QueryPerformanceCounter(&armEnd);
     if (err) {
+        if (GetImplData(device)->scannerUnparked &&
+            !GetImplData(device)->keepScanPlanResident)
+            ParkScanner(device, acq);
         GetImplData(device)->acquisition.acquisition = NULL;
         EnterCriticalSection(mutex);
         { GetImplData(device)->acquisition.running = false; }
@@ -309,13 +1215,55 @@ OScDev_RichError *ArmAcquisition(OScDev_Device *device,
     }
 
     EnterCriticalSection(mutex);
-    { GetImplData(device)->acquisition.armed = true; }
+    {
+        GetImplData(device)->acquisition.armed = true;
+        GetImplData(device)->armLatencySec =
+            (double)(armEnd.QuadPart - armStart.QuadPart) / freq.QuadPart;
+    }
     LeaveCriticalSection(mutex);
+
+    char msg[OScDev_MAX_STR_LEN + 1];
+    snprintf(msg, sizeof(msg), "Armed in %.3f ms",
+             1e3 * (armEnd.QuadPart - armStart.QuadPart) / freq.QuadPart);
+    OScDev_Log_Debug(device, msg);
+    return OScDev_RichError_OK;
+}
+
+// Start publishing frames to the shared memory ring, if enabled. Packed
+// frames are published nowhere else, so at that depth a failure to start
+// the ring is an error; otherwise the acquisition goes ahead without it.
+static OScDev_RichError *StartFrameRingIfEnabled(OScDev_Device *device) {
+    struct FrameRing *ring = &GetImplData(device)->frameRing;
+    if (GetImplData(device)->scannerOnly || !ring->enabled)
+        return OScDev_RichError_OK;
+
+    ss8str defaultName;
+    ss8_init_copy_cstr(&defaultName, "Local\\OpenScanNIDAQ_");
+    ss8_cat(&defaultName, &GetImplData(device)->deviceName);
+    OScDev_RichError *err = StartFrameRing(
+        ring, ss8_cstr(&defaultName), GetNumberOfEnabledChannels(device),
+        GetImplData(device)->configuredRasterWidth,
+        GetImplData(device)->configuredRasterHeight,
+        GetPixelDepthBits(GetImplData(device)->pixelDepth));
+    ss8_destroy(&defaultName);
+    if (!err)
+        return OScDev_RichError_OK;
+
+    if (GetImplData(device)->pixelDepth == PixelDepth_12BitPacked)
+        return OScDev_Error_Wrap(err, "Cannot publish 12-bit packed frames");
+
+    char msg[OScDev_MAX_STR_LEN + 1];
+    err = OScDev_Error_Wrap(err, "Shared memory ring disabled");
+    OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+    OScDev_Log_Error(device, msg);
+    OScDev_Error_Destroy(err);
     return OScDev_RichError_OK;
 }
 
 OScDev_RichError *StartAcquisition(OScDev_Device *device) {
     OScDev_RichError *err = OScDev_RichError_OK;
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
     EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
     {
         if (!GetImplData(device)->acquisition.running ||
@@ -329,12 +1277,21 @@ OScDev_RichError *StartAcquisition(OScDev_Device *device) {
                 "Cannot start acquisition because acquisition already running");
         } else {
             GetImplData(device)->acquisition.started = true;
+            GetImplData(device)->startRequestCounts = now.QuadPart;
         }
     }
     LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
     if (err)
         return err;
 
+    err = StartFrameRingIfEnabled(device);
+    if (err) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->acquisition.started = false;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+        return err;
+    }
+
     DWORD id;
     GetImplData(device)->acquisition.thread =
         CreateThread(NULL, 0, AcquisitionLoop, device, 0, &id);
@@ -346,10 +1303,22 @@ OScDev_RichError *StopAcquisitionAndWait(OScDev_Device *device) {
     CONDITION_VARIABLE *cv =
         &(GetImplData(device)->acquisition.acquisitionFinishCondition);
 
+    LARGE_INTEGER freq, stopStart, stopEnd;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&stopStart);
+
+    bool mustPark = false;
+    bool wasRunning;
     EnterCriticalSection(mutex);
+    wasRunning = GetImplData(device)->acquisition.running;
     if (GetImplData(device)->acquisition.started) {
+        // Interrupt the frame being scanned rather than let it finish
         GetImplData(device)->acquisition.stopRequested = true;
+        SetEvent(GetImplData(device)->acquisition.abortEvent);
     } else { // Armed but not started
+        mustPark = GetImplData(device)->acquisition.running &&
+                   GetImplData(device)->scannerUnparked &&
+                   !GetImplData(device)->keepScanPlanResident;
         GetImplData(device)->acquisition.running = false;
     }
 
@@ -358,6 +1327,24 @@ OScDev_RichError *StopAcquisitionAndWait(OScDev_Device *device) {
     }
     LeaveCriticalSection(mutex);
 
+    // The scanner was unparked when armed
+    if (mustPark)
+        ParkScanner(device, GetImplData(device)->acquisition.acquisition);
+
+    if (wasRunning) {
+        QueryPerformanceCounter(&stopEnd);
+        EnterCriticalSection(mutex);
+        GetImplData(device)->stopLatencySec =
+            (double)(stopEnd.QuadPart - stopStart.QuadPart) / freq.QuadPart;
+        LeaveCriticalSection(mutex);
+
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg), "Stopped in %.3f ms",
+                 1e3 * (stopEnd.QuadPart - stopStart.QuadPart) /
+                     freq.QuadPart);
+        OScDev_Log_Debug(device, msg);
+    }
+
     return OScDev_RichError_OK;
 }
 
@@ -92,15 +92,41 @@ static OScDev_RichError *ConfigureClockTiming(OScDev_Device *device,
     uint32_t elementsPerLine = GetLineWaveformSize(&params);
     int32 elementsPerFramePerChan = GetClockWaveformSize(&params);
 
+    ss8str clockSrc;
+    ss8_init(&clockSrc);
+    GetSampleClockSource(device, &clockSrc);
     err = CreateDAQmxError(DAQmxCfgSampClkTiming(
-        config->doTask, "", pixelRateHz, DAQmx_Val_Rising,
+        config->doTask, ss8_cstr(&clockSrc), pixelRateHz, DAQmx_Val_Rising,
         DAQmx_Val_FiniteSamps, elementsPerFramePerChan));
     if (err) {
+        ss8_destroy(&clockSrc);
         err = OScDev_Error_Wrap(
             err, "Failed to configure timing for clock do task");
         return err;
     }
 
+    // On an external sample clock, the line clock counts its edges, so that
+    // it stays in step with the scanner (the pulse timing below is then
+    // in whole pixels)
+    if (ss8_is_empty(&clockSrc)) {
+        err = CreateDAQmxError(
+            DAQmxResetCOCtrTimebaseSrc(config->lineCtrTask, ""));
+        if (!err)
+            err = CreateDAQmxError(
+                DAQmxResetCOCtrTimebaseRate(config->lineCtrTask, ""));
+    } else {
+        err = CreateDAQmxError(DAQmxSetCOCtrTimebaseSrc(
+            config->lineCtrTask, "", ss8_cstr(&clockSrc)));
+        if (!err)
+            err = CreateDAQmxError(DAQmxSetCOCtrTimebaseRate(
+                config->lineCtrTask, "", pixelRateHz));
+    }
+    ss8_destroy(&clockSrc);
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to set clock lineCtr timebase");
+        return err;
+    }
+
     double effectiveScanPortion = (double)width / elementsPerLine;
     double lineFreqHz = pixelRateHz / elementsPerLine;
     double scanPhase = 1.0 / pixelRateHz * GetImplData(device)->lineDelay;
@@ -129,7 +155,8 @@ static OScDev_RichError *ConfigureClockTiming(OScDev_Device *device,
     }
 
     err = CreateDAQmxError(DAQmxCfgImplicitTiming(
-        config->lineCtrTask, DAQmx_Val_FiniteSamps, height));
+        config->lineCtrTask, DAQmx_Val_FiniteSamps,
+        GetScanLinesPerFrame(&params)));
     if (err) {
         err = OScDev_Error_Wrap(
             err, "Failed to configure timing for clock lineCtr");
@@ -59,6 +59,7 @@ void SetWaveformParamsFromDevice(OScDev_Device *device,
     OScDev_Acquisition_GetROI(acq, &parameters->xOffset, &parameters->yOffset,
                               &parameters->width, &parameters->height);
     parameters->undershoot = GetImplData(device)->lineDelay;
+    parameters->lineRepeats = GetImplData(device)->lineRepeats;
     for (int i = 0; i < 4; ++i)
         parameters->xformMatrix[i] = GetImplData(device)->xformMatrix[i];
     parameters->xformOffsetX = GetImplData(device)->xformOffsetX;
@@ -95,12 +96,30 @@ int GetNumberOfEnabledChannels(OScDev_Device *device) {
     return ret;
 }
 
+// Channels whose input is counted by a counter rather than sampled by the AI
+bool IsPhotonCountingChannel(OScDev_Device *device, int hwChannel) {
+    return !ss8_is_empty(&GetImplData(device)->channelCounter[hwChannel]);
+}
+
+int GetNumberOfEnabledAIChannels(OScDev_Device *device) {
+    int ret = 0;
+    for (int i = 0; i < MAX_PHYSICAL_CHANS; ++i) {
+        if (GetImplData(device)->channelEnabled[i] &&
+            !IsPhotonCountingChannel(device, i)) {
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+// Get the AI physical channels of the enabled (non-counting) channels
 void GetEnabledChannels(OScDev_Device *device, ss8str *chans) {
     ss8str chan;
     ss8_init(&chan);
 
     for (int i = 0; i < MAX_PHYSICAL_CHANS; ++i) {
-        if (GetImplData(device)->channelEnabled[i]) {
+        if (GetImplData(device)->channelEnabled[i] &&
+            !IsPhotonCountingChannel(device, i)) {
             GetAIPhysChan(device, i, &chan);
             if (!ss8_is_empty(chans))
                 ss8_cat_cstr(chans, ", ");
@@ -118,3 +137,22 @@ int GetNumberOfAIPhysChans(OScDev_Device *device) {
     }
     return MAX_PHYSICAL_CHANS;
 }
+
+// Get the sample clock source for the scanner and clock tasks: empty for the
+// onboard clock, or the external clock terminal
+void GetSampleClockSource(OScDev_Device *device, ss8str *source) {
+    ss8_clear(source);
+    if (!GetImplData(device)->configuredExternalClock)
+        return;
+    ss8_copy_cstr(source, "/");
+    ss8_cat(source, &GetImplData(device)->deviceName);
+    ss8_cat_ch(source, '/');
+    ss8_cat(source, &GetImplData(device)->externalClockTerminal);
+}
+
+void GetExternalTriggerSource(OScDev_Device *device, ss8str *source) {
+    ss8_copy_cstr(source, "/");
+    ss8_cat(source, &GetImplData(device)->deviceName);
+    ss8_cat_ch(source, '/');
+    ss8_cat(source, &GetImplData(device)->externalTriggerTerminal);
+}
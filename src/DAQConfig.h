@@ -6,10 +6,16 @@
 #include <OpenScanDeviceLib.h>
 #include <ss8str.h>
 
+#include <stdbool.h>
+
 void SetWaveformParamsFromDevice(OScDev_Device *device,
                                  struct WaveformParams *parameters,
                                  OScDev_Acquisition *acq);
 OScDev_RichError *EnumerateAIPhysChans(OScDev_Device *device);
 void GetEnabledChannels(OScDev_Device *device, ss8str *chans);
 int GetNumberOfEnabledChannels(OScDev_Device *device);
+bool IsPhotonCountingChannel(OScDev_Device *device, int hwChannel);
+int GetNumberOfEnabledAIChannels(OScDev_Device *device);
 int GetNumberOfAIPhysChans(OScDev_Device *device);
+void GetSampleClockSource(OScDev_Device *device, ss8str *source);
+void GetExternalTriggerSource(OScDev_Device *device, ss8str *source);
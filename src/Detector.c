@@ -3,6 +3,13 @@
 #include "DAQConfig.h"
 #include "DAQError.h"
 #include "DeviceImplData.h"
+#include "EventQueue.h"
+#include "FrameCorrection.h"
+#include "FrameStatistics.h"
+#include "OpenScanNIDAQ.h"
+#include "PixelPacking.h"
+#include "RawRecording.h"
+#include "Waveform.h"
 
 #include <NIDAQmx.h>
 #include <OpenScanDeviceLib.h>
@@ -14,6 +21,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <Windows.h>
+
 static OScDev_RichError *
 GetAIVoltageRange(OScDev_Device *device, double *minVolts, double *maxVolts) {
     OScDev_RichError *err = OScDev_RichError_OK;
@@ -53,68 +62,398 @@ GetAIVoltageRange(OScDev_Device *device, double *minVolts, double *maxVolts) {
     return err;
 }
 
-// Process data in rawDataBuffer and place the result into frameBuffers
-static int32 HandleRawData(OScDev_Device *device) {
-    // Some amount of data (rawDataSize samples) is in the rawDataBuffer.
-    // Since we have C channels and are binning every B samples per channel,
-    // we can only process a multiple of (C * B) samples at a time. We
-    // shift any remaining samples to the front of rawDataBuffer so that they
-    // can be handled when more data is available.
+static const char *const pixelDepthNames[] = {
+    "16-bit",
+    "12-bit Packed",
+    "8-bit",
+};
 
-    size_t availableSamples = GetImplData(device)->rawDataSize;
-    uint32_t numChannels = GetNumberOfEnabledChannels(device);
-    size_t leftoverSamples = availableSamples % numChannels;
-    size_t samplesToProcess = availableSamples - leftoverSamples;
-    size_t pixelsToProducePerChan = samplesToProcess / numChannels;
+const char *GetPixelDepthName(enum PixelDepth depth) {
+    if (depth >= NumPixelDepths)
+        return NULL;
+    return pixelDepthNames[depth];
+}
 
-    double inputVoltageRange = GetImplData(device)->inputVoltageRange;
+uint32_t GetPixelDepthBits(enum PixelDepth depth) {
+    switch (depth) {
+    case PixelDepth_12BitPacked:
+        return 12;
+    case PixelDepth_8Bit:
+        return 8;
+    default:
+        return 16;
+    }
+}
 
-    float64 *rawDataBuffer = GetImplData(device)->rawDataBuffer;
+// Bytes needed for one channel frame of numPixels pixels
+size_t GetFrameBufferSize(enum PixelDepth depth, size_t numPixels) {
+    return (numPixels * GetPixelDepthBits(depth) + 7) / 8;
+}
 
-    // Given 2 channels and 2 samples per pixel per channel, rawDataBuffer
-    // contains data in the following order:
-    // | ch0_samp0 ch1_samp0 ch0_samp1 ch1_samp1 | ch0_samp0 ...
-    // We need to transfer this into per-channel frame buffers.
+// Frame averaging, motion correction, compression, statistics, line
+// streaming and dark reference acquisition work on 16-bit frames. Packed
+// frames cannot be described to OpenScanLib, so they are only published to
+// the shared memory ring.
+OScDev_RichError *CheckPixelDepthSupported(OScDev_Device *device) {
+    struct DeviceImplData *devData = GetImplData(device);
+    if (devData->pixelDepth == PixelDepth_16Bit)
+        return OScDev_RichError_OK;
 
-    // Process raw data and fill in frame buffers
-    for (size_t p = 0; p < pixelsToProducePerChan; ++p) {
-        size_t rawPixelStart = p * numChannels;
-        size_t pixelIndex = GetImplData(device)->framePixelsFilled++;
+    const char *feature = NULL;
+    if (devData->frameAverager.mode != FrameAveragingMode_None)
+        feature = "Frame averaging";
+    else if (devData->motionCorrection.enabled)
+        feature = "Motion correction";
+    else if (devData->frameCompressor.enabled)
+        feature = "Compression";
+    else if (devData->computeFrameStatistics)
+        feature = "Frame statistics";
+    else if (devData->streamPartialFrames)
+        feature = "Line streaming";
+    else if (InterlockedCompareExchange(&devData->acquireDarkReference, 0,
+                                        0))
+        feature = "Dark reference acquisition";
+    if (feature) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, sizeof(msg), "%s requires 16-bit pixel depth",
+                 feature);
+        return OScDev_Error_Create(msg);
+    }
 
-        for (size_t ch = 0; ch < numChannels; ++ch) {
-            size_t rawChannelStart = rawPixelStart + ch;
+    if (devData->pixelDepth == PixelDepth_12BitPacked &&
+        !devData->frameRing.enabled)
+        return OScDev_Error_Create("12-bit packed frames are only published "
+                                   "to the shared memory ring, which is not "
+                                   "enabled");
+    return OScDev_RichError_OK;
+}
 
-            double volts = rawDataBuffer[rawChannelStart];
+// Store a pixel value (within the range of depth) at index p of a frame
+static inline void StorePixel(void *frame, enum PixelDepth depth, size_t p,
+                              uint32_t value) {
+    switch (depth) {
+    case PixelDepth_8Bit:
+        ((uint8_t *)frame)[p] = (uint8_t)value;
+        break;
+    case PixelDepth_12BitPacked:
+        // The other pixel sharing the middle byte may be stored by a
+        // separate call (on a different read)
+        StorePacked12BitPixel(frame, p, value);
+        break;
+    default:
+        ((uint16_t *)frame)[p] = (uint16_t)value;
+        break;
+    }
+}
 
-            // TODO We need a positive offset so as not to clip the background
-            // noise
-            double offsetVolts = 1.0; // Temporary
+// Convert nPixels consecutive scans of raw samples into frame pixels of the
+// given depth. The conversion yields 16-bit values; at lower depths, they are
+// rescaled, rounded and clamped in the same pass.
+static void ConvertSamplesToPixels(const float64 *raw, size_t nPixels,
+                                   uint32_t numChannels,
+                                   const struct ChannelConversion *conversion,
+                                   enum PixelDepth depth,
+                                   void *const *frameBuffers,
+                                   size_t pixelIndex) {
+    uint32_t maxValue = (1u << GetPixelDepthBits(depth)) - 1;
+    for (uint32_t ch = 0; ch < numChannels; ++ch) {
+        void *dest = frameBuffers[ch];
+
+        if (!conversion[ch].darkFrame && !conversion[ch].flatGains) {
+            // Fold the rescaling into the linear map; 16-bit values are
+            // truncated as before
+            double outScale = maxValue / 65535.0;
+            double scale = conversion[ch].scale * outScale;
+            double bias = conversion[ch].bias * outScale +
+                          (depth == PixelDepth_16Bit ? 0.0 : 0.5);
+            double dmax = maxValue;
+            for (size_t p = 0; p < nPixels; ++p) {
+                double dpixel = raw[p * numChannels + ch] * scale + bias;
+                if (dpixel < 0) {
+                    dpixel = 0.0;
+                }
+                if (dpixel > dmax) {
+                    dpixel = dmax;
+                }
+                StorePixel(dest, depth, pixelIndex + p, (uint32_t)dpixel);
+            }
+            continue;
+        }
 
-            double dpixel =
-                65535.0 * (volts + offsetVolts) / inputVoltageRange;
+        // Dark and flat correction in integer arithmetic on the pixel value
+        // before it is stored, so that no extra pass over the frame is needed
+        double scale = conversion[ch].scale;
+        double bias = conversion[ch].bias;
+        const uint16_t *dark = conversion[ch].darkFrame;
+        const uint16_t *gains = conversion[ch].flatGains;
+        if (dark)
+            dark += pixelIndex;
+        if (gains)
+            gains += pixelIndex;
+        for (size_t p = 0; p < nPixels; ++p) {
+            double dpixel = raw[p * numChannels + ch] * scale + bias;
             if (dpixel < 0) {
                 dpixel = 0.0;
             }
             if (dpixel > 65535.0) {
                 dpixel = 65535.0;
             }
-            uint16_t pixel = (uint16_t)dpixel;
+            int32_t pixel = (int32_t)dpixel;
+            if (dark) {
+                pixel -= dark[p];
+                if (pixel < 0)
+                    pixel = 0;
+            }
+            if (gains) {
+                uint32_t scaled =
+                    ((uint32_t)pixel * gains[p] +
+                     (1u << (FLAT_GAIN_FRAC_BITS - 1))) >>
+                    FLAT_GAIN_FRAC_BITS;
+                pixel = scaled > 65535 ? 65535 : (int32_t)scaled;
+            }
+            uint32_t value = (uint32_t)pixel;
+            if (depth != PixelDepth_16Bit)
+                value = (value * maxValue + 32767) / 65535;
+            StorePixel(dest, depth, pixelIndex + p, value);
+        }
+    }
+}
+
+// Accumulate nSamples consecutive scans into per-channel sums
+static void AccumulateScans(const float64 *raw, size_t nSamples,
+                            uint32_t numChannels, double *sums) {
+    for (size_t s = 0; s < nSamples; ++s) {
+        for (uint32_t ch = 0; ch < numChannels; ++ch) {
+            sums[ch] += raw[s * numChannels + ch];
+        }
+    }
+}
 
-            GetImplData(device)->frameBuffers[ch][pixelIndex] = pixel;
+// Sum each group of samplesPerPixel scans into one scan. The inner loop adds
+// whole scans (contiguous runs of numChannels values), which the compiler can
+// vectorize; dividing by samplesPerPixel is folded into the conversion scale.
+static void BinScans(const float64 *raw, size_t nPixels,
+                     uint32_t samplesPerPixel, uint32_t numChannels,
+                     float64 *binned) {
+    for (size_t p = 0; p < nPixels; ++p) {
+        float64 *dest = binned + p * numChannels;
+        const float64 *src = raw + p * samplesPerPixel * numChannels;
+        for (uint32_t ch = 0; ch < numChannels; ++ch)
+            dest[ch] = src[ch];
+        for (uint32_t s = 1; s < samplesPerPixel; ++s) {
+            src += numChannels;
+            for (uint32_t ch = 0; ch < numChannels; ++ch)
+                dest[ch] += src[ch];
         }
     }
+}
 
-    // Shift the leftover raw samples to the front of the buffer for future
-    // consumption
-    memmove(rawDataBuffer, rawDataBuffer + samplesToProcess,
-            sizeof(float64) * leftoverSamples);
-    GetImplData(device)->rawDataSize = leftoverSamples;
+// Convert nPixels scans (one per pixel) and append them to the frame
+static void ConvertAndStorePixels(OScDev_Device *device,
+                                  const float64 *scans, size_t nPixels,
+                                  uint32_t numChannels) {
+    ConvertSamplesToPixels(scans, nPixels, numChannels,
+                           GetImplData(device)->conversion,
+                           GetImplData(device)->pixelDepth,
+                           GetImplData(device)->frameBuffers,
+                           GetImplData(device)->framePixelsFilled);
+    if (GetImplData(device)->computeFrameStatistics) {
+        for (uint32_t ch = 0; ch < numChannels; ++ch) {
+            AccumulateFrameStatistics(
+                &GetImplData(device)->frameStatistics[ch],
+                (const uint16_t *)GetImplData(device)->frameBuffers[ch] +
+                    GetImplData(device)->framePixelsFilled,
+                nPixels);
+        }
+    }
+    GetImplData(device)->framePixelsFilled += nPixels;
+}
+
+// Store binned pixel scans into the frame. With line averaging, each line is
+// summed over its repeated scans in lineAccumulator and is converted only
+// after the last repeat; dividing by lineRepeats is folded into the
+// conversion scale.
+static void StorePixels(OScDev_Device *device, const float64 *scans,
+                        size_t nPixels, uint32_t numChannels) {
+    uint32_t lineRepeats = GetImplData(device)->lineRepeats;
+    if (lineRepeats == 1) {
+        ConvertAndStorePixels(device, scans, nPixels, numChannels);
+        return;
+    }
+
+    uint32_t pixelsPerLine = GetImplData(device)->configuredRasterWidth;
+    float64 *acc = GetImplData(device)->lineAccumulator;
+    while (nPixels > 0) {
+        size_t filled = GetImplData(device)->linePixelsFilled;
+        size_t n = pixelsPerLine - filled;
+        if (n > nPixels)
+            n = nPixels;
+
+        size_t nSamples = n * numChannels;
+        float64 *dst = acc + filled * numChannels;
+        if (GetImplData(device)->linePass == 0) {
+            memcpy(dst, scans, sizeof(float64) * nSamples);
+        } else {
+            for (size_t i = 0; i < nSamples; ++i)
+                dst[i] += scans[i];
+        }
+        scans += nSamples;
+        nPixels -= n;
+
+        filled += n;
+        if (filled < pixelsPerLine) {
+            GetImplData(device)->linePixelsFilled = filled;
+            continue;
+        }
+        GetImplData(device)->linePixelsFilled = 0;
+        if (++GetImplData(device)->linePass == lineRepeats) {
+            GetImplData(device)->linePass = 0;
+            ConvertAndStorePixels(device, acc, pixelsPerLine, numChannels);
+        }
+    }
+}
+
+// Process nScans scans of pixel (trace) samples, which may begin or end in
+// the middle of a pixel when oversampling
+static void HandlePixelSamples(OScDev_Device *device, const float64 *raw,
+                               size_t nScans, uint32_t numChannels) {
+    uint32_t samplesPerPixel = GetImplData(device)->samplesPerPixel;
+    if (samplesPerPixel == 1) {
+        StorePixels(device, raw, nScans, numChannels);
+        return;
+    }
+
+    double *binSums = GetImplData(device)->binSums;
+
+    // Complete the pixel left partially filled by the previous read
+    uint32_t filled = GetImplData(device)->binSamplesFilled;
+    if (filled > 0) {
+        size_t n = samplesPerPixel - filled;
+        if (n > nScans)
+            n = nScans;
+        AccumulateScans(raw, n, numChannels, binSums);
+        filled += (uint32_t)n;
+        raw += n * numChannels;
+        nScans -= n;
+        if (filled < samplesPerPixel) {
+            GetImplData(device)->binSamplesFilled = filled;
+            return;
+        }
+        StorePixels(device, binSums, 1, numChannels);
+    }
+
+    size_t nPixels = nScans / samplesPerPixel;
+    BinScans(raw, nPixels, samplesPerPixel, numChannels,
+             GetImplData(device)->binnedBuffer);
+    StorePixels(device, GetImplData(device)->binnedBuffer, nPixels,
+                numChannels);
+    raw += nPixels * samplesPerPixel * numChannels;
+    nScans -= nPixels * samplesPerPixel;
+
+    // Keep the start of a pixel that continues in the next read
+    for (uint32_t ch = 0; ch < numChannels; ++ch)
+        binSums[ch] = 0.0;
+    AccumulateScans(raw, nScans, numChannels, binSums);
+    GetImplData(device)->binSamplesFilled = (uint32_t)nScans;
+}
+
+// Convert cumulative counts to counts per sample, in place. Going backwards,
+// each count is read before it is overwritten, so the loop has no carried
+// dependency and can be vectorized. Unsigned subtraction handles counter
+// wrap-around.
+static void DifferenceCounts(uInt32 *counts, size_t n, uInt32 *lastCount) {
+    if (n == 0)
+        return;
+    uInt32 last = counts[n - 1];
+    for (size_t i = n - 1; i > 0; --i)
+        counts[i] -= counts[i - 1];
+    counts[0] -= *lastCount;
+    *lastCount = last;
+}
+
+// Place one column of nScans values into the merged scans
+static void ScatterCounts(const uInt32 *counts, size_t nScans,
+                          uint32_t numChannels, uint32_t column,
+                          float64 *merged) {
+    for (size_t s = 0; s < nScans; ++s)
+        merged[s * numChannels + column] = counts[s];
+}
+
+static void ScatterAIColumn(const float64 *aiScans, size_t nScans,
+                            uint32_t numAIChannels, uint32_t aiColumn,
+                            uint32_t numChannels, uint32_t column,
+                            float64 *merged) {
+    for (size_t s = 0; s < nScans; ++s)
+        merged[s * numChannels + column] =
+            aiScans[s * numAIChannels + aiColumn];
+}
+
+// Process raw samples and place the result into frameBuffers
+static int32 HandleRawData(OScDev_Device *device, const float64 *rawData,
+                           size_t scansToProcess) {
+    // DAQmx reads return whole scans (one sample from each channel), so we
+    // can always process everything we read. State that spans reads (the
+    // position in the current line, partially filled frames) is kept in the
+    // device data.
+
+    uint32_t numChannels = GetNumberOfEnabledChannels(device);
 
     // TODO Cleaner to get raster size from the OScDev_Acquisition (a future
     // OpenScanLib should allow getting the current device from the
     // acquisition, so that we can pass the acquisition as callback data)
     uint32_t pixelsPerLine = GetImplData(device)->configuredRasterWidth;
     uint32_t linesPerFrame = GetImplData(device)->configuredRasterHeight;
+    uint32_t pixelStart = GetImplData(device)->lineLeadingSamples;
+    uint32_t pixelEnd =
+        pixelStart + pixelsPerLine * GetImplData(device)->samplesPerPixel;
+    uint32_t darkEnd = pixelEnd + GetImplData(device)->darkSamplesPerLine;
+    uint32_t samplesPerLine = GetImplData(device)->detectorSamplesPerLine;
+
+    // Given 2 channels and 2 samples per pixel per channel, rawData
+    // contains data in the following order:
+    // | ch0_samp0 ch1_samp0 ch0_samp1 ch1_samp1 | ch0_samp0 ...
+    // We need to transfer this into per-channel frame buffers.
+    // Each line consists of scans of pixel samples followed by scans of
+    // dark samples (taken during retrace). When the detector runs on the
+    // scanner clock, the line also contains undershoot samples before the
+    // pixels and the rest of the retrace after the dark samples, which we
+    // drop. A read may end in the middle of a pixel.
+
+    size_t pixelsFilledBefore = GetImplData(device)->framePixelsFilled;
+
+    // Process raw data and fill in frame buffers
+    const float64 *raw = rawData;
+    size_t scansRemaining = scansToProcess;
+    while (scansRemaining > 0) {
+        uint32_t linePos = GetImplData(device)->lineSamplesFilled;
+        size_t n;
+        if (linePos < pixelStart) {
+            n = pixelStart - linePos;
+            if (n > scansRemaining)
+                n = scansRemaining;
+        } else if (linePos < pixelEnd) {
+            n = pixelEnd - linePos;
+            if (n > scansRemaining)
+                n = scansRemaining;
+            HandlePixelSamples(device, raw, n, numChannels);
+        } else if (linePos < darkEnd) {
+            n = darkEnd - linePos;
+            if (n > scansRemaining)
+                n = scansRemaining;
+            AccumulateScans(raw, n, numChannels,
+                            GetImplData(device)->darkSampleSums);
+            GetImplData(device)->darkSampleCount += n;
+        } else {
+            n = samplesPerLine - linePos;
+            if (n > scansRemaining)
+                n = scansRemaining;
+        }
+        linePos += (uint32_t)n;
+        GetImplData(device)->lineSamplesFilled =
+            linePos == samplesPerLine ? 0 : linePos;
+        raw += n * numChannels;
+        scansRemaining -= n;
+    }
 
     size_t pixelsPerFrame = pixelsPerLine * linesPerFrame;
     char msg[OScDev_MAX_STR_LEN + 1];
@@ -122,10 +461,33 @@ static int32 HandleRawData(OScDev_Device *device) {
              GetImplData(device)->framePixelsFilled);
     OScDev_Log_Debug(device, msg);
 
+    uint32_t linesBefore = (uint32_t)(pixelsFilledBefore / pixelsPerLine);
+    uint32_t linesAfter =
+        (uint32_t)(GetImplData(device)->framePixelsFilled / pixelsPerLine);
+    if (linesAfter > linesBefore) {
+        struct AcqEvent event = {
+            .type = AcqEvent_LinesDone,
+            .firstLine = linesBefore,
+            .numLines = linesAfter - linesBefore,
+        };
+        if (!PublishAcqEvent(&GetImplData(device)->acqEvents, &event))
+            GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
+    }
+
     if (GetImplData(device)->framePixelsFilled == pixelsPerFrame) {
-        // TODO This method of communication is unreliable without a mutex
-        // TODO But we should use a condition variable in any case
-        GetImplData(device)->oneFrameScanDone = true;
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        GetImplData(device)->frameCompleteCounts = now.QuadPart;
+
+        struct AcqEvent event = {
+            .type = AcqEvent_FrameDone,
+            .firstLine = 0,
+            .numLines = linesPerFrame,
+        };
+        if (!PublishAcqEvent(&GetImplData(device)->acqEvents, &event)) {
+            GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
+            OScDev_Log_Error(device, "Event queue full; frame event lost");
+        }
 
         // TODO This reset should occur at start of frame
         GetImplData(device)->framePixelsFilled = 0;
@@ -134,22 +496,167 @@ static int32 HandleRawData(OScDev_Device *device) {
     return OScDev_OK;
 }
 
+// Account for samples just read, and refine the estimated time of the
+// frame's first sample: the last sample read was taken no later than now
+static void UpdateFrameStartEstimate(OScDev_Device *device,
+                                     int32 samplesPerChanRead) {
+    struct DeviceImplData *devData = GetImplData(device);
+    devData->frameSamplesRead += samplesPerChanRead;
+
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    uint64_t last = devData->frameSamplesRead - 1;
+    uint32_t samplesPerLine = devData->detectorSamplesPerLine;
+    double sinceStart =
+        (double)(last / samplesPerLine) * devData->detectorLinePeriodSec +
+        (double)(last % samplesPerLine) * devData->detectorSamplePeriodSec;
+    LONGLONG start = now.QuadPart - (LONGLONG)(sinceStart * freq.QuadPart);
+    if (devData->frameSamplesRead == (uint64_t)samplesPerChanRead ||
+        start < devData->frameStartCounts)
+        devData->frameStartCounts = start;
+}
+
+// Give up on the current frame after an error, without stopping the tasks:
+// the acquisition thread discards the frame and restarts the tasks for the
+// next one
+static void FailDetectorFrame(OScDev_Device *device, OScDev_RichError *err) {
+    char msg[OScDev_MAX_STR_LEN + 1];
+    OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+    OScDev_Log_Error(device, msg);
+    OScDev_Error_Destroy(err);
+
+    GetImplData(device)->frameFailed = true;
+    struct AcqEvent event = {
+        .type = AcqEvent_FrameFailed,
+    };
+    // If the queue is full, the acquisition thread times out instead
+    PublishAcqEvent(&GetImplData(device)->acqEvents, &event);
+}
+
+// The task whose callback drives the detector: the AI task if there are
+// analog channels, otherwise the first counter task
+static TaskHandle GetPrimaryDetectorTask(struct DetectorConfig *config) {
+    if (config->aiTask)
+        return config->aiTask;
+    return config->numCITasks > 0 ? config->ciTasks[0] : 0;
+}
+
+// After a read that filled the read buffer, return true if samples were left
+// waiting (reading has fallen behind); a read that exactly empties the
+// device buffer is not an overrun
+static bool HasUnreadSamples(TaskHandle task) {
+    uInt32 available = 0;
+    return DAQmxGetReadAvailSampPerChan(task, &available) == 0 &&
+           available > 0;
+}
+
+// Read the counts corresponding to the AI scans just read (or, if there are
+// no analog channels, all available counts) and merge them with the AI scans
+// into mergedBuffer. All tasks share the AO sample clock, so the counts of
+// the same scans are normally available at the same time.
+static OScDev_RichError *ReadCounts(OScDev_Device *device,
+                                    const float64 *aiScans,
+                                    int32 *samplesPerChanRead) {
+    struct DetectorConfig *config = &GetImplData(device)->detectorConfig;
+    uint32_t numChannels = GetNumberOfEnabledChannels(device);
+    uint32_t numAIChannels = numChannels - config->numCITasks;
+    uInt32 *counts = GetImplData(device)->countBuffer;
+    size_t capacity = GetImplData(device)->countCapacity;
+    float64 *merged = GetImplData(device)->mergedBuffer;
+
+    for (int k = 0; k < config->numCITasks; ++k) {
+        bool primary = k == 0 && !config->aiTask;
+        int32 read = 0;
+        int32 nierr;
+        if (primary) {
+            nierr = DAQmxReadCounterU32(config->ciTasks[k], DAQmx_Val_Auto,
+                                        0.0, counts, (uInt32)capacity, &read,
+                                        NULL);
+            *samplesPerChanRead = read;
+            if (!nierr && (size_t)read == capacity &&
+                HasUnreadSamples(config->ciTasks[k]))
+                GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
+        } else {
+            // Never wait here, in the middle of the AI task's callback. If
+            // some counts are not available yet, the scans are processed
+            // with zero counts and the frame is flagged; the late counts are
+            // then skipped when they are read.
+            uInt32 owed = GetImplData(device)->countsOwed[k];
+            uInt32 available = 0;
+            nierr = DAQmxGetReadAvailSampPerChan(config->ciTasks[k],
+                                                 &available);
+            uInt32 wanted = owed + (uInt32)*samplesPerChanRead;
+            if (available > wanted)
+                available = wanted;
+            if (available > capacity)
+                available = (uInt32)capacity;
+            if (!nierr && available > 0)
+                nierr = DAQmxReadCounterU32(config->ciTasks[k],
+                                            (int32)available, 0.0, counts,
+                                            (uInt32)capacity, &read, NULL);
+        }
+        if (nierr)
+            return OScDev_Error_Wrap(CreateDAQmxError(nierr),
+                                     "Failed to read photon counts");
+
+        DifferenceCounts(counts, read, &GetImplData(device)->lastCounts[k]);
+        if (!primary) {
+            // Drop the late counts of scans already processed, then make up
+            // the counts that are still missing
+            uInt32 owed = GetImplData(device)->countsOwed[k];
+            uInt32 skipped = owed < (uInt32)read ? owed : (uInt32)read;
+            int32 got = read - (int32)skipped;
+            memmove(counts, counts + skipped, sizeof(uInt32) * got);
+            if (got < *samplesPerChanRead) {
+                memset(counts + got, 0,
+                       sizeof(uInt32) * (*samplesPerChanRead - got));
+                GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
+            }
+            GetImplData(device)->countsOwed[k] =
+                owed - skipped + (uInt32)(*samplesPerChanRead - got);
+        }
+
+        for (uint32_t ch = 0; ch < numChannels; ++ch) {
+            const struct DetectorChannelSource *src =
+                &GetImplData(device)->channelSources[ch];
+            if (src->counting && src->index == (uint32_t)k)
+                ScatterCounts(counts, *samplesPerChanRead, numChannels, ch,
+                              merged);
+        }
+    }
+
+    for (uint32_t ch = 0; ch < numChannels; ++ch) {
+        const struct DetectorChannelSource *src =
+            &GetImplData(device)->channelSources[ch];
+        if (!src->counting)
+            ScatterAIColumn(aiScans, *samplesPerChanRead, numAIChannels,
+                            src->index, numChannels, ch, merged);
+    }
+    return OScDev_RichError_OK;
+}
+
 static int32 DetectorDataCallback(TaskHandle taskHandle,
                                   int32 everyNsamplesEventType,
                                   uInt32 nSamples, void *callbackData) {
     OScDev_Error errCode;
     OScDev_Device *device = (OScDev_Device *)(callbackData);
 
-    if (taskHandle != GetImplData(device)->detectorConfig.aiTask)
+    struct DetectorConfig *config = &GetImplData(device)->detectorConfig;
+    if (taskHandle != GetPrimaryDetectorTask(config))
         return OScDev_OK;
     if (everyNsamplesEventType != DAQmx_Val_Acquired_Into_Buffer)
         return OScDev_OK;
+    if (GetImplData(device)->frameFailed)
+        return OScDev_OK;
 
     char msg[1024];
     snprintf(msg, sizeof(msg) - 1, "Detector callback (%d samples)", nSamples);
     OScDev_Log_Debug(device, msg);
 
     uint32_t numChannels = GetNumberOfEnabledChannels(device);
+    uint32_t numAIChannels = numChannels - config->numCITasks;
+    ++GetImplData(device)->frameDetectorCallbacks;
 
     OScDev_RichError *err;
 
@@ -157,52 +664,132 @@ static int32 DetectorDataCallback(TaskHandle taskHandle,
     // ADC values. This is often critical for correct interpretation or
     // processing of the data.
 
-    // Read all available samples without waiting (because we have set the
-    // Read All Available Samples property on the task)
-    int32 samplesPerChanRead;
-    errCode = DAQmxReadAnalogF64(
-        taskHandle, DAQmx_Val_Auto, 0.0, DAQmx_Val_GroupByScanNumber,
-        GetImplData(device)->rawDataBuffer + GetImplData(device)->rawDataSize,
-        (uInt32)(GetImplData(device)->rawDataCapacity -
-                 GetImplData(device)->rawDataSize),
-        &samplesPerChanRead, NULL);
-    if (errCode == DAQmxErrorTimeoutExceeded) {
-        OScDev_Log_Error(device, "Error: DAQ read data timeout");
-        return OScDev_OK;
+    int32 samplesPerChanRead = 0;
+    const float64 *scans = NULL;
+    if (config->aiTask) {
+        // When recording raw samples, read directly into the recording file;
+        // otherwise (or if the recording cannot keep up) into rawDataBuffer
+        size_t maxScans = GetImplData(device)->rawDataCapacity / numChannels;
+        size_t capacity = maxScans * numAIChannels;
+        float64 *readBuffer = BeginRawRecordingWrite(
+            &GetImplData(device)->rawRecording, capacity);
+        bool recorded = readBuffer != NULL;
+        if (!recorded)
+            readBuffer = GetImplData(device)->rawDataBuffer;
+
+        // Read all available samples without waiting (because we have set
+        // the Read All Available Samples property on the task)
+        errCode = DAQmxReadAnalogF64(
+            config->aiTask, DAQmx_Val_Auto, 0.0, DAQmx_Val_GroupByScanNumber,
+            readBuffer, (uInt32)capacity, &samplesPerChanRead, NULL);
+        EndRawRecordingWrite(&GetImplData(device)->rawRecording, recorded,
+                             (size_t)samplesPerChanRead * numAIChannels);
+        if (errCode == DAQmxErrorTimeoutExceeded) {
+            GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_SHORT_READ;
+            OScDev_Log_Error(device, "Error: DAQ read data timeout");
+            return OScDev_OK;
+        }
+
+        if (errCode) {
+            if (errCode == DAQmxErrorSamplesNoLongerAvailable)
+                GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
+            err = CreateDAQmxError(errCode);
+            err = OScDev_Error_Wrap(err, "Failed to read detector samples");
+            goto error;
+        }
+        scans = readBuffer;
+        if ((size_t)samplesPerChanRead == maxScans &&
+            HasUnreadSamples(config->aiTask))
+            GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_OVERRUN;
     }
 
-    if (errCode) {
-        err = CreateDAQmxError(errCode);
-        err = OScDev_Error_Wrap(err, "Failed to read detector samples");
-        goto error;
+    if (config->numCITasks > 0) {
+        err = ReadCounts(device, scans, &samplesPerChanRead);
+        if (err)
+            goto error;
+        scans = GetImplData(device)->mergedBuffer;
     }
 
     if (samplesPerChanRead == 0) {
+        GetImplData(device)->frameFlags |= OSCNIDAQ_FRAME_SHORT_READ;
         OScDev_Log_Error(device, "Error: DAQ failed to read any sample");
         return OScDev_OK;
     }
+    UpdateFrameStartEstimate(device, samplesPerChanRead);
 
-    GetImplData(device)->rawDataSize += samplesPerChanRead * numChannels;
-
-    errCode = HandleRawData(device);
-    if (errCode)
+    errCode = HandleRawData(device, scans, samplesPerChanRead);
+    if (errCode) {
+        err = OScDev_Error_AsRichError(errCode);
         goto error;
+    }
 
     return OScDev_OK;
 
 error:
-    if (GetImplData(device)->detectorConfig.aiTask)
-        ShutdownDetector(&GetImplData(device)->detectorConfig);
-    return errCode;
+    FailDetectorFrame(device, err);
+    return OScDev_OK;
+}
+
+static OScDev_RichError *CreateCounterTasks(OScDev_Device *device,
+                                            struct DetectorConfig *config) {
+    OScDev_RichError *err;
+    int ch = 0; // Index among enabled channels
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (!GetImplData(device)->channelEnabled[hwChannel])
+            continue;
+        struct DetectorChannelSource *src =
+            &GetImplData(device)->channelSources[ch++];
+        src->counting = IsPhotonCountingChannel(device, hwChannel);
+        if (!src->counting)
+            continue;
+
+        int k = config->numCITasks;
+        if (k == MAX_COUNTER_TASKS)
+            return OScDev_Error_Create("Too many photon-counting channels");
+        src->index = k;
+
+        char taskName[32];
+        snprintf(taskName, sizeof(taskName), "DetectorCounter%d", k);
+        err = CreateDAQmxError(DAQmxCreateTask(taskName, &config->ciTasks[k]));
+        if (err)
+            return OScDev_Error_Wrap(err, "Failed to create counter task");
+        config->numCITasks = k + 1;
+
+        ss8str ctrTerm;
+        ss8_init_copy(&ctrTerm, &GetImplData(device)->deviceName);
+        ss8_cat_ch(&ctrTerm, '/');
+        ss8_cat(&ctrTerm, &GetImplData(device)->channelCounter[hwChannel]);
+        err = CreateDAQmxError(DAQmxCreateCICountEdgesChan(
+            config->ciTasks[k], ss8_cstr(&ctrTerm), "", DAQmx_Val_Rising, 0,
+            DAQmx_Val_CountUp));
+        ss8_destroy(&ctrTerm);
+        if (err)
+            return OScDev_Error_Wrap(
+                err, "Failed to create counter channel for photon counting");
+    }
+    return OScDev_RichError_OK;
 }
 
 static OScDev_RichError *CreateDetectorTask(OScDev_Device *device,
                                             struct DetectorConfig *config) {
     OScDev_RichError *err = OScDev_RichError_OK;
+
+    err = CreateCounterTasks(device, config);
+    if (err)
+        goto error;
+
+    uint32_t aiIndex = 0;
+    for (int ch = 0; ch < GetNumberOfEnabledChannels(device); ++ch) {
+        if (!GetImplData(device)->channelSources[ch].counting)
+            GetImplData(device)->channelSources[ch].index = aiIndex++;
+    }
+    if (aiIndex == 0)
+        return OScDev_RichError_OK; // Photon counting only
+
     err = CreateDAQmxError(DAQmxCreateTask("Detector", &config->aiTask));
     if (err) {
         err = OScDev_Error_Wrap(err, "Failed to create detector task");
-        return err;
+        goto error;
     }
 
     double minVolts, maxVolts;
@@ -232,23 +819,127 @@ error:
     return err;
 }
 
-static OScDev_RichError *ConfigureDetectorTiming(struct DetectorConfig *config,
+// Fail if the AI cannot sample all enabled channels at the given rate
+static OScDev_RichError *CheckAISampleRate(OScDev_Device *device,
+                                           double sampleRateHz) {
+    const char *deviceName = ss8_cstr(&GetImplData(device)->deviceName);
+    uint32_t numChannels = GetNumberOfEnabledAIChannels(device);
+
+    bool32 simultaneous = FALSE;
+    OScDev_RichError *err = CreateDAQmxError(
+        DAQmxGetDevAISimultaneousSamplingSupported(deviceName, &simultaneous));
+    if (err)
+        return OScDev_Error_Wrap(
+            err, "Failed to get simultaneous sampling support of device");
+
+    // For multiplexed devices the maximum multi-channel rate is shared by
+    // all channels
+    float64 maxRateHz;
+    if (numChannels == 1) {
+        err = CreateDAQmxError(
+            DAQmxGetDevAIMaxSingleChanRate(deviceName, &maxRateHz));
+    } else {
+        err = CreateDAQmxError(
+            DAQmxGetDevAIMaxMultiChanRate(deviceName, &maxRateHz));
+    }
+    if (err)
+        return OScDev_Error_Wrap(err, "Failed to get maximum AI sample rate");
+
+    double requiredRateHz =
+        simultaneous ? sampleRateHz : sampleRateHz * numChannels;
+    if (requiredRateHz > maxRateHz) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, OScDev_MAX_STR_LEN,
+                 "AI sample rate %.0f Hz exceeds the device maximum of "
+                 "%.0f Hz; reduce the samples per pixel or pixel rate",
+                 requiredRateHz, maxRateHz);
+        return OScDev_Error_Create(msg);
+    }
+    return OScDev_RichError_OK;
+}
+
+static OScDev_RichError *ConfigureDetectorTiming(OScDev_Device *device,
+                                                 struct DetectorConfig *config,
                                                  OScDev_Acquisition *acq) {
     OScDev_RichError *err;
     double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
     uint32_t xOffset, yOffset, width, height;
     OScDev_Acquisition_GetROI(acq, &xOffset, &yOffset, &width, &height);
 
-    err = CreateDAQmxError(
-        DAQmxCfgSampClkTiming(config->aiTask, "", pixelRateHz,
-                              DAQmx_Val_Rising, DAQmx_Val_FiniteSamps, width));
+    uint32_t samplesPerPixel = GetImplData(device)->samplesPerPixel;
+    double sampleRateHz = pixelRateHz * samplesPerPixel;
+    err = CheckAISampleRate(device, sampleRateHz);
+    if (err)
+        return err;
+
+    // When on the scanner clock, one sample per AO sample, for as long as the
+    // scanner runs
+    ss8str clockSrc;
+    ss8_init_copy_ch(&clockSrc, '/');
+    ss8_cat(&clockSrc, &GetImplData(device)->deviceName);
+    ss8_cat_cstr(&clockSrc, "/ao/SampleClock");
+
+    for (int k = 0; k < config->numCITasks; ++k) {
+        err = CreateDAQmxError(DAQmxCfgSampClkTiming(
+            config->ciTasks[k], ss8_cstr(&clockSrc), pixelRateHz,
+            DAQmx_Val_Rising, DAQmx_Val_ContSamps,
+            GetImplData(device)->detectorSamplesPerLine));
+        if (err) {
+            err = OScDev_Error_Wrap(
+                err, "Failed to configure timing for photon counter");
+            goto cleanup;
+        }
+    }
+
+    if (!config->aiTask)
+        goto cleanup;
+    if (GetImplData(device)->detectorOnScannerClock) {
+        err = CreateDAQmxError(DAQmxCfgSampClkTiming(
+            config->aiTask, ss8_cstr(&clockSrc), pixelRateHz,
+            DAQmx_Val_Rising, DAQmx_Val_ContSamps,
+            GetImplData(device)->detectorSamplesPerLine));
+    } else {
+        err = CreateDAQmxError(DAQmxCfgSampClkTiming(
+            config->aiTask, "", sampleRateHz, DAQmx_Val_Rising,
+            DAQmx_Val_FiniteSamps,
+            GetImplData(device)->detectorSamplesPerLine));
+    }
     if (err) {
         err =
             OScDev_Error_Wrap(err, "Failed to configure timing for detector");
-        return err;
     }
 
+cleanup:
+    ss8_destroy(&clockSrc);
+    return err;
+}
+
+static OScDev_RichError *ConfigureCounterArmTrigger(OScDev_Device *device,
+                                                    TaskHandle ciTask) {
+    OScDev_RichError *err;
+    err = CreateDAQmxError(
+        DAQmxSetArmStartTrigType(ciTask, DAQmx_Val_DigEdge));
+    if (err)
+        goto error;
+
+    ss8str trigSrc;
+    ss8_init_copy_ch(&trigSrc, '/');
+    ss8_cat(&trigSrc, &GetImplData(device)->deviceName);
+    ss8_cat_cstr(&trigSrc, "/ao/StartTrigger");
+    err = CreateDAQmxError(
+        DAQmxSetDigEdgeArmStartTrigSrc(ciTask, ss8_cstr(&trigSrc)));
+    ss8_destroy(&trigSrc);
+    if (err)
+        goto error;
+
+    err = CreateDAQmxError(
+        DAQmxSetDigEdgeArmStartTrigEdge(ciTask, DAQmx_Val_Rising));
+    if (err)
+        goto error;
     return OScDev_RichError_OK;
+
+error:
+    return OScDev_Error_Wrap(err, "Failed to set counter arm start trigger");
 }
 
 static OScDev_RichError *
@@ -264,10 +955,23 @@ ConfigureDetectorTrigger(OScDev_Device *device,
     // DAQmx_Val_Rising);
     OScDev_RichError *err;
 
+    // Counters start counting when the scanner starts; their first sample is
+    // taken at the first AO sample clock edge
+    for (int k = 0; k < config->numCITasks; ++k) {
+        err = ConfigureCounterArmTrigger(device, config->ciTasks[k]);
+        if (err)
+            return err;
+    }
+    if (!config->aiTask)
+        return OScDev_RichError_OK;
+
+    // When on the scanner clock, start once with the scanner
+    bool perLine = !GetImplData(device)->detectorOnScannerClock;
+
     ss8str trigSrc;
     ss8_init_copy_ch(&trigSrc, '/');
     ss8_cat(&trigSrc, &GetImplData(device)->deviceName);
-    ss8_cat_cstr(&trigSrc, "/PFI12");
+    ss8_cat_cstr(&trigSrc, perLine ? "/PFI12" : "/ao/StartTrigger");
     err = CreateDAQmxError(DAQmxCfgDigEdgeStartTrig(
         config->aiTask, ss8_cstr(&trigSrc), DAQmx_Val_Rising));
     ss8_destroy(&trigSrc);
@@ -277,7 +981,8 @@ ConfigureDetectorTrigger(OScDev_Device *device,
         return err;
     }
 
-    err = CreateDAQmxError(DAQmxSetStartTrigRetriggerable(config->aiTask, 1));
+    err = CreateDAQmxError(
+        DAQmxSetStartTrigRetriggerable(config->aiTask, perLine ? 1 : 0));
     if (err) {
         err = OScDev_Error_Wrap(err,
                                 "Failed to set detector task retriggerable");
@@ -290,7 +995,8 @@ static OScDev_RichError *
 UnconfigureDetectorCallback(struct DetectorConfig *config) {
     OScDev_RichError *err;
     err = CreateDAQmxError(DAQmxRegisterEveryNSamplesEvent(
-        config->aiTask, DAQmx_Val_Acquired_Into_Buffer, 0, 0, NULL, NULL));
+        GetPrimaryDetectorTask(config), DAQmx_Val_Acquired_Into_Buffer, 0, 0,
+        NULL, NULL));
     if (err) {
         err = OScDev_Error_Wrap(err,
                                 "Failed to unregister callback for detector");
@@ -319,7 +1025,9 @@ ConfigureDetectorCallback(OScDev_Device *device, struct DetectorConfig *config,
 
     uint32_t pixelsPerLine = width;
     uint32_t pixelsPerFrame = pixelsPerLine * height;
-    uint32_t samplesPerChanPerLine = pixelsPerLine;
+    uint32_t samplesPerPixel = GetImplData(device)->samplesPerPixel;
+    uint32_t samplesPerChanPerLine =
+        GetImplData(device)->detectorSamplesPerLine;
     uint32_t numChannels = GetNumberOfEnabledChannels(device);
     size_t bufferSize = GetImplData(device)->numLinesToBuffer *
                         samplesPerChanPerLine * numChannels;
@@ -329,38 +1037,78 @@ ConfigureDetectorCallback(OScDev_Device *device, struct DetectorConfig *config,
              bufferSize);
     OScDev_Log_Debug(device, msg);
 
-    err = CreateDAQmxError(
-        DAQmxCfgInputBuffer(config->aiTask, (uInt32)bufferSize));
-    if (err) {
-        err = OScDev_Error_Wrap(
-            err, "Failed to configure input buffer for detector");
-        return err;
+    if (config->aiTask) {
+        err = CreateDAQmxError(
+            DAQmxCfgInputBuffer(config->aiTask, (uInt32)bufferSize));
+        if (err) {
+            err = OScDev_Error_Wrap(
+                err, "Failed to configure input buffer for detector");
+            return err;
+        }
+    }
+    for (int k = 0; k < config->numCITasks; ++k) {
+        err = CreateDAQmxError(
+            DAQmxCfgInputBuffer(config->ciTasks[k], (uInt32)bufferSize));
+        if (err) {
+            err = OScDev_Error_Wrap(
+                err, "Failed to configure input buffer for photon counter");
+            return err;
+        }
     }
 
     // Allocate buffer into which we read data. Set it to be large enough
     // to read all available data from the input buffer in one go.
     GetImplData(device)->rawDataCapacity = bufferSize;
-    GetImplData(device)->rawDataSize = 0;
     GetImplData(device)->rawDataBuffer =
         realloc(GetImplData(device)->rawDataBuffer,
                 sizeof(float64) * GetImplData(device)->rawDataCapacity);
 
+    // Buffer for binning oversampled pixels of one read
+    if (samplesPerPixel > 1) {
+        GetImplData(device)->binnedBuffer =
+            realloc(GetImplData(device)->binnedBuffer,
+                    sizeof(float64) * (bufferSize / samplesPerPixel));
+    }
+
+    // Sums of the repeated scans of one line
+    if (GetImplData(device)->lineRepeats > 1) {
+        GetImplData(device)->lineAccumulator =
+            realloc(GetImplData(device)->lineAccumulator,
+                    sizeof(float64) * pixelsPerLine * numChannels);
+    }
+
+    // Buffers for merging photon counts with the AI samples
+    if (config->numCITasks > 0) {
+        GetImplData(device)->countCapacity = bufferSize / numChannels;
+        GetImplData(device)->countBuffer =
+            realloc(GetImplData(device)->countBuffer,
+                    sizeof(uInt32) * GetImplData(device)->countCapacity);
+        GetImplData(device)->mergedBuffer =
+            realloc(GetImplData(device)->mergedBuffer,
+                    sizeof(float64) * bufferSize);
+    }
+
     // Allocate frame buffers for the enabled channels
     for (uint32_t ch = 0; ch < numChannels; ++ch) {
-        GetImplData(device)->frameBuffers[ch] =
-            realloc(GetImplData(device)->frameBuffers[ch],
-                    sizeof(uint16_t) * pixelsPerFrame);
+        GetImplData(device)->ownedFrameBuffers[ch] =
+            realloc(GetImplData(device)->ownedFrameBuffers[ch],
+                    GetFrameBufferSize(GetImplData(device)->pixelDepth,
+                                       pixelsPerFrame));
     }
     // Free the frame buffers for unused channels
     for (uint32_t ch = numChannels; ch < MAX_PHYSICAL_CHANS; ++ch) {
-        free(GetImplData(device)->frameBuffers[ch]);
-        GetImplData(device)->frameBuffers[ch] = NULL;
+        free(GetImplData(device)->ownedFrameBuffers[ch]);
+        GetImplData(device)->ownedFrameBuffers[ch] = NULL;
     }
+    memcpy(GetImplData(device)->frameBuffers,
+           GetImplData(device)->ownedFrameBuffers,
+           sizeof(GetImplData(device)->frameBuffers));
 
     // Set DAQmxRead*() with DAQmx_Val_Auto to immediately return all
     // available samples instead of waiting for the requested number of
     // samples to become available.
-    err = CreateDAQmxError(DAQmxSetReadReadAllAvailSamp(config->aiTask, TRUE));
+    TaskHandle primaryTask = GetPrimaryDetectorTask(config);
+    err = CreateDAQmxError(DAQmxSetReadReadAllAvailSamp(primaryTask, TRUE));
     if (err) {
         err = OScDev_Error_Wrap(
             err,
@@ -372,8 +1120,8 @@ ConfigureDetectorCallback(OScDev_Device *device, struct DetectorConfig *config,
     // it is called at roughly 10 Hz. For now it is called once per line.
 
     err = CreateDAQmxError(DAQmxRegisterEveryNSamplesEvent(
-        config->aiTask, DAQmx_Val_Acquired_Into_Buffer, samplesPerChanPerLine,
-        0, DetectorDataCallback, device));
+        primaryTask, DAQmx_Val_Acquired_Into_Buffer, samplesPerChanPerLine, 0,
+        DetectorDataCallback, device));
     if (err) {
         err =
             OScDev_Error_Wrap(err, "Failed to register callback for detector");
@@ -385,6 +1133,54 @@ ConfigureDetectorCallback(OScDev_Device *device, struct DetectorConfig *config,
     return OScDev_RichError_OK;
 }
 
+// Determine which AI samples of each line are pixels
+static OScDev_RichError *SetDetectorLineLayout(OScDev_Device *device,
+                                               OScDev_Acquisition *acq) {
+    struct WaveformParams params;
+    SetWaveformParamsFromDevice(device, &params, acq);
+    uint32_t samplesPerPixel = GetImplData(device)->samplesPerPixel;
+    uint32_t pixelSamples = params.width * samplesPerPixel;
+    uint32_t darkSamples = GetImplData(device)->darkSamplesPerLine;
+    double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
+
+    bool counting = false;
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (GetImplData(device)->channelEnabled[hwChannel] &&
+            IsPhotonCountingChannel(device, hwChannel))
+            counting = true;
+    }
+    if (counting && !GetImplData(device)->detectorOnScannerClock)
+        return OScDev_Error_Create(
+            "Photon-counting channels require the detector to run on the "
+            "scanner clock");
+
+    if (GetImplData(device)->detectorOnScannerClock) {
+        // The AO sample clock gives us exactly one sample per scanner sample
+        if (samplesPerPixel != 1)
+            return OScDev_Error_Create(
+                "Oversampling is not possible when the detector runs on the "
+                "scanner clock");
+        uint32_t lineSamples = GetLineWaveformSize(&params);
+        GetImplData(device)->lineLeadingSamples = params.undershoot;
+        GetImplData(device)->detectorSamplesPerLine = lineSamples;
+        GetImplData(device)->detectorSamplePeriodSec = 1.0 / pixelRateHz;
+        if (params.undershoot + pixelSamples + darkSamples > lineSamples)
+            return OScDev_Error_Create(
+                "Too many dark samples per line for the retrace");
+    } else {
+        // Dark samples are acquired during the retrace, right after the trace
+        GetImplData(device)->lineLeadingSamples = 0;
+        GetImplData(device)->detectorSamplesPerLine =
+            pixelSamples + darkSamples;
+        GetImplData(device)->detectorSamplePeriodSec =
+            1.0 / (pixelRateHz * samplesPerPixel);
+    }
+    // Each line is triggered by the line clock, once per scanner line
+    GetImplData(device)->detectorLinePeriodSec =
+        GetLineWaveformSize(&params) / pixelRateHz;
+    return OScDev_RichError_OK;
+}
+
 // Initialize, configure, and arm the detector, whatever its current state
 OScDev_RichError *SetUpDetector(OScDev_Device *device,
                                 struct DetectorConfig *config,
@@ -392,10 +1188,21 @@ OScDev_RichError *SetUpDetector(OScDev_Device *device,
     OScDev_RichError *err = OScDev_RichError_OK;
     bool mustCommit = false;
 
-    if (!config->aiTask) {
+    uint32_t prevSamplesPerLine = GetImplData(device)->detectorSamplesPerLine;
+    err = SetDetectorLineLayout(device, acq);
+    if (err)
+        return err;
+    if (GetImplData(device)->detectorSamplesPerLine != prevSamplesPerLine) {
+        config->mustReconfigureTiming = true;
+        config->mustReconfigureCallback = true;
+    }
+
+    if (!config->aiTask && config->numCITasks == 0) {
         err = CreateDetectorTask(device, config);
         if (err)
             return err;
+        if (!GetPrimaryDetectorTask(config))
+            return OScDev_Error_Create("No detector channels are enabled");
 
         config->mustReconfigureTiming = true;
         config->mustReconfigureTrigger = true;
@@ -404,7 +1211,7 @@ OScDev_RichError *SetUpDetector(OScDev_Device *device,
     }
 
     if (config->mustReconfigureTiming) {
-        err = ConfigureDetectorTiming(config, acq);
+        err = ConfigureDetectorTiming(device, config, acq);
         if (err)
             goto error;
         config->mustReconfigureTiming = false;
@@ -428,11 +1235,23 @@ OScDev_RichError *SetUpDetector(OScDev_Device *device,
     }
 
     if (mustCommit) {
-        err = CreateDAQmxError(
-            DAQmxTaskControl(config->aiTask, DAQmx_Val_Task_Commit));
-        if (err) {
-            err = OScDev_Error_Wrap(err, "Failed to commit task for detector");
-            goto error;
+        for (int k = 0; k < config->numCITasks; ++k) {
+            err = CreateDAQmxError(
+                DAQmxTaskControl(config->ciTasks[k], DAQmx_Val_Task_Commit));
+            if (err) {
+                err = OScDev_Error_Wrap(
+                    err, "Failed to commit task for photon counter");
+                goto error;
+            }
+        }
+        if (config->aiTask) {
+            err = CreateDAQmxError(
+                DAQmxTaskControl(config->aiTask, DAQmx_Val_Task_Commit));
+            if (err) {
+                err = OScDev_Error_Wrap(err,
+                                        "Failed to commit task for detector");
+                goto error;
+            }
         }
     }
 
@@ -450,6 +1269,16 @@ error:
 // armed
 OScDev_RichError *ShutdownDetector(struct DetectorConfig *config) {
     OScDev_RichError *err;
+    while (config->numCITasks > 0) {
+        int k = config->numCITasks - 1;
+        err = CreateDAQmxError(DAQmxClearTask(config->ciTasks[k]));
+        if (err) {
+            err = OScDev_Error_Wrap(err, "Failed to clear counter task");
+            return err;
+        }
+        config->ciTasks[k] = 0;
+        config->numCITasks = k;
+    }
     if (config->aiTask) {
         err = CreateDAQmxError(DAQmxClearTask(config->aiTask));
         if (err) {
@@ -463,6 +1292,16 @@ OScDev_RichError *ShutdownDetector(struct DetectorConfig *config) {
 
 OScDev_RichError *StartDetector(struct DetectorConfig *config) {
     OScDev_RichError *err;
+    for (int k = 0; k < config->numCITasks; ++k) {
+        err = CreateDAQmxError(DAQmxStartTask(config->ciTasks[k]));
+        if (err) {
+            err = OScDev_Error_Wrap(err, "Failed to start counter task");
+            ShutdownDetector(config); // Force re-setup next time
+            return err;
+        }
+    }
+    if (!config->aiTask)
+        return OScDev_RichError_OK;
     err = CreateDAQmxError(DAQmxStartTask(config->aiTask));
     if (err) {
         err = OScDev_Error_Wrap(err, "Failed to start detector task");
@@ -474,15 +1313,182 @@ OScDev_RichError *StartDetector(struct DetectorConfig *config) {
 
 OScDev_RichError *StopDetector(struct DetectorConfig *config) {
     OScDev_RichError *err;
-    // The task may have been cleared in the case of an error
-    if (!config->aiTask)
-        return OScDev_RichError_OK;
+    // The tasks may have been cleared in the case of an error
+    if (config->aiTask) {
+        err = CreateDAQmxError(DAQmxStopTask(config->aiTask));
+        if (err) {
+            err = OScDev_Error_Wrap(err, "Failed to stop detector task");
+            ShutdownDetector(config); // Force re-setup next time
+            return err;
+        }
+    }
+    for (int k = 0; k < config->numCITasks; ++k) {
+        err = CreateDAQmxError(DAQmxStopTask(config->ciTasks[k]));
+        if (err) {
+            err = OScDev_Error_Wrap(err, "Failed to stop counter task");
+            ShutdownDetector(config); // Force re-setup next time
+            return err;
+        }
+    }
+    return OScDev_RichError_OK;
+}
 
-    err = CreateDAQmxError(DAQmxStopTask(config->aiTask));
-    if (err) {
-        err = OScDev_Error_Wrap(err, "Failed to stop detector task");
-        ShutdownDetector(config); // Force re-setup next time
-        return err;
+// Compute the per-channel conversion from volts to pixel values for the next
+// frame, taking into account the dark level measured during the last frame.
+// Must not be called while the detector task is running.
+void PrepareDetectorConversion(OScDev_Device *device) {
+    struct DeviceImplData *devData = GetImplData(device);
+    size_t pixelsPerFrame = (size_t)devData->configuredRasterWidth *
+                            devData->configuredRasterHeight;
+
+    // A request made during the frame applies to the next one (the dark
+    // reference is stored uncorrected, and only from 16-bit frames)
+    devData->storingDarkReference =
+        devData->pixelDepth == PixelDepth_16Bit &&
+        InterlockedCompareExchange(&devData->acquireDarkReference, 0, 0);
+
+    int ch = 0; // Index among enabled channels
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (!devData->channelEnabled[hwChannel])
+            continue;
+
+        if (devData->darkSampleCount > 0) {
+            devData->channelDarkLevelVolts[hwChannel] =
+                devData->darkSampleSums[ch] / devData->darkSampleCount;
+        }
+        devData->darkSampleSums[ch] = 0.0;
+        ResetFrameStatistics(&devData->frameStatistics[ch]);
+
+        double offsetVolts = devData->channelOffsetVolts[hwChannel];
+        if (devData->measureDarkOffset)
+            offsetVolts -= devData->channelDarkLevelVolts[hwChannel];
+
+        if (IsPhotonCountingChannel(device, hwChannel)) {
+            // pixel = gain * (counts - dark counts); the offset in volts does
+            // not apply, and the dark level is in counts per sample
+            double scale = devData->channelGain[hwChannel];
+            double darkCounts = devData->measureDarkOffset
+                                    ? devData->channelDarkLevelVolts[hwChannel]
+                                    : 0.0;
+            // Counts of repeated line scans are summed, not averaged
+            devData->conversion[ch].scale = scale;
+            devData->conversion[ch].bias =
+                -darkCounts * scale * devData->lineRepeats;
+        } else {
+            // pixel = 65535 * gain * (volts + offset) / range, where volts is
+            // the mean of the pixel's samples over all repeats of the line
+            // (the conversion is given their sum)
+            double scale = 65535.0 * devData->channelGain[hwChannel] /
+                           devData->inputVoltageRange;
+            devData->conversion[ch].scale =
+                scale / (devData->samplesPerPixel * devData->lineRepeats);
+            devData->conversion[ch].bias = offsetVolts * scale;
+        }
+
+        devData->conversion[ch].darkFrame = NULL;
+        devData->conversion[ch].flatGains = NULL;
+        if (devData->applyFrameCorrection &&
+            !devData->storingDarkReference) {
+            OScDev_RichError *err = GetFrameCorrectionMaps(
+                &devData->frameCorrection[hwChannel], pixelsPerFrame,
+                &devData->conversion[ch].darkFrame,
+                &devData->conversion[ch].flatGains);
+            if (err) {
+                char msg[OScDev_MAX_STR_LEN + 1];
+                err = OScDev_Error_Wrap(err, "Flat-field correction skipped");
+                OScDev_Error_FormatRecursive(err, msg, sizeof(msg));
+                OScDev_Log_Error(device, msg);
+                OScDev_Error_Destroy(err);
+            }
+        }
+        ++ch;
+    }
+
+    devData->darkSampleCount = 0;
+    devData->lineSamplesFilled = 0;
+    devData->binSamplesFilled = 0;
+    devData->linePass = 0;
+    devData->linePixelsFilled = 0;
+    devData->frameSamplesRead = 0;
+    devData->frameDetectorCallbacks = 0;
+    devData->frameFlags = 0;
+    devData->frameStartCounts = 0;
+    devData->frameCompleteCounts = 0;
+    devData->frameFailed = false;
+    // Counters restart from zero each time their tasks are started
+    for (int k = 0; k < MAX_COUNTER_TASKS; ++k) {
+        devData->lastCounts[k] = 0;
+        devData->countsOwed[k] = 0;
+    }
+}
+
+// Fill in the timing and integrity of the frame just acquired (all but frame
+// and sequence). Must not be called while the detector task is running.
+void FillFrameMetadata(OScDev_Device *device,
+                       struct OScNIDAQ_FrameMetadata *metadata) {
+    struct DeviceImplData *devData = GetImplData(device);
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    metadata->estimatedFrameStartTimestamp = devData->frameStartCounts;
+    metadata->hostTimestamp = devData->frameCompleteCounts;
+    metadata->timestampFrequency = freq.QuadPart;
+    metadata->samplesRead = devData->frameSamplesRead;
+    metadata->detectorCallbacks = devData->frameDetectorCallbacks;
+    metadata->flags = devData->frameFlags;
+}
+
+// Store the frame just acquired as the dark frame of each enabled channel, if
+// a dark reference was requested before the frame was prepared. Must not be
+// called while the detector task is running.
+OScDev_RichError *StoreDarkReference(OScDev_Device *device) {
+    struct DeviceImplData *devData = GetImplData(device);
+    if (!devData->storingDarkReference)
+        return OScDev_RichError_OK;
+    devData->storingDarkReference = false;
+    InterlockedExchange(&devData->acquireDarkReference, 0);
+
+    size_t pixelsPerFrame = (size_t)devData->configuredRasterWidth *
+                            devData->configuredRasterHeight;
+    int ch = 0; // Index among enabled channels
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (!devData->channelEnabled[hwChannel])
+            continue;
+        OScDev_RichError *err =
+            SetDarkFrame(&devData->frameCorrection[hwChannel],
+                         devData->frameBuffers[ch], pixelsPerFrame);
+        if (err)
+            return OScDev_Error_Wrap(err, "Failed to store dark reference");
+        ++ch;
     }
+
+    OScDev_Log_Info(device, "Stored dark reference frame");
     return OScDev_RichError_OK;
 }
+
+// Make the statistics of the frame just acquired available to settings. Must
+// not be called while the detector task is running.
+void PublishFrameStatistics(OScDev_Device *device) {
+    struct DeviceImplData *devData = GetImplData(device);
+    if (!devData->computeFrameStatistics)
+        return;
+
+    EnterCriticalSection(&devData->acquisition.mutex);
+    double saturatedFraction = 0.01 * devData->autoContrastSaturatedPercent;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    struct FrameStatisticsSummary summaries[MAX_PHYSICAL_CHANS];
+    int ch = 0; // Index among enabled channels
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (!devData->channelEnabled[hwChannel])
+            continue;
+        SummarizeFrameStatistics(&devData->frameStatistics[ch],
+                                 saturatedFraction, &summaries[hwChannel]);
+        ++ch;
+    }
+
+    EnterCriticalSection(&devData->acquisition.mutex);
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (devData->channelEnabled[hwChannel])
+            devData->lastFrameStatistics[hwChannel] = summaries[hwChannel];
+    }
+    LeaveCriticalSection(&devData->acquisition.mutex);
+}
@@ -1,20 +1,63 @@
 #pragma once
 
+#include "OpenScanNIDAQ.h"
+
 #include <NIDAQmx.h>
 #include <OpenScanDeviceLib.h>
 
-// DAQmx task and flags to track invalidated configurations for detector
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_COUNTER_TASKS 8
+
+// DAQmx tasks and flags to track invalidated configurations for detector
 // See Detector.c
 struct DetectorConfig {
-    TaskHandle aiTask;
+    TaskHandle aiTask; // Analog channels; 0 if there are none
+    // Edge-counting tasks of the photon-counting channels, in channel order
+    TaskHandle ciTasks[MAX_COUNTER_TASKS];
+    int numCITasks;
     bool mustReconfigureTiming;
     bool mustReconfigureTrigger;
     bool mustReconfigureCallback;
 };
 
+// Linear map from volts to pixel value for one channel, followed by optional
+// per-pixel dark subtraction and flat-field gain (either may be NULL)
+struct ChannelConversion {
+    double scale;
+    double bias;
+    const uint16_t *darkFrame;
+    const uint16_t *flatGains;
+};
+
+// Element format of the frame buffers
+enum PixelDepth {
+    PixelDepth_16Bit,
+    PixelDepth_12BitPacked, // Two pixels in 3 bytes (see PixelPacking.h)
+    PixelDepth_8Bit,
+    NumPixelDepths,
+};
+
+// Where the samples of one enabled channel come from
+struct DetectorChannelSource {
+    bool counting;  // Counter task rather than AI task
+    uint32_t index; // Channel index in the AI task, or counter task index
+};
+
 OScDev_RichError *SetUpDetector(OScDev_Device *device,
                                 struct DetectorConfig *config,
                                 OScDev_Acquisition *acq);
 OScDev_RichError *ShutdownDetector(struct DetectorConfig *config);
 OScDev_RichError *StartDetector(struct DetectorConfig *config);
 OScDev_RichError *StopDetector(struct DetectorConfig *config);
+const char *GetPixelDepthName(enum PixelDepth depth);
+uint32_t GetPixelDepthBits(enum PixelDepth depth);
+size_t GetFrameBufferSize(enum PixelDepth depth, size_t numPixels);
+OScDev_RichError *CheckPixelDepthSupported(OScDev_Device *device);
+void PrepareDetectorConversion(OScDev_Device *device);
+void FillFrameMetadata(OScDev_Device *device,
+                       struct OScNIDAQ_FrameMetadata *metadata);
+OScDev_RichError *StoreDarkReference(OScDev_Device *device);
+void PublishFrameStatistics(OScDev_Device *device);
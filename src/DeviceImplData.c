@@ -1,5 +1,8 @@
 #include "DeviceImplData.h"
 
+#include "EventQueue.h"
+#include "FrameCorrection.h"
+
 #include <ss8str.h>
 
 #include <string.h>
@@ -10,6 +13,8 @@ void InitializeImplData(struct DeviceImplData *data) {
     memset(data, 0, sizeof(*data));
 
     ss8_init(&data->deviceName);
+    ss8_init_copy_cstr(&data->externalTriggerTerminal, "PFI0");
+    ss8_init_copy_cstr(&data->externalClockTerminal, "PFI1");
     data->lineDelay = 50;
     data->xformMatrix[0] = 1.0;
     data->xformMatrix[1] = 0.0;
@@ -18,13 +23,38 @@ void InitializeImplData(struct DeviceImplData *data) {
     data->xformOffsetX = 0.0;
     data->xformOffsetY = 0.0;
     data->numLinesToBuffer = 8;
+    data->samplesPerPixel = 1;
+    data->lineRepeats = 1;
+    data->pixelDepth = PixelDepth_16Bit;
+    data->maxConsecutiveFrameErrors = 3;
+    data->autoContrastSaturatedPercent = 0.1;
+    data->lineStreamingIntervalMs = 20.0;
     data->inputVoltageRange = 10.0;
     data->minVolts_ = -10.0;
     data->maxVolts_ = 10.0;
     ss8_init(&data->aiPhysChans);
     data->channelEnabled[0] = true;
+    for (int i = 0; i < MAX_PHYSICAL_CHANS; ++i) {
+        // Positive offset so as not to clip the background noise
+        data->channelOffsetVolts[i] = 1.0;
+        data->channelGain[i] = 1.0;
+        ss8_init(&data->channelCounter[i]);
+        InitializeFrameCorrection(&data->frameCorrection[i]);
+    }
+
+    InitializeEventQueue(&data->acqEvents);
+    InitializeRawRecording(&data->rawRecording);
+    InitializeFrameAverager(&data->frameAverager);
+    InitializeMotionCorrection(&data->motionCorrection);
+    InitializeFrameCompressor(&data->frameCompressor);
+    InitializeFrameRing(&data->frameRing);
+    InitializeFrameDeliveryQueue(&data->frameDelivery);
+    InitializeFrameProcessor(&data->frameProcessor);
+    InitializeFrameTrigger(&data->frameTrigger);
+    InitializeTaskDoneSignal(&data->scannerConfig.aoDone);
 
     InitializeCriticalSection(&(data->acquisition.mutex));
     InitializeConditionVariable(
         &(data->acquisition.acquisitionFinishCondition));
+    data->acquisition.abortEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 }
@@ -2,6 +2,18 @@
 
 #include "Clock.h"
 #include "Detector.h"
+#include "EventQueue.h"
+#include "FrameAveraging.h"
+#include "FrameCompression.h"
+#include "FrameCorrection.h"
+#include "FrameDelivery.h"
+#include "FrameProcessing.h"
+#include "FrameRing.h"
+#include "FrameStatistics.h"
+#include "FrameTrigger.h"
+#include "MotionCorrection.h"
+#include "OpenScanNIDAQ.h"
+#include "RawRecording.h"
 #include "Scanner.h"
 
 #include <NIDAQmx.h>
@@ -26,10 +38,20 @@ struct DeviceImplData {
     double configuredZoomFactor;
     uint32_t configuredXOffset, configuredYOffset;
     uint32_t configuredRasterWidth, configuredRasterHeight;
+    // Whether the current (or last) acquisition starts on the external
+    // trigger and runs on the external sample clock
+    bool configuredExternalTrigger;
+    bool configuredExternalClock;
 
-    bool oneFrameScanDone;
     bool scannerOnly;
 
+    // Terminals (e.g. "PFI0") of the external start trigger and sample
+    // clock, used when the acquisition requests them. The sample clock runs
+    // at the pixel rate.
+    ss8str externalTriggerTerminal;
+    bool externalTriggerFallingEdge;
+    ss8str externalClockTerminal;
+
     // counted as number of pixels.
     // to adjust for the lag between the mirror control signal and the actual
     // position of the mirror scan phase (uSec) = line delay / scan rate
@@ -37,9 +59,22 @@ struct DeviceImplData {
 
     int32_t xPark;
     int32_t yPark;
+    // Last voltages output to the galvos: the park position, or the start of
+    // the raster while the scanner is unparked
     double prevXParkVoltage;
     double prevYParkVoltage;
 
+    // While scannerUnparked, the galvos rest at the start of the raster and
+    // the scanner task holds the raster waveform, so that arming with an
+    // unchanged scanner configuration does no scanner work. If
+    // keepScanPlanResident is false, the scanner is parked after each
+    // acquisition.
+    bool scannerUnparked;
+    bool keepScanPlanResident;
+
+    // Optional counter that starts the frames at a fixed interval
+    struct FrameTrigger frameTrigger;
+
     uint32_t numLinesToBuffer;
     double inputVoltageRange;
     uInt32
@@ -54,18 +89,198 @@ struct DeviceImplData {
     ss8str aiPhysChans; // at least numAIPhysChans elements separated by ", "
     bool channelEnabled[MAX_PHYSICAL_CHANS];
 
-    // Read, but unprocessed, raw samples; channels interleaved
-    // Leftover data from the previous read, if any, is at the start of the
-    // buffer and consists of rawDataSize samples.
+    // Counter input (e.g. "ctr1") that counts photons for each channel, or
+    // empty for an analog channel; index is hardware channel
+    ss8str channelCounter[MAX_PHYSICAL_CHANS];
+
+    // Per-channel calibration; index is hardware channel
+    double channelOffsetVolts[MAX_PHYSICAL_CHANS];
+    double channelGain[MAX_PHYSICAL_CHANS];
+    // Last measured (counts per sample for photon-counting channels)
+    double channelDarkLevelVolts[MAX_PHYSICAL_CHANS];
+
+    // AI samples per pixel per channel; the AI runs at this multiple of the
+    // pixel rate and each pixel is the average of its samples
+    uint32_t samplesPerPixel;
+    // Number of times each line is scanned; the line is the average of its
+    // scans (the sum, for photon-counting channels)
+    uint32_t lineRepeats;
+    // Clock the AI from the scanner's AO sample clock for the whole frame,
+    // instead of retriggering a finite acquisition for each line
+    bool detectorOnScannerClock;
+
+    // Number of samples per channel acquired during retrace after each line,
+    // used to measure the dark level (0 = don't acquire dark samples)
+    uint32_t darkSamplesPerLine;
+    // Subtract the measured dark level from the channel offset
+    bool measureDarkOffset;
+
+    // Per-pixel dark frame and flat field; index is hardware channel
+    struct FrameCorrection frameCorrection[MAX_PHYSICAL_CHANS];
+    bool applyFrameCorrection;
+    // Store the next frame as the dark frame; set from settings and cleared
+    // by the acquisition thread, so accessed with Interlocked functions
+    volatile LONG acquireDarkReference;
+    bool storingDarkReference; // Latched for the current frame
+
+    // Averaging of frames before delivery; state is used by the acquisition
+    // thread
+    struct FrameAverager frameAverager;
+
+    // Registration of each frame against the first frame, before averaging
+    struct MotionCorrection motionCorrection;
+    // Shift of the last registered frame; protected by acquisition.mutex
+    struct MotionShift lastMotionShift;
+    // Set through the extension API; protected by acquisition.mutex
+    OScNIDAQ_MotionShiftCallback motionShiftCallback;
+    void *motionShiftCallbackData;
+
+    // Lossless compression of delivered frames
+    struct FrameCompressor frameCompressor;
+    // Set through the extension API; protected by acquisition.mutex
+    OScNIDAQ_CompressedFrameCallback compressedFrameCallback;
+    void *compressedFrameCallbackData;
+    // Of the last compressed frame; protected by acquisition.mutex
+    double lastCompressionRatio;
+    double lastCompressionMBPerSecond;
+
+    bool computeFrameStatistics;
+    double autoContrastSaturatedPercent; // Protected by acquisition.mutex
+    // Statistics of the last completed frame; index is hardware channel.
+    // Protected by acquisition.mutex.
+    struct FrameStatisticsSummary lastFrameStatistics[MAX_PHYSICAL_CHANS];
+
+    // Deliver completed lines through linesCallback while the frame is being
+    // acquired, at most once every lineStreamingIntervalMs
+    bool streamPartialFrames;
+    double lineStreamingIntervalMs;
+    // Set through the extension API; protected by acquisition.mutex
+    OScNIDAQ_LinesCallback linesCallback;
+    void *linesCallbackData;
+
+    // Buffer for reading raw samples (channels interleaved) when they are
+    // not read directly into the raw recording
     float64 *rawDataBuffer;
-    size_t rawDataSize;     // Current data size
-    size_t rawDataCapacity; // Buffer size
+    size_t rawDataCapacity; // Buffer size (also the maximum read size)
+
+    // Optional recording of all raw samples to disk
+    struct RawRecording rawRecording;
+
+    // Optional shared memory into which frames are assembled, for other
+    // processes
+    struct FrameRing frameRing;
+
+    // Set through the extension API; protected by acquisition.mutex
+    OScNIDAQ_FrameMetadataCallback frameMetadataCallback;
+    void *frameMetadataCallbackData;
+
+    // Completed frames wait here to be passed to OpenScanLib by the delivery
+    // thread, so that a slow application does not stall the scan
+    struct FrameDeliveryQueue frameDelivery;
+
+    // Completed frames are corrected, averaged and compressed here while the
+    // next frame is scanned
+    struct FrameProcessor frameProcessor;
+    // Time the acquisition thread spent other than waiting for the hardware
+    // or for the processing thread, during the current or last acquisition;
+    // protected by acquisition.mutex
+    LONGLONG controlBusyCounts;
+
+    // Format of the frame buffers and of the delivered frames
+    enum PixelDepth pixelDepth;
 
     // Per-channel frame buffers that we fill in and pass to OpenScanLib
     // Index is order among currently enabled channels.
     // Buffers for unused channels may not be allocated.
-    uint16_t *frameBuffers[MAX_PHYSICAL_CHANS];
+    // These point to ownedFrameBuffers, or into the shared memory ring while
+    // it is active. Elements are in the format given by pixelDepth.
+    void *frameBuffers[MAX_PHYSICAL_CHANS];
+    void *ownedFrameBuffers[MAX_PHYSICAL_CHANS];
     size_t framePixelsFilled;
+    uint32_t lineSamplesFilled; // Samples per channel in the current line
+
+    // Timing and integrity of the current frame, collected by the detector
+    // callback (see FillFrameMetadata())
+    uint64_t frameSamplesRead;
+    uint32_t frameDetectorCallbacks;
+    uint32_t frameFlags;
+    LONGLONG frameStartCounts;    // Estimated, of the first sample
+    LONGLONG frameCompleteCounts; // When the last sample was read
+    // Set by the detector callback after an error; the rest of the frame's
+    // samples are ignored and the frame is discarded
+    bool frameFailed;
+
+    // Stop the acquisition after this many frames in a row are discarded
+    uint32_t maxConsecutiveFrameErrors;
+    // Detector errors of the current or last acquisition; protected by
+    // acquisition.mutex
+    uint32_t discardedFrames;
+    uint32_t overrunFrames;
+    uint32_t shortReadFrames;
+    uint64_t samplesLost;
+
+    // Layout of the AI samples (per channel) of each line, set when the
+    // detector is set up: lineLeadingSamples samples to drop (undershoot),
+    // then the pixel samples, then the dark samples, then any samples to
+    // drop (rest of retrace) up to detectorSamplesPerLine
+    uint32_t lineLeadingSamples;
+    uint32_t detectorSamplesPerLine;
+    // Time from the first sample of a line to that of the next line, and
+    // between consecutive samples within a line
+    double detectorLinePeriodSec;
+    double detectorSamplePeriodSec;
+
+    // Where each enabled channel's samples come from; index is order among
+    // currently enabled channels
+    struct DetectorChannelSource channelSources[MAX_PHYSICAL_CHANS];
+    // When photon-counting channels are enabled, counts read from one counter
+    // task, and the scans of all channels (counts per sample merged with AI
+    // samples) that are processed
+    uInt32 *countBuffer;
+    size_t countCapacity; // Samples
+    uInt32 lastCounts[MAX_COUNTER_TASKS]; // Index is counter task index
+    // Scans already processed with zero counts because the counts were late
+    uInt32 countsOwed[MAX_COUNTER_TASKS];
+    float64 *mergedBuffer;
+
+    // Oversampled pixels, binned into one scan per pixel before conversion
+    float64 *binnedBuffer;
+    // Sums of a pixel whose samples straddle two reads; index is order among
+    // currently enabled channels
+    double binSums[MAX_PHYSICAL_CHANS];
+    uint32_t binSamplesFilled; // Samples per channel in binSums
+
+    // With line averaging, sums of the pixel scans of the current line over
+    // the repeats scanned so far (pixelsPerLine scans)
+    float64 *lineAccumulator;
+    uint32_t linePass;         // Repeat of the current line being scanned
+    uint32_t linePixelsFilled; // Pixels of the current repeat stored so far
+
+    // Per-channel volts-to-pixel conversion, set up at the start of each
+    // frame. Index is order among currently enabled channels.
+    struct ChannelConversion conversion[MAX_PHYSICAL_CHANS];
+
+    // Dark samples accumulated during the current frame; index is order among
+    // currently enabled channels
+    double darkSampleSums[MAX_PHYSICAL_CHANS];
+    size_t darkSampleCount; // Per channel
+
+    // Statistics accumulated during the current frame; index is order among
+    // currently enabled channels
+    struct FrameStatistics frameStatistics[MAX_PHYSICAL_CHANS];
+
+    // Line and frame completion events, published by the detector callback
+    // and consumed by the acquisition thread
+    struct EventQueue acqEvents;
+
+    // Of the last acquisition; protected by acquisition.mutex
+    double armLatencySec;       // Time taken by ArmAcquisition()
+    double startLatencySec;     // From StartAcquisition() to scan start
+    LONGLONG startRequestCounts; // When StartAcquisition() was called
+    double stopLatencySec; // From StopAcquisitionAndWait() to its return
+    // Voltages from which the scanner was last parked
+    double parkStartXVolts;
+    double parkStartYVolts;
 
     struct {
         CRITICAL_SECTION mutex;
@@ -75,6 +290,7 @@ struct DeviceImplData {
         bool armed;         // Valid when running == true
         bool started;       // Valid when running == true
         bool stopRequested; // Valid when running == true
+        HANDLE abortEvent;  // Set on stop to interrupt the current frame
         OScDev_Acquisition *acquisition;
     } acquisition;
 };
@@ -0,0 +1,89 @@
+#include "EventQueue.h"
+
+#include <string.h>
+
+#include <Windows.h>
+
+// head and tail are free-running counters; the slot index is the counter
+// modulo the capacity. The producer publishes a slot by storing head with
+// release semantics after writing the slot; the consumer loads head with
+// acquire semantics before reading the slot (and vice versa for tail).
+
+void InitializeEventQueue(struct EventQueue *queue) {
+    memset(queue->events, 0, sizeof(queue->events));
+    queue->head = 0;
+    queue->tail = 0;
+    queue->droppedCount = 0;
+    queue->wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+void DestroyEventQueue(struct EventQueue *queue) {
+    if (queue->wakeEvent) {
+        CloseHandle(queue->wakeEvent);
+        queue->wakeEvent = NULL;
+    }
+}
+
+bool PublishAcqEvent(struct EventQueue *queue, const struct AcqEvent *event) {
+    LONG head = queue->head; // Only we write head
+    LONG tail = ReadAcquire(&queue->tail);
+    if ((ULONG)(head - tail) >= EVENT_QUEUE_CAPACITY) {
+        InterlockedIncrement(&queue->droppedCount);
+        return false;
+    }
+
+    queue->events[head & (EVENT_QUEUE_CAPACITY - 1)] = *event;
+    WriteRelease(&queue->head, head + 1);
+    SetEvent(queue->wakeEvent);
+    return true;
+}
+
+bool TryConsumeAcqEvent(struct EventQueue *queue, struct AcqEvent *event) {
+    LONG tail = queue->tail; // Only we write tail
+    LONG head = ReadAcquire(&queue->head);
+    if (head == tail)
+        return false;
+
+    *event = queue->events[tail & (EVENT_QUEUE_CAPACITY - 1)];
+    WriteRelease(&queue->tail, tail + 1);
+    return true;
+}
+
+// Return false on timeout, or if interruptEvent (unless NULL) is signaled
+bool WaitForAcqEvent(struct EventQueue *queue, struct AcqEvent *event,
+                     DWORD timeoutMs, HANDLE interruptEvent) {
+    HANDLE handles[2] = {queue->wakeEvent, interruptEvent};
+    DWORD numHandles = interruptEvent ? 2 : 1;
+
+    LARGE_INTEGER freq, start, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    for (;;) {
+        if (TryConsumeAcqEvent(queue, event))
+            return true;
+
+        DWORD remainingMs = INFINITE;
+        if (timeoutMs != INFINITE) {
+            QueryPerformanceCounter(&now);
+            LONGLONG elapsedMs =
+                1000 * (now.QuadPart - start.QuadPart) / freq.QuadPart;
+            if (elapsedMs >= (LONGLONG)timeoutMs)
+                return false;
+            remainingMs = timeoutMs - (DWORD)elapsedMs;
+        }
+
+        // The auto-reset event stays signaled if a publish happened between
+        // our check and the wait, so no wakeup can be lost.
+        DWORD result =
+            WaitForMultipleObjects(numHandles, handles, FALSE, remainingMs);
+        if (result == WAIT_OBJECT_0 + 1)
+            return false;
+        if (result == WAIT_TIMEOUT)
+            return TryConsumeAcqEvent(queue, event);
+    }
+}
+
+void DrainEventQueue(struct EventQueue *queue) {
+    WriteRelease(&queue->tail, ReadAcquire(&queue->head));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+// Must be a power of 2
+#define EVENT_QUEUE_CAPACITY 256
+
+enum AcqEventType {
+    AcqEvent_LinesDone,   // Lines [firstLine, firstLine + numLines) filled
+    AcqEvent_FrameDone,   // All pixels of the current frame filled
+    AcqEvent_FrameFailed, // Detector error; the frame will not be filled
+};
+
+struct AcqEvent {
+    enum AcqEventType type;
+    uint32_t firstLine;
+    uint32_t numLines;
+};
+
+// Bounded single-producer/single-consumer queue used to hand events from the
+// DAQmx callback thread (producer) to the acquisition thread (consumer)
+// without locking. The producer never blocks; if the queue is full the event
+// is dropped and counted.
+struct EventQueue {
+    struct AcqEvent events[EVENT_QUEUE_CAPACITY];
+    volatile LONG head; // Next slot to write; written only by producer
+    volatile LONG tail; // Next slot to read; written only by consumer
+    volatile LONG droppedCount;
+    HANDLE wakeEvent; // Auto-reset; signaled after each publish
+};
+
+void InitializeEventQueue(struct EventQueue *queue);
+void DestroyEventQueue(struct EventQueue *queue);
+
+// Producer side
+bool PublishAcqEvent(struct EventQueue *queue, const struct AcqEvent *event);
+
+// Consumer side
+bool TryConsumeAcqEvent(struct EventQueue *queue, struct AcqEvent *event);
+bool WaitForAcqEvent(struct EventQueue *queue, struct AcqEvent *event,
+                     DWORD timeoutMs, HANDLE interruptEvent);
+void DrainEventQueue(struct EventQueue *queue);
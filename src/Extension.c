@@ -0,0 +1,168 @@
+#include "Extension.h"
+
+#include "DeviceImplData.h"
+#include "FrameCompression.h"
+#include "FrameTrigger.h"
+#include "OpenScanNIDAQ.h"
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <string.h>
+
+#include <Windows.h>
+
+// Implementation of the functions declared in OpenScanNIDAQ.h. Device
+// instances are looked up by name in a registry of live devices.
+
+#define MAX_EXTENSION_DEVICES 64
+
+static SRWLOCK registryLock = SRWLOCK_INIT;
+static OScDev_Device *registeredDevices[MAX_EXTENSION_DEVICES];
+
+void RegisterExtensionDevice(OScDev_Device *device) {
+    AcquireSRWLockExclusive(&registryLock);
+    for (int i = 0; i < MAX_EXTENSION_DEVICES; ++i) {
+        if (!registeredDevices[i]) {
+            registeredDevices[i] = device;
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&registryLock);
+}
+
+void UnregisterExtensionDevice(OScDev_Device *device) {
+    AcquireSRWLockExclusive(&registryLock);
+    for (int i = 0; i < MAX_EXTENSION_DEVICES; ++i) {
+        if (registeredDevices[i] == device)
+            registeredDevices[i] = NULL;
+    }
+    ReleaseSRWLockExclusive(&registryLock);
+}
+
+// Must be called with registryLock held (the device cannot be released while
+// we hold the lock)
+static OScDev_Device *FindDevice(const char *deviceName) {
+    for (int i = 0; i < MAX_EXTENSION_DEVICES; ++i) {
+        OScDev_Device *device = registeredDevices[i];
+        if (device && strcmp(ss8_cstr(&GetImplData(device)->deviceName),
+                             deviceName) == 0)
+            return device;
+    }
+    return NULL;
+}
+
+OSCNIDAQ_API int OScNIDAQ_SetLinesCallback(const char *deviceName,
+                                           OScNIDAQ_LinesCallback callback,
+                                           void *userData) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->linesCallback = callback;
+        GetImplData(device)->linesCallbackData = userData;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int
+OScNIDAQ_SetMotionShiftCallback(const char *deviceName,
+                                OScNIDAQ_MotionShiftCallback callback,
+                                void *userData) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->motionShiftCallback = callback;
+        GetImplData(device)->motionShiftCallbackData = userData;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int
+OScNIDAQ_SetCompressedFrameCallback(const char *deviceName,
+                                    OScNIDAQ_CompressedFrameCallback callback,
+                                    void *userData) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->compressedFrameCallback = callback;
+        GetImplData(device)->compressedFrameCallbackData = userData;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int
+OScNIDAQ_SetFrameMetadataCallback(const char *deviceName,
+                                  OScNIDAQ_FrameMetadataCallback callback,
+                                  void *userData) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        GetImplData(device)->frameMetadataCallback = callback;
+        GetImplData(device)->frameMetadataCallbackData = userData;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int OScNIDAQ_GetAcquisitionLatencies(const char *deviceName,
+                                                  double *armSeconds,
+                                                  double *startSeconds) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        *armSeconds = GetImplData(device)->armLatencySec;
+        *startSeconds = GetImplData(device)->startLatencySec;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int OScNIDAQ_GetStopReport(const char *deviceName,
+                                        double *stopSeconds,
+                                        double *parkStartXVolts,
+                                        double *parkStartYVolts) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device) {
+        EnterCriticalSection(&GetImplData(device)->acquisition.mutex);
+        *stopSeconds = GetImplData(device)->stopLatencySec;
+        *parkStartXVolts = GetImplData(device)->parkStartXVolts;
+        *parkStartYVolts = GetImplData(device)->parkStartYVolts;
+        LeaveCriticalSection(&GetImplData(device)->acquisition.mutex);
+    }
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int OScNIDAQ_GetFrameIntervalStatistics(
+    const char *deviceName, uint32_t *numIntervals, double *meanSeconds,
+    double *rmsJitterSeconds, double *maxJitterSeconds,
+    uint32_t *missedTriggers) {
+    AcquireSRWLockShared(&registryLock);
+    OScDev_Device *device = FindDevice(deviceName);
+    if (device)
+        GetFrameIntervalStatistics(&GetImplData(device)->frameTrigger,
+                                   numIntervals, meanSeconds,
+                                   rmsJitterSeconds, maxJitterSeconds,
+                                   missedTriggers);
+    ReleaseSRWLockShared(&registryLock);
+    return device ? 0 : 1;
+}
+
+OSCNIDAQ_API int OScNIDAQ_DecompressFrame(const void *data, size_t size,
+                                          uint16_t *pixels, size_t numPixels) {
+    return DecompressFrame(data, size, pixels, numPixels) ? 0 : 1;
+}
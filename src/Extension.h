@@ -0,0 +1,8 @@
+#pragma once
+
+#include <OpenScanDeviceLib.h>
+
+// Devices must be registered to be accessible through the extension API
+// See Extension.c
+void RegisterExtensionDevice(OScDev_Device *device);
+void UnregisterExtensionDevice(OScDev_Device *device);
@@ -0,0 +1,199 @@
+#include "FrameAveraging.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frames are accumulated in place, right after they are assembled: each new
+// frame is folded into per-pixel accumulators, and when an output frame is
+// due, the result is written back over the assembled frame so that it is
+// delivered through the usual frame callback. Intermediate frames are not
+// delivered at all.
+
+static const char *const modeNames[] = {
+    "None", "Mean", "Sum", "Exponential", "Kalman",
+};
+
+const char *GetFrameAveragingModeName(enum FrameAveragingMode mode) {
+    if (mode >= NumFrameAveragingModes)
+        return NULL;
+    return modeNames[mode];
+}
+
+void InitializeFrameAverager(struct FrameAverager *avg) {
+    memset(avg, 0, sizeof(*avg));
+    avg->mode = FrameAveragingMode_None;
+    avg->framesToAverage = 4;
+    avg->outputInterval = 1;
+    avg->kalmanGain = 0.8;
+    avg->kalmanNoiseVariance = 0.05;
+    avg->kalmanProcessVariance = 0.01;
+}
+
+void DestroyFrameAverager(struct FrameAverager *avg) {
+    for (int ch = 0; ch < FRAME_AVERAGING_MAX_CHANNELS; ++ch) {
+        free(avg->sums[ch]);
+        free(avg->estimates[ch]);
+        avg->sums[ch] = NULL;
+        avg->estimates[ch] = NULL;
+    }
+}
+
+// Prepare for a new acquisition
+OScDev_RichError *ResetFrameAverager(struct FrameAverager *avg,
+                                     uint32_t numChannels, size_t numPixels) {
+    avg->framesAccumulated = 0;
+    // The first frame is the prior, uncertain by as much as the scene is
+    // expected to change
+    avg->kalmanVariance = avg->kalmanProcessVariance;
+
+    bool useSums = avg->mode == FrameAveragingMode_Mean ||
+                   avg->mode == FrameAveragingMode_Sum;
+    bool useEstimates = avg->mode == FrameAveragingMode_Exponential ||
+                        avg->mode == FrameAveragingMode_Kalman;
+    if (numChannels != avg->numChannels || numPixels != avg->numPixels)
+        DestroyFrameAverager(avg);
+    avg->numChannels = numChannels;
+    avg->numPixels = numPixels;
+
+    for (uint32_t ch = 0; ch < numChannels; ++ch) {
+        if (useSums && !avg->sums[ch]) {
+            avg->sums[ch] = malloc(sizeof(uint32_t) * numPixels);
+            if (!avg->sums[ch])
+                return OScDev_Error_Create("Out of memory for averaging");
+        }
+        if (useEstimates && !avg->estimates[ch]) {
+            avg->estimates[ch] = malloc(sizeof(float) * numPixels);
+            if (!avg->estimates[ch])
+                return OScDev_Error_Create("Out of memory for averaging");
+        }
+    }
+    return OScDev_RichError_OK;
+}
+
+static void AccumulateSums(uint32_t *sums, const uint16_t *frame, size_t n,
+                           bool first) {
+    if (first) {
+        for (size_t p = 0; p < n; ++p)
+            sums[p] = frame[p];
+    } else {
+        for (size_t p = 0; p < n; ++p)
+            sums[p] += frame[p];
+    }
+}
+
+static void WriteMean(const uint32_t *sums, uint32_t count, uint16_t *frame,
+                      size_t n) {
+    uint32_t half = count / 2;
+    for (size_t p = 0; p < n; ++p)
+        frame[p] = (uint16_t)((sums[p] + half) / count);
+}
+
+static void WriteSaturatedSum(const uint32_t *sums, uint16_t *frame,
+                              size_t n) {
+    for (size_t p = 0; p < n; ++p)
+        frame[p] = (uint16_t)(sums[p] > UINT16_MAX ? UINT16_MAX : sums[p]);
+}
+
+static void StartEstimate(float *est, const uint16_t *frame, size_t n) {
+    for (size_t p = 0; p < n; ++p)
+        est[p] = frame[p];
+}
+
+// est = weightEst * est + weightObs * obs (Kalman and exponential updates
+// both reduce to this form, with weights that do not depend on the pixel)
+static void UpdateEstimate(float *est, const uint16_t *frame, size_t n,
+                           float weightEst, float weightObs) {
+    for (size_t p = 0; p < n; ++p)
+        est[p] = weightEst * est[p] + weightObs * frame[p];
+}
+
+static void WriteEstimate(const float *est, uint16_t *frame, size_t n) {
+    for (size_t p = 0; p < n; ++p) {
+        float v = est[p] + 0.5f;
+        frame[p] = (uint16_t)(v > 65535.0f ? 65535.0f : v);
+    }
+}
+
+// Fold the just-assembled frames into the average. Return true if the frames
+// now contain an output frame to deliver; otherwise their contents are
+// unspecified and they must not be delivered.
+bool AccumulateFrame(struct FrameAverager *avg, uint16_t *const *frames) {
+    if (avg->mode == FrameAveragingMode_None)
+        return true;
+
+    size_t n = avg->numPixels;
+    bool first = avg->framesAccumulated == 0;
+    ++avg->framesAccumulated;
+
+    if (avg->mode == FrameAveragingMode_Mean ||
+        avg->mode == FrameAveragingMode_Sum) {
+        for (uint32_t ch = 0; ch < avg->numChannels; ++ch)
+            AccumulateSums(avg->sums[ch], frames[ch], n, first);
+        if (avg->framesAccumulated < avg->framesToAverage)
+            return false;
+
+        for (uint32_t ch = 0; ch < avg->numChannels; ++ch) {
+            if (avg->mode == FrameAveragingMode_Mean)
+                WriteMean(avg->sums[ch], avg->framesAccumulated, frames[ch],
+                          n);
+            else
+                WriteSaturatedSum(avg->sums[ch], frames[ch], n);
+        }
+        avg->framesAccumulated = 0;
+        return true;
+    }
+
+    // Exponential or Kalman
+    float weightEst = 0.0f, weightObs = 1.0f;
+    if (!first) {
+        if (avg->mode == FrameAveragingMode_Exponential) {
+            weightObs = 1.0f / avg->framesToAverage;
+            weightEst = 1.0f - weightObs;
+        } else {
+            // corrected = g * predicted + (1 - g) * observed
+            //             + K * (observed - predicted)
+            // where the Kalman gain K and the error variance evolve
+            // independently of the data. The prediction (the last estimate)
+            // is less certain by the process variance, so K settles where
+            // the process and noise variances balance.
+            double var = avg->kalmanVariance + avg->kalmanProcessVariance;
+            double k = var / (var + avg->kalmanNoiseVariance);
+            double g = avg->kalmanGain;
+            weightEst = (float)(g - k);
+            weightObs = (float)(1.0 - g + k);
+            avg->kalmanVariance = var * (1.0 - k);
+        }
+    }
+    for (uint32_t ch = 0; ch < avg->numChannels; ++ch) {
+        if (first)
+            StartEstimate(avg->estimates[ch], frames[ch], n);
+        else
+            UpdateEstimate(avg->estimates[ch], frames[ch], n, weightEst,
+                           weightObs);
+    }
+
+    if (avg->framesAccumulated % avg->outputInterval != 0)
+        return false;
+    for (uint32_t ch = 0; ch < avg->numChannels; ++ch)
+        WriteEstimate(avg->estimates[ch], frames[ch], n);
+    return true;
+}
+
+// Every this many frames passed to AccumulateFrame() (after a reset), it
+// returns true
+uint32_t GetFramesPerOutputFrame(const struct FrameAverager *avg) {
+    switch (avg->mode) {
+    case FrameAveragingMode_Mean:
+    case FrameAveragingMode_Sum:
+        return avg->framesToAverage;
+    case FrameAveragingMode_Exponential:
+    case FrameAveragingMode_Kalman:
+        return avg->outputInterval;
+    default:
+        return 1;
+    }
+}
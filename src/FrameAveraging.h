@@ -0,0 +1,50 @@
+#pragma once
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_AVERAGING_MAX_CHANNELS 8
+
+enum FrameAveragingMode {
+    FrameAveragingMode_None,
+    FrameAveragingMode_Mean,        // Mean of each group of N frames
+    FrameAveragingMode_Sum,         // Sum of each group of N frames
+    FrameAveragingMode_Exponential, // Running mean with time constant N
+    FrameAveragingMode_Kalman,      // Recursive Kalman filter
+    NumFrameAveragingModes,
+};
+
+// Combines successive frames of each channel into the frames delivered to
+// the application
+// See FrameAveraging.c
+struct FrameAverager {
+    // Settings
+    enum FrameAveragingMode mode;
+    uint32_t framesToAverage; // N
+    // Exponential and Kalman: deliver every this many frames
+    uint32_t outputInterval;
+    double kalmanGain;            // Weight of the prediction (0-1)
+    double kalmanNoiseVariance;   // Estimated noise variance
+    double kalmanProcessVariance; // Expected change between frames
+
+    // State during acquisition; index is order among enabled channels
+    uint32_t numChannels;
+    size_t numPixels;
+    uint32_t *sums[FRAME_AVERAGING_MAX_CHANNELS];
+    float *estimates[FRAME_AVERAGING_MAX_CHANNELS];
+    uint32_t framesAccumulated;
+    double kalmanVariance; // Error variance of the estimate
+};
+
+const char *GetFrameAveragingModeName(enum FrameAveragingMode mode);
+
+void InitializeFrameAverager(struct FrameAverager *avg);
+void DestroyFrameAverager(struct FrameAverager *avg);
+
+OScDev_RichError *ResetFrameAverager(struct FrameAverager *avg,
+                                     uint32_t numChannels, size_t numPixels);
+bool AccumulateFrame(struct FrameAverager *avg, uint16_t *const *frames);
+uint32_t GetFramesPerOutputFrame(const struct FrameAverager *avg);
@@ -0,0 +1,433 @@
+#include "FrameCompression.h"
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// Blocks are compressed into fixed slots (sized for the worst case) by the
+// worker threads and the calling thread, which claim blocks in turn; the
+// calling thread then packs the used part of each slot into the output
+// after the header. The format is described in FrameCompression.h.
+//
+// Blocks are claimed from a shared counter, which is reset for each frame.
+// A frame is not complete until every worker has taken it up and finished
+// with it, so that no worker still holding an earlier frame's pixels can
+// claim blocks after the reset.
+
+#define RESIDUAL_BITS 17
+
+void InitializeFrameCompressor(struct FrameCompressor *comp) {
+    memset(comp, 0, sizeof(*comp));
+    comp->deliverRawFrames = true;
+    comp->numThreads = 4;
+    ss8_init(&comp->filePath);
+    InitializeCriticalSection(&comp->lock);
+    InitializeConditionVariable(&comp->cv);
+}
+
+static void FreeBuffers(struct FrameCompressor *comp) {
+    free(comp->blockData);
+    free(comp->blockSizes);
+    free(comp->residuals);
+    free(comp->output);
+    comp->blockData = NULL;
+    comp->blockSizes = NULL;
+    comp->residuals = NULL;
+    comp->output = NULL;
+    comp->outputCapacity = 0;
+}
+
+void DestroyFrameCompressor(struct FrameCompressor *comp) {
+    FreeBuffers(comp);
+    ss8_destroy(&comp->filePath);
+    DeleteCriticalSection(&comp->lock);
+}
+
+struct BitWriter {
+    uint8_t *dst;
+    uint64_t acc;
+    uint32_t accBits;
+};
+
+static inline void PutBits(struct BitWriter *w, uint32_t value,
+                           uint32_t nBits) {
+    w->acc |= (uint64_t)value << w->accBits;
+    w->accBits += nBits;
+    while (w->accBits >= 8) {
+        *w->dst++ = (uint8_t)w->acc;
+        w->acc >>= 8;
+        w->accBits -= 8;
+    }
+}
+
+static inline void PutOnes(struct BitWriter *w, uint32_t count) {
+    while (count > 24) {
+        PutBits(w, 0xffffff, 24);
+        count -= 24;
+    }
+    PutBits(w, (1u << count) - 1, count);
+}
+
+static inline int32_t PredictPixel(const uint16_t *line,
+                                   const uint16_t *above, uint32_t x) {
+    if (!above)
+        return x > 0 ? line[x - 1] : 0;
+    if (x == 0)
+        return above[0];
+    int32_t a = line[x - 1], b = above[x], c = above[x - 1];
+    int32_t mx = a > b ? a : b;
+    int32_t mn = a > b ? b : a;
+    if (c >= mx)
+        return mn;
+    if (c <= mn)
+        return mx;
+    return a + b - c;
+}
+
+// Rice parameter that roughly minimizes the coded size for the given mean
+static uint32_t ChooseRiceParameter(uint64_t sum, uint32_t count) {
+    uint32_t k = 0;
+    while (k < RESIDUAL_BITS - 1 && ((uint64_t)count << (k + 1)) <= sum)
+        ++k;
+    return k;
+}
+
+static uint32_t CompressBlock(const struct FrameCompressor *comp,
+                              const uint16_t *pixels, uint32_t block,
+                              uint32_t *residuals, uint8_t *dst) {
+    uint32_t width = comp->width;
+    uint32_t firstLine = block * COMPRESSION_LINES_PER_BLOCK;
+    uint32_t endLine = firstLine + COMPRESSION_LINES_PER_BLOCK;
+    if (endLine > comp->height)
+        endLine = comp->height;
+
+    struct BitWriter w = {.dst = dst};
+    for (uint32_t y = firstLine; y < endLine; ++y) {
+        const uint16_t *line = pixels + (size_t)y * width;
+        const uint16_t *above = y > firstLine ? line - width : NULL;
+        uint64_t sum = 0;
+        for (uint32_t x = 0; x < width; ++x) {
+            int32_t r = line[x] - PredictPixel(line, above, x);
+            uint32_t u = ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+            residuals[x] = u;
+            sum += u;
+        }
+
+        uint32_t k = ChooseRiceParameter(sum, width);
+        PutBits(&w, k, 5);
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t u = residuals[x];
+            uint32_t q = u >> k;
+            if (q < COMPRESSION_RICE_ESCAPE) {
+                PutOnes(&w, q);
+                PutBits(&w, 0, 1);
+                PutBits(&w, u & ((1u << k) - 1), k);
+            } else {
+                PutOnes(&w, COMPRESSION_RICE_ESCAPE);
+                PutBits(&w, u, RESIDUAL_BITS);
+            }
+        }
+    }
+    if (w.accBits > 0)
+        PutBits(&w, 0, 8 - w.accBits);
+    return (uint32_t)(w.dst - dst);
+}
+
+// Claim and compress blocks of the current frame until none are left
+static void CompressClaimedBlocks(struct FrameCompressor *comp,
+                                  const uint16_t *pixels,
+                                  uint32_t *residuals) {
+    uint32_t done = 0;
+    for (;;) {
+        LONG block = InterlockedIncrement(&comp->nextBlock) - 1;
+        if (block >= (LONG)comp->numBlocks)
+            break;
+        comp->blockSizes[block] = CompressBlock(
+            comp, pixels, block, residuals,
+            comp->blockData + block * comp->blockCapacity);
+        ++done;
+    }
+
+    if (done > 0) {
+        EnterCriticalSection(&comp->lock);
+        comp->blocksDone += done;
+        WakeAllConditionVariable(&comp->cv);
+        LeaveCriticalSection(&comp->lock);
+    }
+}
+
+static DWORD WINAPI CompressionWorkerLoop(void *param) {
+    struct FrameCompressor *comp = param;
+    uint32_t *residuals = malloc(sizeof(uint32_t) * comp->width);
+
+    uint32_t generation = 0;
+    EnterCriticalSection(&comp->lock);
+    for (;;) {
+        while (comp->generation == generation && !comp->stopRequested)
+            SleepConditionVariableCS(&comp->cv, &comp->lock, INFINITE);
+        if (comp->stopRequested)
+            break;
+        generation = comp->generation;
+        const uint16_t *pixels = comp->pixels;
+        LeaveCriticalSection(&comp->lock);
+
+        // Without a residual buffer, leave the blocks to other threads
+        if (residuals)
+            CompressClaimedBlocks(comp, pixels, residuals);
+
+        EnterCriticalSection(&comp->lock);
+        ++comp->workersDone;
+        WakeAllConditionVariable(&comp->cv);
+    }
+    LeaveCriticalSection(&comp->lock);
+
+    free(residuals);
+    return 0;
+}
+
+OScDev_RichError *StartFrameCompressor(struct FrameCompressor *comp,
+                                       uint32_t width, uint32_t height) {
+    uint32_t numBlocks = (height + COMPRESSION_LINES_PER_BLOCK - 1) /
+                         COMPRESSION_LINES_PER_BLOCK;
+    size_t lineBits = 5 + (size_t)width * (COMPRESSION_RICE_ESCAPE +
+                                           RESIDUAL_BITS);
+    size_t blockCapacity =
+        (COMPRESSION_LINES_PER_BLOCK * lineBits + 7) / 8 + 8;
+    size_t outputCapacity = sizeof(struct CompressedFrameHeader) +
+                            sizeof(uint32_t) * numBlocks +
+                            blockCapacity * numBlocks;
+
+    if (numBlocks != comp->numBlocks || width != comp->width ||
+        !comp->output) {
+        FreeBuffers(comp);
+        comp->blockData = malloc(blockCapacity * numBlocks);
+        comp->blockSizes = malloc(sizeof(uint32_t) * numBlocks);
+        comp->residuals = malloc(sizeof(uint32_t) * width);
+        comp->output = malloc(outputCapacity);
+        if (!comp->blockData || !comp->blockSizes || !comp->residuals ||
+            !comp->output) {
+            FreeBuffers(comp);
+            comp->numBlocks = 0;
+            return OScDev_Error_Create("Out of memory for compression");
+        }
+        comp->outputCapacity = outputCapacity;
+    }
+    comp->width = width;
+    comp->height = height;
+    comp->numBlocks = numBlocks;
+    comp->blockCapacity = blockCapacity;
+    comp->outputSize = 0;
+
+    comp->file = NULL;
+    if (!ss8_is_empty(&comp->filePath)) {
+        comp->file = fopen(ss8_cstr(&comp->filePath), "ab");
+        if (!comp->file)
+            return OScDev_Error_Create("Cannot open compressed frame file");
+    }
+
+    comp->stopRequested = false;
+    comp->generation = 0;
+    comp->workersDone = 0;
+    uint32_t numThreads = comp->numThreads;
+    if (numThreads < 1)
+        numThreads = 1;
+    if (numThreads > COMPRESSION_MAX_THREADS)
+        numThreads = COMPRESSION_MAX_THREADS;
+    comp->numWorkers = 0;
+    for (uint32_t i = 0; i + 1 < numThreads; ++i) {
+        DWORD id;
+        HANDLE thread =
+            CreateThread(NULL, 0, CompressionWorkerLoop, comp, 0, &id);
+        if (!thread)
+            break; // Fewer workers is fine
+        comp->threads[comp->numWorkers++] = thread;
+    }
+
+    comp->active = true;
+    return OScDev_RichError_OK;
+}
+
+void StopFrameCompressor(struct FrameCompressor *comp) {
+    if (!comp->active)
+        return;
+
+    EnterCriticalSection(&comp->lock);
+    comp->stopRequested = true;
+    WakeAllConditionVariable(&comp->cv);
+    LeaveCriticalSection(&comp->lock);
+    for (uint32_t i = 0; i < comp->numWorkers; ++i) {
+        WaitForSingleObject(comp->threads[i], INFINITE);
+        CloseHandle(comp->threads[i]);
+    }
+    comp->numWorkers = 0;
+
+    if (comp->file)
+        fclose(comp->file);
+    comp->file = NULL;
+    comp->active = false;
+}
+
+// Compress one channel frame into comp->output (comp->outputSize bytes)
+void CompressFrame(struct FrameCompressor *comp, const uint16_t *pixels,
+                   uint32_t frame, uint32_t channel) {
+    EnterCriticalSection(&comp->lock);
+    comp->pixels = pixels;
+    comp->nextBlock = 0;
+    comp->blocksDone = 0;
+    comp->workersDone = 0;
+    ++comp->generation;
+    WakeAllConditionVariable(&comp->cv);
+    LeaveCriticalSection(&comp->lock);
+
+    CompressClaimedBlocks(comp, pixels, comp->residuals);
+
+    // Also wait for every worker to be done with this frame (even if it
+    // found no block to claim), so that none is left holding this frame's
+    // pixels when the next frame resets the block counter
+    EnterCriticalSection(&comp->lock);
+    while (comp->blocksDone < comp->numBlocks ||
+           comp->workersDone < comp->numWorkers)
+        SleepConditionVariableCS(&comp->cv, &comp->lock, INFINITE);
+    LeaveCriticalSection(&comp->lock);
+
+    struct CompressedFrameHeader header = {
+        .magic = {'O', 'S', 'C', 'Z'},
+        .version = 1,
+        .linesPerBlock = COMPRESSION_LINES_PER_BLOCK,
+        .width = comp->width,
+        .height = comp->height,
+        .frame = frame,
+        .channel = channel,
+        .numBlocks = comp->numBlocks,
+    };
+    uint8_t *out = comp->output;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    memcpy(out, comp->blockSizes, sizeof(uint32_t) * comp->numBlocks);
+    out += sizeof(uint32_t) * comp->numBlocks;
+    for (uint32_t b = 0; b < comp->numBlocks; ++b) {
+        memcpy(out, comp->blockData + b * comp->blockCapacity,
+               comp->blockSizes[b]);
+        out += comp->blockSizes[b];
+    }
+    comp->outputSize = out - comp->output;
+}
+
+// Append the last compressed frame to the file, if any
+OScDev_RichError *WriteCompressedFrame(struct FrameCompressor *comp) {
+    if (!comp->file)
+        return OScDev_RichError_OK;
+    if (fwrite(comp->output, 1, comp->outputSize, comp->file) !=
+        comp->outputSize)
+        return OScDev_Error_Create("Failed to write compressed frame");
+    return OScDev_RichError_OK;
+}
+
+struct BitReader {
+    const uint8_t *src;
+    const uint8_t *end;
+    uint64_t acc;
+    uint32_t accBits;
+};
+
+static inline bool GetBits(struct BitReader *r, uint32_t nBits,
+                           uint32_t *value) {
+    while (r->accBits < nBits) {
+        if (r->src == r->end)
+            return false;
+        r->acc |= (uint64_t)*r->src++ << r->accBits;
+        r->accBits += 8;
+    }
+    *value = (uint32_t)(r->acc & ((1ull << nBits) - 1));
+    r->acc >>= nBits;
+    r->accBits -= nBits;
+    return true;
+}
+
+static bool DecompressBlock(const uint8_t *src, size_t size,
+                            uint32_t width, uint32_t firstLine,
+                            uint32_t endLine, uint16_t *pixels) {
+    struct BitReader r = {.src = src, .end = src + size};
+    for (uint32_t y = firstLine; y < endLine; ++y) {
+        uint16_t *line = pixels + (size_t)y * width;
+        const uint16_t *above = y > firstLine ? line - width : NULL;
+        uint32_t k;
+        if (!GetBits(&r, 5, &k) || k >= RESIDUAL_BITS)
+            return false;
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t q = 0, bit;
+            for (;;) {
+                if (!GetBits(&r, 1, &bit))
+                    return false;
+                if (!bit)
+                    break;
+                if (++q == COMPRESSION_RICE_ESCAPE)
+                    break;
+            }
+            uint32_t u;
+            if (q == COMPRESSION_RICE_ESCAPE) {
+                if (!GetBits(&r, RESIDUAL_BITS, &u))
+                    return false;
+            } else {
+                uint32_t low = 0;
+                if (k > 0 && !GetBits(&r, k, &low))
+                    return false;
+                u = (q << k) | low;
+            }
+            int32_t residual = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            line[x] = (uint16_t)(PredictPixel(line, above, x) + residual);
+        }
+    }
+    return true;
+}
+
+// Decode a compressed channel frame into pixels; return false if the data
+// is invalid or the frame has more than numPixels pixels
+bool DecompressFrame(const void *data, size_t size, uint16_t *pixels,
+                     size_t numPixels) {
+    struct CompressedFrameHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "OSCZ", 4) != 0 || header.version != 1 ||
+        header.linesPerBlock == 0)
+        return false;
+    if ((uint64_t)header.width * header.height > numPixels)
+        return false;
+    uint32_t numBlocks =
+        (header.height + header.linesPerBlock - 1) / header.linesPerBlock;
+    if (header.numBlocks != numBlocks)
+        return false;
+
+    const uint8_t *src = (const uint8_t *)data + sizeof(header);
+    size_t remaining = size - sizeof(header);
+    if (remaining / sizeof(uint32_t) < numBlocks)
+        return false;
+    const uint8_t *sizes = src;
+    src += sizeof(uint32_t) * numBlocks;
+    remaining -= sizeof(uint32_t) * numBlocks;
+
+    for (uint32_t b = 0; b < numBlocks; ++b) {
+        uint32_t blockSize;
+        memcpy(&blockSize, sizes + sizeof(uint32_t) * b, sizeof(blockSize));
+        if (blockSize > remaining)
+            return false;
+        uint32_t firstLine = b * header.linesPerBlock;
+        uint32_t endLine = firstLine + header.linesPerBlock;
+        if (endLine > header.height)
+            endLine = header.height;
+        if (!DecompressBlock(src, blockSize, header.width, firstLine,
+                             endLine, pixels))
+            return false;
+        src += blockSize;
+        remaining -= blockSize;
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <Windows.h>
+
+#define COMPRESSION_MAX_THREADS 8
+#define COMPRESSION_LINES_PER_BLOCK 16
+
+// Each compressed channel frame starts with this header, followed by
+// numBlocks uint32_t block sizes in bytes and then the blocks. Each block
+// holds COMPRESSION_LINES_PER_BLOCK lines (fewer in the last block) and can
+// be decoded independently. All fields are little-endian.
+//
+// Within a block, each pixel is predicted from its left neighbor (first
+// line of the block), the pixel above (first column), or the median edge
+// detector of left, above and upper-left (elsewhere). Residuals are mapped to
+// unsigned values (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...) and Rice coded with
+// a parameter k chosen per line and stored in the first 5 bits of the line.
+// A value u is coded as q = u >> k one bits, a zero bit, and the low k bits
+// of u; if q >= COMPRESSION_RICE_ESCAPE, it is instead coded as
+// COMPRESSION_RICE_ESCAPE one bits followed by the 17-bit value. Bits are
+// packed LSB first; blocks are padded to a whole byte.
+struct CompressedFrameHeader {
+    char magic[4]; // "OSCZ"
+    uint16_t version;
+    uint16_t linesPerBlock;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame;   // Index of the acquired frame
+    uint32_t channel; // Index among enabled channels
+    uint32_t numBlocks;
+};
+
+#define COMPRESSION_RICE_ESCAPE 16
+
+// Lossless compression of delivered frames, by line block on a pool of
+// worker threads
+// See FrameCompression.c
+struct FrameCompressor {
+    // Settings
+    bool enabled;
+    bool deliverRawFrames; // Also deliver uncompressed frames as usual
+    uint32_t numThreads;   // Including the calling thread
+    ss8str filePath;       // Append compressed frames here, unless empty
+
+    // Valid while active; used by the thread that processes frames
+    bool active;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numBlocks;
+    size_t blockCapacity; // Worst-case size of one block
+    uint8_t *blockData;   // numBlocks slots of blockCapacity bytes
+    uint32_t *blockSizes; // Bytes used in each slot
+    uint32_t *residuals;  // One line, for the calling thread
+    uint8_t *output;      // Last compressed frame (header, sizes, blocks)
+    size_t outputCapacity;
+    size_t outputSize;
+    FILE *file;
+
+    // Shared with the worker threads
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cv;
+    HANDLE threads[COMPRESSION_MAX_THREADS];
+    uint32_t numWorkers;
+    bool stopRequested;
+    uint32_t generation; // Incremented for each frame
+    const uint16_t *pixels;
+    volatile LONG nextBlock;
+    uint32_t blocksDone;
+    uint32_t workersDone; // Workers finished with the current generation
+};
+
+void InitializeFrameCompressor(struct FrameCompressor *comp);
+void DestroyFrameCompressor(struct FrameCompressor *comp);
+
+OScDev_RichError *StartFrameCompressor(struct FrameCompressor *comp,
+                                       uint32_t width, uint32_t height);
+void StopFrameCompressor(struct FrameCompressor *comp);
+
+void CompressFrame(struct FrameCompressor *comp, const uint16_t *pixels,
+                   uint32_t frame, uint32_t channel);
+OScDev_RichError *WriteCompressedFrame(struct FrameCompressor *comp);
+
+bool DecompressFrame(const void *data, size_t size, uint16_t *pixels,
+                     size_t numPixels);
@@ -0,0 +1,181 @@
+#include "FrameCorrection.h"
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Dark frames and flat fields are raw files containing one frame of
+// native-endian uint16 pixels (as produced by this device), row by row. Their
+// size must match the frame size at the time of acquisition; maps whose size
+// does not match are ignored.
+
+void InitializeFrameCorrection(struct FrameCorrection *corr) {
+    memset(corr, 0, sizeof(*corr));
+    ss8_init(&corr->darkFile);
+    ss8_init(&corr->flatFile);
+}
+
+void DestroyFrameCorrection(struct FrameCorrection *corr) {
+    ss8_destroy(&corr->darkFile);
+    ss8_destroy(&corr->flatFile);
+    free(corr->darkFrame);
+    free(corr->flatFrame);
+    free(corr->flatGains);
+    memset(corr, 0, sizeof(*corr));
+}
+
+static OScDev_RichError *ReadRawFrame(const char *path, uint16_t **frame,
+                                      size_t *numPixels) {
+    *frame = NULL;
+    *numPixels = 0;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return OScDev_Error_Create("Cannot open correction map file");
+
+    OScDev_RichError *err = OScDev_RichError_OK;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        err = OScDev_Error_Create("Cannot determine correction map size");
+        goto cleanup;
+    }
+    long size = ftell(fp);
+    if (size <= 0 || size % sizeof(uint16_t) != 0) {
+        err = OScDev_Error_Create(
+            "Correction map file size is not a whole number of pixels");
+        goto cleanup;
+    }
+    rewind(fp);
+
+    size_t n = (size_t)size / sizeof(uint16_t);
+    uint16_t *buf = malloc(sizeof(uint16_t) * n);
+    if (!buf) {
+        err = OScDev_Error_Create("Out of memory");
+        goto cleanup;
+    }
+    if (fread(buf, sizeof(uint16_t), n, fp) != n) {
+        free(buf);
+        err = OScDev_Error_Create("Failed to read correction map file");
+        goto cleanup;
+    }
+
+    *frame = buf;
+    *numPixels = n;
+
+cleanup:
+    fclose(fp);
+    return err;
+}
+
+OScDev_RichError *LoadDarkFrame(struct FrameCorrection *corr,
+                                const char *path) {
+    uint16_t *frame = NULL;
+    size_t numPixels = 0;
+    if (path[0] != '\0') {
+        OScDev_RichError *err = ReadRawFrame(path, &frame, &numPixels);
+        if (err)
+            return OScDev_Error_Wrap(err, "Failed to load dark frame");
+    }
+
+    free(corr->darkFrame);
+    corr->darkFrame = frame;
+    corr->darkPixels = numPixels;
+    ss8_copy_cstr(&corr->darkFile, path);
+    corr->flatGainsValid = false;
+    return OScDev_RichError_OK;
+}
+
+OScDev_RichError *LoadFlatField(struct FrameCorrection *corr,
+                                const char *path) {
+    uint16_t *frame = NULL;
+    size_t numPixels = 0;
+    if (path[0] != '\0') {
+        OScDev_RichError *err = ReadRawFrame(path, &frame, &numPixels);
+        if (err)
+            return OScDev_Error_Wrap(err, "Failed to load flat field");
+    }
+
+    free(corr->flatFrame);
+    corr->flatFrame = frame;
+    corr->flatPixels = numPixels;
+    ss8_copy_cstr(&corr->flatFile, path);
+    corr->flatGainsValid = false;
+    return OScDev_RichError_OK;
+}
+
+// Replace the dark frame with a captured frame
+OScDev_RichError *SetDarkFrame(struct FrameCorrection *corr,
+                               const uint16_t *frame, size_t numPixels) {
+    if (corr->darkPixels != numPixels || !corr->darkFrame) {
+        free(corr->darkFrame);
+        corr->darkFrame = malloc(sizeof(uint16_t) * numPixels);
+        corr->darkPixels = corr->darkFrame ? numPixels : 0;
+        if (!corr->darkFrame) {
+            ss8_clear(&corr->darkFile);
+            corr->flatGainsValid = false;
+            return OScDev_Error_Create("Out of memory for dark frame");
+        }
+    }
+    memcpy(corr->darkFrame, frame, sizeof(uint16_t) * numPixels);
+    ss8_clear(&corr->darkFile);
+    corr->flatGainsValid = false;
+    return OScDev_RichError_OK;
+}
+
+static OScDev_RichError *ComputeFlatGains(struct FrameCorrection *corr) {
+    size_t n = corr->flatPixels;
+    const uint16_t *flat = corr->flatFrame;
+    const uint16_t *dark = corr->darkPixels == n ? corr->darkFrame : NULL;
+
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t p = 0; p < n; ++p) {
+        int32_t f = flat[p] - (dark ? dark[p] : 0);
+        if (f > 0) {
+            sum += f;
+            ++count;
+        }
+    }
+    double mean = count > 0 ? sum / count : 0.0;
+
+    uint16_t *gains = realloc(corr->flatGains, sizeof(uint16_t) * n);
+    if (!gains)
+        return OScDev_Error_Create("Out of memory for flat-field gains");
+    corr->flatGains = gains;
+    const double one = (double)(1 << FLAT_GAIN_FRAC_BITS);
+    for (size_t p = 0; p < n; ++p) {
+        int32_t f = flat[p] - (dark ? dark[p] : 0);
+        double gain = f > 0 ? one * mean / f : one; // Leave bad pixels as is
+        if (gain > 65535.0)
+            gain = 65535.0;
+        gains[p] = (uint16_t)(gain + 0.5);
+    }
+    corr->flatGainsValid = true;
+    return OScDev_RichError_OK;
+}
+
+// Get the maps to apply to frames of numPixels pixels; either may be NULL.
+// On error, the dark frame is still returned.
+OScDev_RichError *GetFrameCorrectionMaps(struct FrameCorrection *corr,
+                                         size_t numPixels,
+                                         const uint16_t **darkFrame,
+                                         const uint16_t **flatGains) {
+    *darkFrame = NULL;
+    *flatGains = NULL;
+
+    if (corr->darkFrame && corr->darkPixels == numPixels)
+        *darkFrame = corr->darkFrame;
+
+    if (corr->flatFrame && corr->flatPixels == numPixels) {
+        if (!corr->flatGainsValid) {
+            OScDev_RichError *err = ComputeFlatGains(corr);
+            if (err)
+                return err;
+        }
+        *flatGains = corr->flatGains;
+    }
+    return OScDev_RichError_OK;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Flat-field gains are unsigned fixed point with this many fractional bits
+#define FLAT_GAIN_FRAC_BITS 14
+
+// Per-pixel dark frame and flat field for one channel
+// See FrameCorrection.c
+struct FrameCorrection {
+    ss8str darkFile;
+    uint16_t *darkFrame;
+    size_t darkPixels;
+
+    ss8str flatFile;
+    uint16_t *flatFrame;
+    size_t flatPixels;
+
+    // Reciprocal of the dark-subtracted flat field, normalized to its mean;
+    // recomputed when the dark frame or flat field changes
+    uint16_t *flatGains;
+    bool flatGainsValid;
+};
+
+void InitializeFrameCorrection(struct FrameCorrection *corr);
+void DestroyFrameCorrection(struct FrameCorrection *corr);
+
+OScDev_RichError *LoadDarkFrame(struct FrameCorrection *corr,
+                                const char *path);
+OScDev_RichError *LoadFlatField(struct FrameCorrection *corr,
+                                const char *path);
+OScDev_RichError *SetDarkFrame(struct FrameCorrection *corr,
+                               const uint16_t *frame, size_t numPixels);
+
+OScDev_RichError *GetFrameCorrectionMaps(struct FrameCorrection *corr,
+                                         size_t numPixels,
+                                         const uint16_t **darkFrame,
+                                         const uint16_t **flatGains);
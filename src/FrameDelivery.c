@@ -0,0 +1,275 @@
+#include "FrameDelivery.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// Completed frames are handed to a delivery thread through a fixed pool of
+// slots, so that a slow frame callback does not hold up the scan (except
+// with FrameDeliveryPolicy_Block). A slot is free, waiting, or being
+// delivered. When the acquisition's own frame buffers can be given away,
+// they are swapped with the slot's buffers instead of copied.
+
+static const char *const policyNames[] = {
+    "Block",
+    "Drop Oldest",
+    "Drop Newest",
+    "Decimate",
+};
+
+const char *GetFrameDeliveryPolicyName(enum FrameDeliveryPolicy policy) {
+    if (policy >= NumFrameDeliveryPolicies)
+        return NULL;
+    return policyNames[policy];
+}
+
+void InitializeFrameDeliveryQueue(struct FrameDeliveryQueue *q) {
+    memset(q, 0, sizeof(*q));
+    q->policy = FrameDeliveryPolicy_Block;
+    q->capacity = 4;
+    q->decimation = 2;
+    InitializeCriticalSection(&q->lock);
+    InitializeConditionVariable(&q->cv);
+}
+
+static void FreeSlots(struct FrameDeliveryQueue *q) {
+    if (q->slots) {
+        for (uint32_t i = 0; i < q->numSlots; ++i) {
+            for (uint32_t ch = 0; ch < FRAME_DELIVERY_MAX_CHANNELS; ++ch)
+                free(q->slots[i].buffers[ch]);
+        }
+    }
+    free(q->slots);
+    free(q->freeSlots);
+    free(q->waiting);
+    q->slots = NULL;
+    q->freeSlots = NULL;
+    q->waiting = NULL;
+    q->numSlots = 0;
+}
+
+void DestroyFrameDeliveryQueue(struct FrameDeliveryQueue *q) {
+    FreeSlots(q);
+    DeleteCriticalSection(&q->lock);
+}
+
+// Move waiting frames to the free slots; must hold lock
+static void DiscardWaitingFrames(struct FrameDeliveryQueue *q) {
+    while (q->numWaiting > 0) {
+        q->freeSlots[q->numFree++] = q->waiting[q->waitingHead];
+        q->waitingHead = (q->waitingHead + 1) % q->numSlots;
+        --q->numWaiting;
+    }
+}
+
+static DWORD WINAPI DeliveryLoop(void *param) {
+    struct FrameDeliveryQueue *q = param;
+    LARGE_INTEGER start, end;
+
+    EnterCriticalSection(&q->lock);
+    for (;;) {
+        while (q->numWaiting == 0 && !q->stopRequested)
+            SleepConditionVariableCS(&q->cv, &q->lock, INFINITE);
+        if (q->numWaiting == 0 || q->discardRequested || q->hostStopped)
+            break;
+        uint32_t slot = q->waiting[q->waitingHead];
+        q->waitingHead = (q->waitingHead + 1) % q->numSlots;
+        --q->numWaiting;
+        LeaveCriticalSection(&q->lock);
+
+        struct QueuedFrame *queued = &q->slots[slot];
+        QueryPerformanceCounter(&start);
+        if (queued->metadataCallback)
+            queued->metadataCallback(&queued->metadata,
+                                     queued->metadataCallbackData);
+        bool shouldContinue = true;
+        for (uint32_t ch = 0; ch < q->numChannels && shouldContinue; ++ch) {
+            shouldContinue = OScDev_Acquisition_CallFrameCallback(
+                q->acquisition, ch, queued->buffers[ch]);
+        }
+        QueryPerformanceCounter(&end);
+
+        EnterCriticalSection(&q->lock);
+        q->busyCounts += end.QuadPart - start.QuadPart;
+        q->freeSlots[q->numFree++] = slot;
+        ++q->framesDelivered;
+        if (!shouldContinue) {
+            q->hostStopped = true;
+            DiscardWaitingFrames(q);
+        }
+        WakeAllConditionVariable(&q->cv);
+    }
+    DiscardWaitingFrames(q);
+    WakeAllConditionVariable(&q->cv);
+    LeaveCriticalSection(&q->lock);
+    return 0;
+}
+
+OScDev_RichError *StartFrameDelivery(struct FrameDeliveryQueue *q,
+                                     OScDev_Acquisition *acq,
+                                     uint32_t numChannels,
+                                     size_t frameBytes) {
+    if (numChannels > FRAME_DELIVERY_MAX_CHANNELS)
+        return OScDev_Error_Create("Too many channels for frame delivery");
+    uint32_t capacity = q->capacity < 1 ? 1 : q->capacity;
+
+    // Keep the buffers of the last acquisition if they fit
+    if (q->numSlots != capacity + 1 || q->numChannels != numChannels ||
+        q->frameBytes != frameBytes) {
+        FreeSlots(q);
+        q->numSlots = capacity + 1;
+        q->slots = calloc(q->numSlots, sizeof(struct QueuedFrame));
+        q->freeSlots = malloc(sizeof(uint32_t) * q->numSlots);
+        q->waiting = malloc(sizeof(uint32_t) * q->numSlots);
+        bool ok = q->slots && q->freeSlots && q->waiting;
+        for (uint32_t i = 0; ok && i < q->numSlots; ++i) {
+            for (uint32_t ch = 0; ok && ch < numChannels; ++ch) {
+                q->slots[i].buffers[ch] = malloc(frameBytes);
+                ok = q->slots[i].buffers[ch] != NULL;
+            }
+        }
+        if (!ok) {
+            FreeSlots(q);
+            return OScDev_Error_Create("Out of memory for frame delivery");
+        }
+    }
+    q->acquisition = acq;
+    q->numChannels = numChannels;
+    q->frameBytes = frameBytes;
+
+    for (uint32_t i = 0; i < q->numSlots; ++i)
+        q->freeSlots[i] = i;
+    q->numFree = q->numSlots;
+    q->waitingHead = 0;
+    q->numWaiting = 0;
+    q->stopRequested = false;
+    q->discardRequested = false;
+    q->hostStopped = false;
+    EnterCriticalSection(&q->lock);
+    q->framesDelivered = 0;
+    q->framesDropped = 0;
+    q->busyCounts = 0;
+    LeaveCriticalSection(&q->lock);
+
+    DWORD id;
+    q->thread = CreateThread(NULL, 0, DeliveryLoop, q, 0, &id);
+    if (!q->thread)
+        return OScDev_Error_Create("Cannot start frame delivery thread");
+    q->active = true;
+    return OScDev_RichError_OK;
+}
+
+// Wait for the waiting frames to be delivered (unless 'discard' is true) and
+// stop the delivery thread
+void StopFrameDelivery(struct FrameDeliveryQueue *q, bool discard) {
+    if (!q->active)
+        return;
+
+    EnterCriticalSection(&q->lock);
+    q->stopRequested = true;
+    q->discardRequested = discard;
+    WakeAllConditionVariable(&q->cv);
+    LeaveCriticalSection(&q->lock);
+    WaitForSingleObject(q->thread, INFINITE);
+    CloseHandle(q->thread);
+    q->thread = NULL;
+    q->active = false;
+}
+
+// Hand over a completed frame (numChannels buffers of frameBytes) and its
+// metadata, or drop it according to the policy. If 'swapBuffers' is true,
+// the buffers in 'frames' are taken over and replaced with free ones rather
+// than copied. The metadata callback, if any, is called before the frame is
+// delivered.
+void QueueFrame(struct FrameDeliveryQueue *q, void **frames,
+                bool swapBuffers,
+                const struct OScNIDAQ_FrameMetadata *metadata,
+                OScNIDAQ_FrameMetadataCallback metadataCallback,
+                void *metadataCallbackData) {
+    EnterCriticalSection(&q->lock);
+    if (q->hostStopped) {
+        LeaveCriticalSection(&q->lock);
+        return;
+    }
+
+    bool drop = false;
+    if (q->policy == FrameDeliveryPolicy_Decimate &&
+        2 * q->numWaiting >= q->numSlots - 1 &&
+        metadata->frame % q->decimation != 0)
+        drop = true;
+    while (!drop && q->numFree == 0) {
+        if (q->policy == FrameDeliveryPolicy_Block) {
+            SleepConditionVariableCS(&q->cv, &q->lock, INFINITE);
+            if (q->hostStopped) {
+                LeaveCriticalSection(&q->lock);
+                return;
+            }
+        } else if (q->policy == FrameDeliveryPolicy_DropOldest &&
+                   q->numWaiting > 0) {
+            q->freeSlots[q->numFree++] = q->waiting[q->waitingHead];
+            q->waitingHead = (q->waitingHead + 1) % q->numSlots;
+            --q->numWaiting;
+            ++q->framesDropped;
+        } else {
+            drop = true;
+        }
+    }
+    if (drop) {
+        ++q->framesDropped;
+        LeaveCriticalSection(&q->lock);
+        return;
+    }
+    uint32_t slot = q->freeSlots[--q->numFree];
+    LeaveCriticalSection(&q->lock);
+
+    // The slot is ours until it is added to the waiting frames
+    struct QueuedFrame *queued = &q->slots[slot];
+    for (uint32_t ch = 0; ch < q->numChannels; ++ch) {
+        if (swapBuffers) {
+            void *buffer = queued->buffers[ch];
+            queued->buffers[ch] = frames[ch];
+            frames[ch] = buffer;
+        } else {
+            memcpy(queued->buffers[ch], frames[ch], q->frameBytes);
+        }
+    }
+    queued->metadata = *metadata;
+    queued->metadataCallback = metadataCallback;
+    queued->metadataCallbackData = metadataCallbackData;
+
+    EnterCriticalSection(&q->lock);
+    q->waiting[(q->waitingHead + q->numWaiting) % q->numSlots] = slot;
+    ++q->numWaiting;
+    WakeAllConditionVariable(&q->cv);
+    LeaveCriticalSection(&q->lock);
+}
+
+// Return true if the application asked to stop through a frame callback
+bool IsFrameDeliveryStopped(struct FrameDeliveryQueue *q) {
+    EnterCriticalSection(&q->lock);
+    bool stopped = q->hostStopped;
+    LeaveCriticalSection(&q->lock);
+    return stopped;
+}
+
+void GetFrameDeliveryCounts(struct FrameDeliveryQueue *q,
+                            uint32_t *delivered, uint32_t *dropped) {
+    EnterCriticalSection(&q->lock);
+    *delivered = q->framesDelivered;
+    *dropped = q->framesDropped;
+    LeaveCriticalSection(&q->lock);
+}
+
+double GetFrameDeliveryBusySeconds(struct FrameDeliveryQueue *q) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    EnterCriticalSection(&q->lock);
+    LONGLONG counts = q->busyCounts;
+    LeaveCriticalSection(&q->lock);
+    return (double)counts / freq.QuadPart;
+}
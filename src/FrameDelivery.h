@@ -0,0 +1,87 @@
+#pragma once
+
+#include "OpenScanNIDAQ.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+#define FRAME_DELIVERY_MAX_CHANNELS 8
+
+// What to do with a completed frame when the delivery queue is full
+enum FrameDeliveryPolicy {
+    FrameDeliveryPolicy_Block,      // Wait for the application (stalls scan)
+    FrameDeliveryPolicy_DropOldest, // Replace the oldest waiting frame
+    FrameDeliveryPolicy_DropNewest, // Drop the completed frame
+    // Drop the completed frame; also, while the queue is at least half full,
+    // queue only every decimation-th frame
+    FrameDeliveryPolicy_Decimate,
+    NumFrameDeliveryPolicies,
+};
+
+// One frame (all enabled channels) waiting for or undergoing delivery
+struct QueuedFrame {
+    void *buffers[FRAME_DELIVERY_MAX_CHANNELS];
+    struct OScNIDAQ_FrameMetadata metadata;
+    OScNIDAQ_FrameMetadataCallback metadataCallback;
+    void *metadataCallbackData;
+};
+
+// Bounded queue between the acquisition thread and a thread that calls the
+// application's frame callback
+// See FrameDelivery.c
+struct FrameDeliveryQueue {
+    // Settings
+    enum FrameDeliveryPolicy policy;
+    uint32_t capacity;   // Frames that can wait for delivery
+    uint32_t decimation; // For FrameDeliveryPolicy_Decimate
+
+    // Valid while active
+    bool active;
+    OScDev_Acquisition *acquisition;
+    uint32_t numChannels;
+    size_t frameBytes; // Per channel
+    uint32_t numSlots; // capacity + 1 (the frame being delivered)
+    struct QueuedFrame *slots;
+    HANDLE thread;
+
+    // Shared with the delivery thread; protected by lock
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cv;
+    uint32_t *freeSlots; // Stack of slot indices
+    uint32_t numFree;
+    uint32_t *waiting; // Circular FIFO of slot indices
+    uint32_t waitingHead;
+    uint32_t numWaiting;
+    bool stopRequested;
+    bool discardRequested; // Drop waiting frames on stop
+    bool hostStopped;      // A frame callback returned false
+    // Counts since the start of the last acquisition
+    uint32_t framesDelivered;
+    uint32_t framesDropped;
+    LONGLONG busyCounts; // In the application's callbacks
+};
+
+const char *GetFrameDeliveryPolicyName(enum FrameDeliveryPolicy policy);
+
+void InitializeFrameDeliveryQueue(struct FrameDeliveryQueue *q);
+void DestroyFrameDeliveryQueue(struct FrameDeliveryQueue *q);
+
+OScDev_RichError *StartFrameDelivery(struct FrameDeliveryQueue *q,
+                                     OScDev_Acquisition *acq,
+                                     uint32_t numChannels, size_t frameBytes);
+void StopFrameDelivery(struct FrameDeliveryQueue *q, bool discard);
+
+void QueueFrame(struct FrameDeliveryQueue *q, void **frames,
+                bool swapBuffers,
+                const struct OScNIDAQ_FrameMetadata *metadata,
+                OScNIDAQ_FrameMetadataCallback metadataCallback,
+                void *metadataCallbackData);
+bool IsFrameDeliveryStopped(struct FrameDeliveryQueue *q);
+void GetFrameDeliveryCounts(struct FrameDeliveryQueue *q,
+                            uint32_t *delivered, uint32_t *dropped);
+double GetFrameDeliveryBusySeconds(struct FrameDeliveryQueue *q);
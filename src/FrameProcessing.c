@@ -0,0 +1,152 @@
+#include "FrameProcessing.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// The processing stage holds one frame at a time. The acquisition thread
+// exchanges its filled buffers for the stage's spare ones, so it can start
+// the next frame at once; it only waits if the previous frame is still being
+// processed when the next one is complete.
+
+void InitializeFrameProcessor(struct FrameProcessor *proc) {
+    memset(proc, 0, sizeof(*proc));
+    proc->enabled = true;
+    InitializeCriticalSection(&proc->lock);
+    InitializeConditionVariable(&proc->cv);
+}
+
+static void FreeBuffers(struct FrameProcessor *proc) {
+    for (uint32_t ch = 0; ch < FRAME_PROCESSING_MAX_CHANNELS; ++ch) {
+        free(proc->buffers[ch]);
+        proc->buffers[ch] = NULL;
+    }
+    proc->numChannels = 0;
+    proc->frameBytes = 0;
+}
+
+void DestroyFrameProcessor(struct FrameProcessor *proc) {
+    FreeBuffers(proc);
+    DeleteCriticalSection(&proc->lock);
+}
+
+static DWORD WINAPI ProcessingLoop(void *param) {
+    struct FrameProcessor *proc = param;
+    LARGE_INTEGER start, end;
+
+    EnterCriticalSection(&proc->lock);
+    for (;;) {
+        while (!proc->pending && !proc->stopRequested)
+            SleepConditionVariableCS(&proc->cv, &proc->lock, INFINITE);
+        if (!proc->pending)
+            break;
+        LeaveCriticalSection(&proc->lock);
+
+        // The buffers and metadata are ours while pending
+        QueryPerformanceCounter(&start);
+        proc->process(proc->buffers, &proc->metadata, proc->processData);
+        QueryPerformanceCounter(&end);
+
+        EnterCriticalSection(&proc->lock);
+        proc->busyCounts += end.QuadPart - start.QuadPart;
+        proc->pending = false;
+        WakeAllConditionVariable(&proc->cv);
+    }
+    LeaveCriticalSection(&proc->lock);
+    return 0;
+}
+
+OScDev_RichError *StartFrameProcessor(struct FrameProcessor *proc,
+                                      uint32_t numChannels,
+                                      size_t frameBytes,
+                                      FrameProcessingFunc process,
+                                      void *processData) {
+    if (numChannels > FRAME_PROCESSING_MAX_CHANNELS)
+        return OScDev_Error_Create("Too many channels for frame processing");
+
+    // Keep the buffers of the last acquisition if they fit
+    if (proc->numChannels != numChannels || proc->frameBytes != frameBytes) {
+        FreeBuffers(proc);
+        for (uint32_t ch = 0; ch < numChannels; ++ch) {
+            proc->buffers[ch] = malloc(frameBytes);
+            if (!proc->buffers[ch]) {
+                FreeBuffers(proc);
+                return OScDev_Error_Create(
+                    "Out of memory for frame processing");
+            }
+        }
+        proc->numChannels = numChannels;
+        proc->frameBytes = frameBytes;
+    }
+    proc->process = process;
+    proc->processData = processData;
+    proc->framesSubmitted = 0;
+    proc->pending = false;
+    proc->stopRequested = false;
+    EnterCriticalSection(&proc->lock);
+    proc->busyCounts = 0;
+    LeaveCriticalSection(&proc->lock);
+
+    DWORD id;
+    proc->thread = CreateThread(NULL, 0, ProcessingLoop, proc, 0, &id);
+    if (!proc->thread)
+        return OScDev_Error_Create("Cannot start frame processing thread");
+    proc->active = true;
+    return OScDev_RichError_OK;
+}
+
+// Finish processing the pending frame, if any, and stop the thread
+void StopFrameProcessor(struct FrameProcessor *proc) {
+    if (!proc->active)
+        return;
+
+    EnterCriticalSection(&proc->lock);
+    proc->stopRequested = true;
+    WakeAllConditionVariable(&proc->cv);
+    LeaveCriticalSection(&proc->lock);
+    WaitForSingleObject(proc->thread, INFINITE);
+    CloseHandle(proc->thread);
+    proc->thread = NULL;
+    proc->active = false;
+}
+
+// Hand over a completed frame (numChannels buffers of frameBytes), which is
+// exchanged for the stage's spare buffers, once the previous frame has been
+// processed. Return the performance counter ticks spent waiting.
+LONGLONG SubmitFrameForProcessing(
+    struct FrameProcessor *proc, void **frames,
+    const struct OScNIDAQ_FrameMetadata *metadata) {
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+
+    EnterCriticalSection(&proc->lock);
+    while (proc->pending)
+        SleepConditionVariableCS(&proc->cv, &proc->lock, INFINITE);
+    QueryPerformanceCounter(&end);
+
+    for (uint32_t ch = 0; ch < proc->numChannels; ++ch) {
+        void *buffer = proc->buffers[ch];
+        proc->buffers[ch] = frames[ch];
+        frames[ch] = buffer;
+    }
+    proc->metadata = *metadata;
+    proc->pending = true;
+    ++proc->framesSubmitted;
+    WakeAllConditionVariable(&proc->cv);
+    LeaveCriticalSection(&proc->lock);
+    return end.QuadPart - start.QuadPart;
+}
+
+double GetFrameProcessorBusySeconds(struct FrameProcessor *proc) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    EnterCriticalSection(&proc->lock);
+    LONGLONG counts = proc->busyCounts;
+    LeaveCriticalSection(&proc->lock);
+    return (double)counts / freq.QuadPart;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OpenScanNIDAQ.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+#define FRAME_PROCESSING_MAX_CHANNELS 8
+
+// Called on the processing thread with the buffers (one per enabled channel)
+// of a frame whose acquisition is complete. The buffers may be exchanged
+// (e.g. by QueueFrame()) for others of the same size.
+typedef void (*FrameProcessingFunc)(
+    void **buffers, const struct OScNIDAQ_FrameMetadata *metadata,
+    void *data);
+
+// Stage between the acquisition thread, which only drives the hardware, and
+// frame delivery: correction, averaging and compression of frame N run while
+// frame N + 1 is scanned
+// See FrameProcessing.c
+struct FrameProcessor {
+    // Settings
+    bool enabled;
+
+    // Valid while active
+    bool active;
+    uint32_t numChannels;
+    size_t frameBytes; // Per channel
+    FrameProcessingFunc process;
+    void *processData;
+    HANDLE thread;
+    uint32_t framesSubmitted; // Used by the acquisition thread only
+
+    // Shared with the processing thread; protected by lock
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cv;
+    // The frame being processed, or spare buffers when not pending
+    void *buffers[FRAME_PROCESSING_MAX_CHANNELS];
+    struct OScNIDAQ_FrameMetadata metadata;
+    bool pending;
+    bool stopRequested;
+    LONGLONG busyCounts; // Since the start of the last acquisition
+};
+
+void InitializeFrameProcessor(struct FrameProcessor *proc);
+void DestroyFrameProcessor(struct FrameProcessor *proc);
+
+OScDev_RichError *StartFrameProcessor(struct FrameProcessor *proc,
+                                      uint32_t numChannels,
+                                      size_t frameBytes,
+                                      FrameProcessingFunc process,
+                                      void *processData);
+void StopFrameProcessor(struct FrameProcessor *proc);
+
+LONGLONG SubmitFrameForProcessing(
+    struct FrameProcessor *proc, void **frames,
+    const struct OScNIDAQ_FrameMetadata *metadata);
+double GetFrameProcessorBusySeconds(struct FrameProcessor *proc);
@@ -0,0 +1,173 @@
+#include "FrameRing.h"
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// While the ring is active, the frame buffers that the detector callback
+// fills point into the next slot of the ring, so frames are assembled in
+// shared memory without a copy. The slot is marked as being written when the
+// frame starts and published (slot sequence, then writeSequence) once the
+// frame is complete and about to be delivered. A frame that is not delivered
+// (e.g. with frame averaging) is not published, and its slot is reused for
+// the next frame. The protocol for readers is described in FrameRing.h.
+
+void InitializeFrameRing(struct FrameRing *ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->sizeMB = 256;
+    ss8_init(&ring->name);
+    ss8_init(&ring->mappedName);
+}
+
+static void CloseMapping(struct FrameRing *ring) {
+    if (ring->view)
+        UnmapViewOfFile(ring->view);
+    if (ring->mapping)
+        CloseHandle(ring->mapping);
+    ring->view = NULL;
+    ring->mapping = NULL;
+    ring->viewSize = 0;
+    ss8_clear(&ring->mappedName);
+}
+
+void DestroyFrameRing(struct FrameRing *ring) {
+    CloseMapping(ring);
+    ss8_destroy(&ring->name);
+    ss8_destroy(&ring->mappedName);
+}
+
+static OScDev_RichError *OpenMapping(struct FrameRing *ring,
+                                     const char *name) {
+    uint64_t size = (uint64_t)ring->sizeMB * 1024 * 1024;
+    if (ring->view && strcmp(ss8_cstr(&ring->mappedName), name) == 0 &&
+        ring->viewSize == size)
+        return OScDev_RichError_OK;
+    CloseMapping(ring);
+
+    ring->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+                                       PAGE_READWRITE, (DWORD)(size >> 32),
+                                       (DWORD)(size & 0xffffffff), name);
+    if (!ring->mapping)
+        return OScDev_Error_Create("Cannot create shared memory for ring");
+    ring->view = MapViewOfFile(ring->mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!ring->view) {
+        CloseMapping(ring);
+        return OScDev_Error_Create("Cannot map shared memory for ring");
+    }
+
+    // If a reader kept a mapping of the same name alive, we get that one,
+    // which may have a different size
+    MEMORY_BASIC_INFORMATION info;
+    if (VirtualQuery(ring->view, &info, sizeof(info)) == 0) {
+        CloseMapping(ring);
+        return OScDev_Error_Create("Cannot query shared memory for ring");
+    }
+    ring->viewSize = info.RegionSize < size ? info.RegionSize : size;
+    ss8_copy_cstr(&ring->mappedName, name);
+    return OScDev_RichError_OK;
+}
+
+// Lay out the ring for frames of the given size and start publishing
+OScDev_RichError *StartFrameRing(struct FrameRing *ring,
+                                 const char *defaultName,
+                                 uint32_t numChannels, uint32_t width,
+                                 uint32_t height, uint32_t bitsPerPixel) {
+    const char *name =
+        ss8_is_empty(&ring->name) ? defaultName : ss8_cstr(&ring->name);
+    OScDev_RichError *err = OpenMapping(ring, name);
+    if (err)
+        return err;
+
+    // Keep each channel and slot 64-byte aligned
+    uint64_t channelBytes = ((uint64_t)width * height * bitsPerPixel + 7) / 8;
+    uint64_t channelStride = (channelBytes + 63) & ~(uint64_t)63;
+    uint64_t slotSize =
+        FRAME_RING_SLOT_HEADER_SIZE + channelStride * numChannels;
+    uint64_t numSlots = (ring->viewSize - FRAME_RING_HEADER_SIZE) / slotSize;
+    if (ring->viewSize <= FRAME_RING_HEADER_SIZE || numSlots < 2)
+        return OScDev_Error_Create(
+            "Shared memory ring is too small for 2 frames");
+
+    struct FrameRingHeader *header = (struct FrameRingHeader *)ring->view;
+    InterlockedExchange(&header->writerActive, 0);
+    InterlockedIncrement(&header->layoutGeneration);
+    InterlockedExchange64(&header->writeSequence, 0);
+    memcpy(header->magic, "OSNIDAQS", 8);
+    header->version = 3;
+    header->headerSize = FRAME_RING_HEADER_SIZE;
+    header->numSlots = (uint32_t)numSlots;
+    header->numChannels = numChannels;
+    header->width = width;
+    header->height = height;
+    header->bytesPerPixel = bitsPerPixel % 8 == 0 ? bitsPerPixel / 8 : 0;
+    header->slotHeaderSize = FRAME_RING_SLOT_HEADER_SIZE;
+    header->channelStride = channelStride;
+    header->slotSize = slotSize;
+    header->bitsPerPixel = bitsPerPixel;
+    for (uint64_t i = 0; i < numSlots; ++i) {
+        struct FrameRingSlotHeader *slot =
+            (struct FrameRingSlotHeader *)(ring->view +
+                                           FRAME_RING_HEADER_SIZE +
+                                           i * slotSize);
+        InterlockedExchange64(&slot->sequence, 1);
+    }
+    InterlockedIncrement(&header->layoutGeneration);
+    InterlockedExchange(&header->writerActive, 1);
+
+    ring->header = header;
+    ring->nextSequence = 1;
+    ring->active = true;
+    return OScDev_RichError_OK;
+}
+
+// Stop publishing; the mapping stays open for attached readers
+void StopFrameRing(struct FrameRing *ring) {
+    if (!ring->active)
+        return;
+    InterlockedExchange(&ring->header->writerActive, 0);
+    ring->active = false;
+}
+
+static struct FrameRingSlotHeader *GetSlot(struct FrameRing *ring,
+                                           LONG64 sequence) {
+    uint64_t index = (uint64_t)(sequence - 1) % ring->header->numSlots;
+    return (struct FrameRingSlotHeader *)(ring->view +
+                                          FRAME_RING_HEADER_SIZE +
+                                          index * ring->header->slotSize);
+}
+
+// Mark the next slot as being written and point channelBuffers (index is
+// order among enabled channels) to its pixels
+void BeginRingFrame(struct FrameRing *ring, void **channelBuffers) {
+    struct FrameRingSlotHeader *slot = GetSlot(ring, ring->nextSequence);
+    InterlockedExchange64(&slot->sequence, 2 * ring->nextSequence - 1);
+
+    uint8_t *pixels = (uint8_t *)slot + FRAME_RING_SLOT_HEADER_SIZE;
+    for (uint32_t ch = 0; ch < ring->header->numChannels; ++ch)
+        channelBuffers[ch] = pixels + ch * ring->header->channelStride;
+}
+
+// Publish the frame assembled in the slot given by the last BeginRingFrame()
+void PublishRingFrame(struct FrameRing *ring,
+                      const struct OScNIDAQ_FrameMetadata *metadata) {
+    struct FrameRingSlotHeader *slot = GetSlot(ring, ring->nextSequence);
+    slot->frame = metadata->frame;
+    slot->timestamp = metadata->hostTimestamp;
+    slot->timestampFrequency = metadata->timestampFrequency;
+    slot->estimatedFrameStartTimestamp =
+        metadata->estimatedFrameStartTimestamp;
+    slot->samplesRead = metadata->samplesRead;
+    slot->detectorCallbacks = metadata->detectorCallbacks;
+    slot->flags = metadata->flags;
+
+    // Interlocked operations are full barriers, so the pixels and the slot
+    // header are visible before the sequence numbers
+    InterlockedExchange64(&slot->sequence, 2 * ring->nextSequence);
+    InterlockedExchange64(&ring->header->writeSequence, ring->nextSequence);
+    ++ring->nextSequence;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "OpenScanNIDAQ.h"
+
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+#define FRAME_RING_HEADER_SIZE 4096
+#define FRAME_RING_SLOT_HEADER_SIZE 64
+
+// At the start of the shared memory. All fields are little-endian. The
+// layout fields are rewritten (and layoutGeneration incremented) at the start
+// of each acquisition.
+//
+// Protocol for readers, which never block the writer:
+// 1. Read layoutGeneration (g) and writeSequence (s). If g is odd, the
+//    layout is being changed; s == 0 means no frame has been published with
+//    this layout.
+// 2. The frame with sequence number s is in slot (s - 1) % numSlots. Read the
+//    slot's sequence; if it is not 2 * s, the slot is being rewritten (the
+//    reader is too slow): read writeSequence again and retry.
+// 3. Copy the slot's frame data, then read the slot's sequence and
+//    layoutGeneration again; the copy is valid only if they are still 2 * s
+//    and g. Frames may be skipped by following writeSequence, or read in
+//    order by incrementing s as long as s <= writeSequence and
+//    writeSequence - s < numSlots.
+// All reads of the sequence fields must be acquire reads (e.g.
+// InterlockedCompareExchange64(&field, 0, 0) or a read followed by
+// MemoryBarrier()).
+struct FrameRingHeader {
+    char magic[8]; // "OSNIDAQS"
+    uint32_t version;
+    uint32_t headerSize; // Offset of slot 0
+    volatile LONG layoutGeneration;
+    volatile LONG writerActive;    // Nonzero while acquiring
+    volatile LONG64 writeSequence; // Last published frame, starting at 1
+    uint32_t numSlots;
+    uint32_t numChannels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel; // 0 if pixels are packed (see bitsPerPixel)
+    uint32_t slotHeaderSize; // Offset of channel 0 within each slot
+    uint64_t channelStride;  // Bytes from one channel's pixels to the next
+    uint64_t slotSize;       // Bytes from one slot to the next
+    // Since version 2: 16, 8, or 12 for pairs of pixels packed into 3 bytes
+    // (see PixelPacking.h)
+    uint32_t bitsPerPixel;
+};
+
+// At the start of each slot, followed by the pixels of each enabled channel
+// (row by row). The fields after 'sequence' are those of
+// OScNIDAQ_FrameMetadata; those after timestampFrequency exist since
+// version 3.
+struct FrameRingSlotHeader {
+    volatile LONG64 sequence; // 2 * s when frame s is complete, else odd
+    uint64_t frame;           // Index of the acquired frame
+    int64_t timestamp;        // When the last sample of the frame was read
+    int64_t timestampFrequency;
+    int64_t estimatedFrameStartTimestamp;
+    uint64_t samplesRead;
+    uint32_t detectorCallbacks;
+    uint32_t flags;
+};
+
+// Named shared memory into which frames are assembled for other processes
+// See FrameRing.c
+struct FrameRing {
+    // Settings
+    bool enabled;
+    ss8str name;     // Mapping name; empty for default
+    uint32_t sizeMB; // Size of the shared memory
+
+    // The mapping persists between acquisitions so that readers can stay
+    // attached
+    HANDLE mapping;
+    uint8_t *view;
+    size_t viewSize;
+    ss8str mappedName;
+
+    // Valid while active
+    bool active;
+    struct FrameRingHeader *header;
+    LONG64 nextSequence;
+};
+
+void InitializeFrameRing(struct FrameRing *ring);
+void DestroyFrameRing(struct FrameRing *ring);
+
+OScDev_RichError *StartFrameRing(struct FrameRing *ring,
+                                 const char *defaultName,
+                                 uint32_t numChannels, uint32_t width,
+                                 uint32_t height, uint32_t bitsPerPixel);
+void StopFrameRing(struct FrameRing *ring);
+
+void BeginRingFrame(struct FrameRing *ring, void **channelBuffers);
+void PublishRingFrame(struct FrameRing *ring,
+                      const struct OScNIDAQ_FrameMetadata *metadata);
@@ -0,0 +1,77 @@
+#include "FrameStatistics.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Statistics are accumulated over each chunk of pixels right after it has
+// been converted, while it is still in cache, so that computing them does
+// not require another pass over the frame in memory.
+
+void ResetFrameStatistics(struct FrameStatistics *stats) {
+    memset(stats->histogram, 0, sizeof(stats->histogram));
+    stats->sum = 0;
+    stats->count = 0;
+    stats->min = UINT16_MAX;
+    stats->max = 0;
+    stats->numClippedLow = 0;
+    stats->numClippedHigh = 0;
+}
+
+void AccumulateFrameStatistics(struct FrameStatistics *stats,
+                               const uint16_t *pixels, size_t nPixels) {
+    uint32_t *histogram = stats->histogram;
+    uint64_t sum = 0;
+    uint16_t min = stats->min;
+    uint16_t max = stats->max;
+    uint32_t numClippedLow = 0;
+    uint32_t numClippedHigh = 0;
+    for (size_t p = 0; p < nPixels; ++p) {
+        uint16_t pixel = pixels[p];
+        ++histogram[pixel >> STATISTICS_BIN_SHIFT];
+        sum += pixel;
+        if (pixel < min)
+            min = pixel;
+        if (pixel > max)
+            max = pixel;
+        numClippedLow += pixel == 0;
+        numClippedHigh += pixel == UINT16_MAX;
+    }
+
+    stats->sum += sum;
+    stats->count += nPixels;
+    stats->min = min;
+    stats->max = max;
+    stats->numClippedLow += numClippedLow;
+    stats->numClippedHigh += numClippedHigh;
+}
+
+static double HistogramPercentile(const uint32_t *histogram, uint64_t count,
+                                  double fraction) {
+    uint64_t target = (uint64_t)(fraction * count);
+    uint64_t cumulative = 0;
+    for (size_t bin = 0; bin < STATISTICS_HISTOGRAM_BINS; ++bin) {
+        cumulative += histogram[bin];
+        if (cumulative > target)
+            return (double)(bin << STATISTICS_BIN_SHIFT);
+    }
+    return (double)UINT16_MAX;
+}
+
+void SummarizeFrameStatistics(const struct FrameStatistics *stats,
+                              double saturatedFraction,
+                              struct FrameStatisticsSummary *summary) {
+    if (stats->count == 0) {
+        memset(summary, 0, sizeof(*summary));
+        return;
+    }
+
+    summary->min = stats->min;
+    summary->max = stats->max;
+    summary->mean = (double)stats->sum / stats->count;
+    summary->numClippedLow = stats->numClippedLow;
+    summary->numClippedHigh = stats->numClippedHigh;
+    summary->autoContrastLow = HistogramPercentile(
+        stats->histogram, stats->count, saturatedFraction);
+    summary->autoContrastHigh = HistogramPercentile(
+        stats->histogram, stats->count, 1.0 - saturatedFraction);
+}
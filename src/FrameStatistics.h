@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Histogram of the 16-bit pixel values, 16 values per bin
+#define STATISTICS_HISTOGRAM_BINS 4096
+#define STATISTICS_BIN_SHIFT 4
+
+// Statistics of one channel, accumulated while the frame is assembled
+// See FrameStatistics.c
+struct FrameStatistics {
+    uint32_t histogram[STATISTICS_HISTOGRAM_BINS];
+    uint64_t sum;
+    uint64_t count;
+    uint16_t min;
+    uint16_t max;
+    uint32_t numClippedLow;  // Pixels at 0
+    uint32_t numClippedHigh; // Pixels at 65535
+};
+
+// Statistics of the last completed frame of one channel
+struct FrameStatisticsSummary {
+    double min;
+    double max;
+    double mean;
+    double numClippedLow;
+    double numClippedHigh;
+    // Display range that saturates the given fraction of pixels at each end
+    double autoContrastLow;
+    double autoContrastHigh;
+};
+
+void ResetFrameStatistics(struct FrameStatistics *stats);
+void AccumulateFrameStatistics(struct FrameStatistics *stats,
+                               const uint16_t *pixels, size_t nPixels);
+void SummarizeFrameStatistics(const struct FrameStatistics *stats,
+                              double saturatedFraction,
+                              struct FrameStatisticsSummary *summary);
@@ -0,0 +1,242 @@
+#include "FrameTrigger.h"
+
+#include "DAQConfig.h"
+#include "DAQError.h"
+#include "DeviceImplData.h"
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// In timelapse mode, a counter generates a pulse every intervalSec, and the
+// scanner task (which the clock and detector tasks follow) is started on the
+// pulse. The tasks are stopped after each frame and started again (they stay
+// committed), after which they wait for the next pulse, so the frames keep
+// the counter's cadence regardless of host timing. If the tasks are not
+// started again in time, a pulse is missed and the frame waits for the next
+// one. With an external start trigger, the counter waits for it, so that the
+// first pulse follows the external event.
+//
+// The host cannot see the pulses, so the time of each pulse is taken to be
+// that of the first detector sample of the frame it started (see
+// UpdateFrameStartEstimate() in Detector.c). The interval statistics are
+// therefore those of that estimate, which bounds the hardware's jitter from
+// above.
+
+void InitializeFrameTrigger(struct FrameTrigger *trig) {
+    memset(trig, 0, sizeof(*trig));
+    ss8_init_copy_cstr(&trig->counter, "ctr3");
+    trig->parkBetweenFrames = true;
+    InitializeCriticalSection(&trig->lock);
+}
+
+void DestroyFrameTrigger(struct FrameTrigger *trig) {
+    ShutdownFrameTrigger(trig);
+    ss8_destroy(&trig->counter);
+    DeleteCriticalSection(&trig->lock);
+}
+
+static OScDev_RichError *CreateFrameTriggerTask(OScDev_Device *device,
+                                                struct FrameTrigger *trig) {
+    OScDev_RichError *err;
+    err = CreateDAQmxError(DAQmxCreateTask("FrameTrigger", &trig->coTask));
+    if (err)
+        return OScDev_Error_Wrap(err, "Failed to create frame trigger task");
+
+    ss8str ctrTerms;
+    ss8_init_copy(&ctrTerms, &GetImplData(device)->deviceName);
+    ss8_cat_ch(&ctrTerms, '/');
+    ss8_cat(&ctrTerms, &trig->counter);
+    err = CreateDAQmxError(DAQmxCreateCOPulseChanFreq(
+        trig->coTask, ss8_cstr(&ctrTerms), "FrameTriggerCTR", DAQmx_Val_Hz,
+        DAQmx_Val_Low, 0.0, 1.0 / trig->intervalSec, 0.5));
+    ss8_destroy(&ctrTerms);
+    if (err)
+        return OScDev_Error_Wrap(
+            err, "Failed to create frame trigger co pulse channel");
+
+    err = CreateDAQmxError(
+        DAQmxCfgImplicitTiming(trig->coTask, DAQmx_Val_ContSamps, 1000));
+    if (err)
+        return OScDev_Error_Wrap(
+            err, "Failed to configure timing for frame trigger");
+    return OScDev_RichError_OK;
+}
+
+// Initialize, configure, and commit the counter for the current interval
+OScDev_RichError *SetUpFrameTrigger(OScDev_Device *device,
+                                    struct FrameTrigger *trig) {
+    OScDev_RichError *err;
+    if (!trig->coTask) {
+        err = CreateFrameTriggerTask(device, trig);
+        if (err)
+            goto error;
+    } else {
+        err = CreateDAQmxError(DAQmxSetChanAttribute(
+            trig->coTask, "", DAQmx_CO_Pulse_Freq, 1.0 / trig->intervalSec));
+        if (err) {
+            err = OScDev_Error_Wrap(err,
+                                    "Failed to set frame trigger frequency");
+            goto error;
+        }
+    }
+
+    if (GetImplData(device)->configuredExternalTrigger) {
+        ss8str trigSrc;
+        ss8_init(&trigSrc);
+        GetExternalTriggerSource(device, &trigSrc);
+        err = CreateDAQmxError(DAQmxCfgDigEdgeStartTrig(
+            trig->coTask, ss8_cstr(&trigSrc),
+            GetImplData(device)->externalTriggerFallingEdge
+                ? DAQmx_Val_Falling
+                : DAQmx_Val_Rising));
+        ss8_destroy(&trigSrc);
+    } else {
+        err = CreateDAQmxError(DAQmxDisableStartTrig(trig->coTask));
+    }
+    if (err) {
+        err = OScDev_Error_Wrap(err,
+                                "Failed to configure frame trigger start");
+        goto error;
+    }
+
+    err = CreateDAQmxError(
+        DAQmxTaskControl(trig->coTask, DAQmx_Val_Task_Commit));
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to commit frame trigger task");
+        goto error;
+    }
+    return OScDev_RichError_OK;
+
+error:
+    if (ShutdownFrameTrigger(trig))
+        err = OScDev_Error_Wrap(
+            err, "Failed to clean up frame trigger task after error");
+    return err;
+}
+
+// Remove all DAQmx configuration for the frame trigger
+OScDev_RichError *ShutdownFrameTrigger(struct FrameTrigger *trig) {
+    if (trig->coTask) {
+        OScDev_RichError *err =
+            CreateDAQmxError(DAQmxClearTask(trig->coTask));
+        trig->coTask = 0;
+        if (err)
+            return OScDev_Error_Wrap(err,
+                                     "Failed to clear frame trigger task");
+    }
+    return OScDev_RichError_OK;
+}
+
+// Start the pulses (or wait for the external trigger to start them); the
+// scanner task must already be waiting for the first
+OScDev_RichError *StartFrameTrigger(struct FrameTrigger *trig) {
+    if (trig->running)
+        return OScDev_RichError_OK;
+
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    OScDev_RichError *err = CreateDAQmxError(DAQmxStartTask(trig->coTask));
+    QueryPerformanceCounter(&now);
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to start frame trigger task");
+        ShutdownFrameTrigger(trig); // Force re-setup next time
+        return err;
+    }
+
+    trig->countsPerSecond = freq.QuadPart;
+    trig->intervalCounts = (LONGLONG)(trig->intervalSec * freq.QuadPart);
+    trig->lastPulseCounts = now.QuadPart;
+    trig->haveFrameStart = false;
+    EnterCriticalSection(&trig->lock);
+    trig->numIntervals = 0;
+    trig->missedPulses = 0;
+    trig->sumIntervalSec = 0.0;
+    trig->sumSqErrorSec = 0.0;
+    trig->maxAbsErrorSec = 0.0;
+    LeaveCriticalSection(&trig->lock);
+    trig->running = true;
+    return OScDev_RichError_OK;
+}
+
+void StopFrameTrigger(struct FrameTrigger *trig) {
+    if (!trig->running)
+        return;
+    if (DAQmxStopTask(trig->coTask) < 0)
+        ShutdownFrameTrigger(trig); // Force re-setup next time
+    trig->running = false;
+}
+
+// Get the terminal (e.g. "/Dev1/Ctr3InternalOutput") carrying the pulses
+void GetFrameTriggerTerminal(OScDev_Device *device, struct FrameTrigger *trig,
+                             ss8str *terminal) {
+    ss8_copy_cstr(terminal, "/");
+    ss8_cat(terminal, &GetImplData(device)->deviceName);
+    ss8_cat_ch(terminal, '/');
+    size_t start = ss8_len(terminal);
+    ss8_cat(terminal, &trig->counter);
+    ss8_cat_cstr(terminal, "InternalOutput");
+    char *name = ss8_mutable_cstr(terminal) + start;
+    *name = (char)toupper((unsigned char)*name);
+}
+
+// Account for the start of a frame, given the estimated time of its first
+// sample
+void RecordFrameTriggerStart(struct FrameTrigger *trig,
+                             LONGLONG frameStartCounts) {
+    if (trig->haveFrameStart) {
+        LONGLONG interval = frameStartCounts - trig->lastPulseCounts;
+        LONGLONG pulses =
+            (interval + trig->intervalCounts / 2) / trig->intervalCounts;
+        if (pulses < 1)
+            pulses = 1;
+        double intervalSec = (double)interval / trig->countsPerSecond;
+        double errorSec = (double)(interval - pulses * trig->intervalCounts) /
+                          trig->countsPerSecond;
+
+        EnterCriticalSection(&trig->lock);
+        ++trig->numIntervals;
+        trig->missedPulses += (uint32_t)(pulses - 1);
+        trig->sumIntervalSec += intervalSec;
+        trig->sumSqErrorSec += errorSec * errorSec;
+        if (fabs(errorSec) > trig->maxAbsErrorSec)
+            trig->maxAbsErrorSec = fabs(errorSec);
+        LeaveCriticalSection(&trig->lock);
+    }
+    trig->lastPulseCounts = frameStartCounts;
+    trig->haveFrameStart = true;
+}
+
+// Estimate the time of the first pulse after nowCounts. Estimates are
+// anchored to the last frame start, so that the drift between the host and
+// DAQ clocks does not accumulate.
+LONGLONG GetNextFrameTriggerCounts(struct FrameTrigger *trig,
+                                   LONGLONG nowCounts) {
+    LONGLONG elapsed = nowCounts - trig->lastPulseCounts;
+    if (elapsed < 0)
+        return trig->lastPulseCounts;
+    return trig->lastPulseCounts +
+           (elapsed / trig->intervalCounts + 1) * trig->intervalCounts;
+}
+
+void GetFrameIntervalStatistics(struct FrameTrigger *trig,
+                                uint32_t *numIntervals, double *meanSec,
+                                double *rmsJitterSec, double *maxJitterSec,
+                                uint32_t *missedPulses) {
+    EnterCriticalSection(&trig->lock);
+    uint32_t n = trig->numIntervals;
+    *numIntervals = n;
+    *meanSec = n ? trig->sumIntervalSec / n : 0.0;
+    *rmsJitterSec = n ? sqrt(trig->sumSqErrorSec / n) : 0.0;
+    *maxJitterSec = trig->maxAbsErrorSec;
+    *missedPulses = trig->missedPulses;
+    LeaveCriticalSection(&trig->lock);
+}
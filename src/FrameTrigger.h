@@ -0,0 +1,57 @@
+#pragma once
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+// Counter output whose pulses start the frames at a fixed interval
+// (timelapse), and the intervals achieved
+// See FrameTrigger.c
+struct FrameTrigger {
+    // Settings
+    double intervalSec;     // 0 to start each frame when the last is done
+    ss8str counter;         // Counter generating the pulses, e.g. "ctr3"
+    bool parkBetweenFrames; // Park the galvos while waiting for a pulse
+
+    TaskHandle coTask;
+
+    // Valid while running; in the QueryPerformanceCounter() timebase
+    bool running;
+    LONGLONG countsPerSecond;
+    LONGLONG intervalCounts;
+    LONGLONG lastPulseCounts; // Estimated time of the last pulse used
+    bool haveFrameStart;      // lastPulseCounts is that of a frame start
+
+    // Of the current or last acquisition; protected by lock
+    CRITICAL_SECTION lock;
+    uint32_t numIntervals;
+    uint32_t missedPulses; // Pulses that came while the frame was not armed
+    double sumIntervalSec;
+    double sumSqErrorSec; // Error is the interval minus its nominal value
+    double maxAbsErrorSec;
+};
+
+void InitializeFrameTrigger(struct FrameTrigger *trig);
+void DestroyFrameTrigger(struct FrameTrigger *trig);
+
+OScDev_RichError *SetUpFrameTrigger(OScDev_Device *device,
+                                    struct FrameTrigger *trig);
+OScDev_RichError *ShutdownFrameTrigger(struct FrameTrigger *trig);
+OScDev_RichError *StartFrameTrigger(struct FrameTrigger *trig);
+void StopFrameTrigger(struct FrameTrigger *trig);
+void GetFrameTriggerTerminal(OScDev_Device *device, struct FrameTrigger *trig,
+                             ss8str *terminal);
+
+void RecordFrameTriggerStart(struct FrameTrigger *trig,
+                             LONGLONG frameStartCounts);
+LONGLONG GetNextFrameTriggerCounts(struct FrameTrigger *trig,
+                                   LONGLONG nowCounts);
+void GetFrameIntervalStatistics(struct FrameTrigger *trig,
+                                uint32_t *numIntervals, double *meanSec,
+                                double *rmsJitterSec, double *maxJitterSec,
+                                uint32_t *missedPulses);
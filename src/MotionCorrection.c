@@ -0,0 +1,415 @@
+#include "MotionCorrection.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// The acquisition thread downsamples the registration channel of each frame
+// into 'input' (box filter, mean subtracted, tapered with a Hann window so
+// that the frame edges do not correlate, and zero padded to a square power
+// of 2) as soon as the frame is complete, and hands it to the worker thread.
+// The worker computes the normalized cross-power spectrum against the
+// reference (the first frame) and locates the correlation peak, with
+// parabolic subpixel interpolation. Only one frame is in flight at a time:
+// when shifts are only reported, the result is collected when the next frame
+// is submitted, so that the correlation overlaps the next frame's scan; when
+// shifts are applied, the acquisition thread waits for the result before
+// delivering the frame.
+
+void InitializeMotionCorrection(struct MotionCorrection *mc) {
+    memset(mc, 0, sizeof(*mc));
+    mc->downsample = 4;
+    InitializeCriticalSection(&mc->lock);
+    InitializeConditionVariable(&mc->cv);
+}
+
+static void DestroyFFTPlan(struct FFTPlan *plan) {
+    free(plan->bitReverse);
+    free(plan->cosTable);
+    free(plan->sinTable);
+    memset(plan, 0, sizeof(*plan));
+}
+
+static bool CreateFFTPlan(struct FFTPlan *plan, uint32_t n) {
+    if (plan->n == n)
+        return true;
+    DestroyFFTPlan(plan);
+    plan->bitReverse = malloc(sizeof(uint32_t) * n);
+    plan->cosTable = malloc(sizeof(double) * (n / 2));
+    plan->sinTable = malloc(sizeof(double) * (n / 2));
+    if (!plan->bitReverse || !plan->cosTable || !plan->sinTable) {
+        DestroyFFTPlan(plan);
+        return false;
+    }
+
+    uint32_t bits = 0;
+    while ((1u << bits) < n)
+        ++bits;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan->bitReverse[i] = r;
+    }
+    const double twoPi = 6.283185307179586;
+    for (uint32_t k = 0; k < n / 2; ++k) {
+        plan->cosTable[k] = cos(twoPi * k / n);
+        plan->sinTable[k] = sin(twoPi * k / n);
+    }
+    plan->n = n;
+    return true;
+}
+
+static void FreeBuffers(struct MotionCorrection *mc) {
+    free(mc->input);
+    free(mc->window);
+    free(mc->work);
+    free(mc->reference);
+    mc->input = NULL;
+    mc->window = NULL;
+    mc->work = NULL;
+    mc->reference = NULL;
+}
+
+void DestroyMotionCorrection(struct MotionCorrection *mc) {
+    FreeBuffers(mc);
+    DestroyFFTPlan(&mc->plan);
+    DeleteCriticalSection(&mc->lock);
+}
+
+// In-place complex FFT of n elements spaced 'stride' complex elements apart.
+// The inverse is not normalized.
+static void FFT1D(const struct FFTPlan *plan, double *x, size_t stride,
+                  bool inverse) {
+    uint32_t n = plan->n;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t j = plan->bitReverse[i];
+        if (j > i) {
+            double *a = x + 2 * i * stride;
+            double *b = x + 2 * j * stride;
+            double re = a[0], im = a[1];
+            a[0] = b[0];
+            a[1] = b[1];
+            b[0] = re;
+            b[1] = im;
+        }
+    }
+
+    double sign = inverse ? 1.0 : -1.0;
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        uint32_t half = len / 2;
+        uint32_t tableStep = n / len;
+        for (uint32_t start = 0; start < n; start += len) {
+            for (uint32_t k = 0; k < half; ++k) {
+                double wr = plan->cosTable[k * tableStep];
+                double wi = sign * plan->sinTable[k * tableStep];
+                double *a = x + 2 * (start + k) * stride;
+                double *b = x + 2 * (start + k + half) * stride;
+                double tr = b[0] * wr - b[1] * wi;
+                double ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+// In-place 2D FFT of an n x n complex array. Rows at and after 'usedRows' are
+// known to be zero (forward transform only) and are skipped.
+static void FFT2D(const struct FFTPlan *plan, double *x, uint32_t usedRows,
+                  bool inverse) {
+    uint32_t n = plan->n;
+    for (uint32_t r = 0; r < usedRows; ++r)
+        FFT1D(plan, x + 2 * (size_t)r * n, 1, inverse);
+    for (uint32_t c = 0; c < n; ++c)
+        FFT1D(plan, x + 2 * (size_t)c, n, inverse);
+}
+
+// Offset of the peak from the center sample, by fitting a parabola to the
+// sample and its neighbors
+static double SubpixelOffset(double left, double center, double right) {
+    double denom = left - 2.0 * center + right;
+    if (denom == 0.0)
+        return 0.0;
+    double offset = 0.5 * (left - right) / denom;
+    if (offset < -0.5 || offset > 0.5)
+        return 0.0;
+    return offset;
+}
+
+static double WrapShift(double s, uint32_t n) {
+    return s > n / 2 ? s - n : s;
+}
+
+static void EstimateShift(struct MotionCorrection *mc,
+                          struct MotionShift *shift) {
+    uint32_t n = mc->plan.n;
+    size_t count = (size_t)n * n;
+    double *work = mc->work;
+    for (size_t i = 0; i < count; ++i) {
+        work[2 * i] = mc->input[i];
+        work[2 * i + 1] = 0.0;
+    }
+    FFT2D(&mc->plan, work, mc->usedHeight, false);
+
+    if (!mc->hasReference) {
+        memcpy(mc->reference, work, sizeof(double) * 2 * count);
+        mc->hasReference = true;
+        shift->dx = 0.0;
+        shift->dy = 0.0;
+        shift->peak = 1.0;
+        return;
+    }
+
+    // Normalized cross-power spectrum F * conj(R) / |F * conj(R)|
+    const double *ref = mc->reference;
+    for (size_t i = 0; i < count; ++i) {
+        double a = work[2 * i], b = work[2 * i + 1];
+        double c = ref[2 * i], d = ref[2 * i + 1];
+        double re = a * c + b * d;
+        double im = b * c - a * d;
+        double mag = sqrt(re * re + im * im);
+        if (mag > 1e-12) {
+            re /= mag;
+            im /= mag;
+        } else {
+            re = im = 0.0;
+        }
+        work[2 * i] = re;
+        work[2 * i + 1] = im;
+    }
+    FFT2D(&mc->plan, work, n, true);
+
+    size_t peakIndex = 0;
+    double peak = work[0];
+    for (size_t i = 1; i < count; ++i) {
+        if (work[2 * i] > peak) {
+            peak = work[2 * i];
+            peakIndex = i;
+        }
+    }
+    uint32_t px = (uint32_t)(peakIndex % n);
+    uint32_t py = (uint32_t)(peakIndex / n);
+    uint32_t mask = n - 1;
+    double left = work[2 * ((size_t)py * n + ((px - 1) & mask))];
+    double right = work[2 * ((size_t)py * n + ((px + 1) & mask))];
+    double up = work[2 * ((size_t)((py - 1) & mask) * n + px)];
+    double down = work[2 * ((size_t)((py + 1) & mask) * n + px)];
+    double sx = WrapShift(px + SubpixelOffset(left, peak, right), n);
+    double sy = WrapShift(py + SubpixelOffset(up, peak, down), n);
+
+    shift->dx = sx * mc->factor;
+    shift->dy = sy * mc->factor;
+    shift->peak = peak / count;
+}
+
+static DWORD WINAPI MotionWorkerLoop(void *param) {
+    struct MotionCorrection *mc = param;
+
+    EnterCriticalSection(&mc->lock);
+    for (;;) {
+        while (!mc->jobPending && !mc->stopRequested)
+            SleepConditionVariableCS(&mc->cv, &mc->lock, INFINITE);
+        if (mc->stopRequested)
+            break;
+        uint32_t frame = mc->jobFrame;
+        LeaveCriticalSection(&mc->lock);
+
+        struct MotionShift shift;
+        EstimateShift(mc, &shift);
+        shift.frame = frame;
+
+        EnterCriticalSection(&mc->lock);
+        mc->result = shift;
+        mc->jobPending = false;
+        WakeAllConditionVariable(&mc->cv);
+    }
+    LeaveCriticalSection(&mc->lock);
+    return 0;
+}
+
+static void FillHannWindow(double *window, uint32_t len) {
+    const double twoPi = 6.283185307179586;
+    for (uint32_t i = 0; i < len; ++i)
+        window[i] = 0.5 - 0.5 * cos(twoPi * (i + 0.5) / len);
+}
+
+// Prepare for a new acquisition and start the worker thread; return false if
+// out of resources
+bool StartMotionCorrection(struct MotionCorrection *mc, uint32_t width,
+                           uint32_t height) {
+    uint32_t factor = mc->downsample > 0 ? mc->downsample : 1;
+    while (width / factor > MOTION_CORRECTION_MAX_FFT_SIZE ||
+           height / factor > MOTION_CORRECTION_MAX_FFT_SIZE)
+        factor *= 2;
+    uint32_t usedWidth = width / factor;
+    uint32_t usedHeight = height / factor;
+    if (usedWidth < 2 || usedHeight < 2)
+        return false;
+    uint32_t n = 2;
+    while (n < usedWidth || n < usedHeight)
+        n *= 2;
+
+    bool sizeChanged = n != mc->plan.n;
+    if (!CreateFFTPlan(&mc->plan, n))
+        return false;
+    size_t count = (size_t)n * n;
+    if (sizeChanged || !mc->input) {
+        FreeBuffers(mc);
+        mc->input = malloc(sizeof(double) * count);
+        mc->work = malloc(sizeof(double) * 2 * count);
+        mc->reference = malloc(sizeof(double) * 2 * count);
+        mc->window = malloc(sizeof(double) * 2 * n);
+        if (!mc->input || !mc->window || !mc->work || !mc->reference) {
+            FreeBuffers(mc);
+            DestroyFFTPlan(&mc->plan);
+            return false;
+        }
+    }
+    memset(mc->input, 0, sizeof(double) * count);
+    FillHannWindow(mc->window, usedWidth);
+    FillHannWindow(mc->window + usedWidth, usedHeight);
+
+    mc->width = width;
+    mc->height = height;
+    mc->factor = factor;
+    mc->usedWidth = usedWidth;
+    mc->usedHeight = usedHeight;
+    mc->hasReference = false;
+    mc->jobInFlight = false;
+    mc->jobPending = false;
+    mc->stopRequested = false;
+
+    DWORD id;
+    mc->thread = CreateThread(NULL, 0, MotionWorkerLoop, mc, 0, &id);
+    if (!mc->thread)
+        return false;
+    mc->active = true;
+    return true;
+}
+
+// Stop the worker thread; any uncollected result is discarded
+void StopMotionCorrection(struct MotionCorrection *mc) {
+    if (!mc->active)
+        return;
+
+    EnterCriticalSection(&mc->lock);
+    mc->stopRequested = true;
+    WakeAllConditionVariable(&mc->cv);
+    LeaveCriticalSection(&mc->lock);
+    WaitForSingleObject(mc->thread, INFINITE);
+    CloseHandle(mc->thread);
+    mc->thread = NULL;
+    mc->active = false;
+    mc->jobInFlight = false;
+}
+
+// Downsample the frame and start computing its shift. The result of the
+// previously submitted frame must have been collected.
+void SubmitMotionFrame(struct MotionCorrection *mc, const uint16_t *frame,
+                       uint32_t frameIndex) {
+    uint32_t n = mc->plan.n;
+    uint32_t f = mc->factor;
+    double scale = 1.0 / ((double)f * f);
+    double sum = 0.0;
+    for (uint32_t y = 0; y < mc->usedHeight; ++y) {
+        double *dst = mc->input + (size_t)y * n;
+        for (uint32_t x = 0; x < mc->usedWidth; ++x)
+            dst[x] = 0.0;
+        for (uint32_t r = 0; r < f; ++r) {
+            const uint16_t *src = frame + (size_t)(y * f + r) * mc->width;
+            for (uint32_t x = 0; x < mc->usedWidth; ++x) {
+                uint32_t s = 0;
+                for (uint32_t c = 0; c < f; ++c)
+                    s += src[x * f + c];
+                dst[x] += s;
+            }
+        }
+        for (uint32_t x = 0; x < mc->usedWidth; ++x) {
+            dst[x] *= scale;
+            sum += dst[x];
+        }
+    }
+
+    // Subtract the mean and taper to zero at the edges
+    double mean = sum / ((double)mc->usedWidth * mc->usedHeight);
+    const double *windowX = mc->window;
+    const double *windowY = mc->window + mc->usedWidth;
+    for (uint32_t y = 0; y < mc->usedHeight; ++y) {
+        double *dst = mc->input + (size_t)y * n;
+        for (uint32_t x = 0; x < mc->usedWidth; ++x)
+            dst[x] = (dst[x] - mean) * windowX[x] * windowY[y];
+    }
+
+    EnterCriticalSection(&mc->lock);
+    mc->jobFrame = frameIndex;
+    mc->jobPending = true;
+    WakeAllConditionVariable(&mc->cv);
+    LeaveCriticalSection(&mc->lock);
+    mc->jobInFlight = true;
+}
+
+// Wait for the shift of the submitted frame; return false if no frame is in
+// flight
+bool CollectMotionShift(struct MotionCorrection *mc,
+                        struct MotionShift *shift) {
+    if (!mc->active || !mc->jobInFlight)
+        return false;
+
+    EnterCriticalSection(&mc->lock);
+    while (mc->jobPending)
+        SleepConditionVariableCS(&mc->cv, &mc->lock, INFINITE);
+    *shift = mc->result;
+    LeaveCriticalSection(&mc->lock);
+    mc->jobInFlight = false;
+    return true;
+}
+
+// Copy src[x + sx] to dst[x], filling with zero outside the row; dst and src
+// may be the same row
+static void ShiftRow(uint16_t *dst, const uint16_t *src, uint32_t width,
+                     int32_t sx) {
+    if (sx >= 0) {
+        memmove(dst, src + sx, sizeof(uint16_t) * (width - sx));
+        memset(dst + width - sx, 0, sizeof(uint16_t) * sx);
+    } else {
+        memmove(dst - sx, src, sizeof(uint16_t) * (width + sx));
+        memset(dst, 0, sizeof(uint16_t) * -sx);
+    }
+}
+
+// Move the frame by the opposite of the shift, rounded to whole pixels, so
+// that it aligns with the reference. Pixels moved in from outside the frame
+// are set to zero.
+void ApplyMotionShift(const struct MotionCorrection *mc, uint16_t *frame,
+                      const struct MotionShift *shift) {
+    uint32_t width = mc->width;
+    uint32_t height = mc->height;
+    int32_t sx = (int32_t)lround(shift->dx);
+    int32_t sy = (int32_t)lround(shift->dy);
+    if (sx == 0 && sy == 0)
+        return;
+    if (sx >= (int32_t)width || -sx >= (int32_t)width ||
+        sy >= (int32_t)height || -sy >= (int32_t)height) {
+        memset(frame, 0, sizeof(uint16_t) * width * height);
+        return;
+    }
+
+    // Row y receives row y + sy; iterate so that source rows are read
+    // before they are overwritten
+    for (uint32_t i = 0; i < height; ++i) {
+        uint32_t y = sy >= 0 ? i : height - 1 - i;
+        int64_t srcY = (int64_t)y + sy;
+        uint16_t *dst = frame + (size_t)y * width;
+        if (srcY < 0 || srcY >= height)
+            memset(dst, 0, sizeof(uint16_t) * width);
+        else
+            ShiftRow(dst, frame + (size_t)srcY * width, width, sx);
+    }
+}
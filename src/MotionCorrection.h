@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+// Largest FFT size (per dimension) used for registration; frames are
+// downsampled further if necessary
+#define MOTION_CORRECTION_MAX_FFT_SIZE 256
+
+// Cached tables for complex radix-2 FFTs of one size
+struct FFTPlan {
+    uint32_t n; // Power of 2
+    uint32_t *bitReverse;
+    double *cosTable; // cos(2 pi k / n), k < n / 2
+    double *sinTable; // sin(2 pi k / n), k < n / 2
+};
+
+// Displacement of a frame relative to the reference, in full-resolution
+// pixels
+struct MotionShift {
+    uint32_t frame; // Index of the frame in the acquisition
+    double dx;
+    double dy;
+    double peak; // Normalized phase correlation peak (0-1)
+};
+
+// Rigid registration of each frame against the first frame of the
+// acquisition, by phase correlation of downsampled copies. The correlation
+// runs on a worker thread while frames continue to be processed.
+// See MotionCorrection.c
+struct MotionCorrection {
+    // Settings
+    bool enabled;
+    bool applyShift;     // Shift the frames in place
+    uint32_t channel;    // Index among enabled channels
+    uint32_t downsample; // Requested downsampling factor
+
+    // Valid while active; used by the thread that processes frames except
+    // as noted
+    bool active;
+    uint32_t width;
+    uint32_t height;
+    uint32_t factor;     // Effective downsampling factor
+    uint32_t usedWidth;  // Downsampled frame size
+    uint32_t usedHeight; // (the rest of the FFT input is zero)
+    bool jobInFlight;    // Submitted but not collected
+    struct FFTPlan plan; // Worker only
+    double *input;       // Downsampled frame (n * n)
+    double *window;      // Hann window (usedWidth, then usedHeight)
+    double *work;        // Worker only; complex, interleaved
+    double *reference;   // Worker only; complex spectrum
+    bool hasReference;   // Worker only
+
+    // Shared with the worker thread
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cv;
+    HANDLE thread;
+    bool stopRequested;
+    bool jobPending; // Input ready, result not yet computed
+    uint32_t jobFrame;
+    struct MotionShift result;
+};
+
+void InitializeMotionCorrection(struct MotionCorrection *mc);
+void DestroyMotionCorrection(struct MotionCorrection *mc);
+
+bool StartMotionCorrection(struct MotionCorrection *mc, uint32_t width,
+                           uint32_t height);
+void StopMotionCorrection(struct MotionCorrection *mc);
+
+void SubmitMotionFrame(struct MotionCorrection *mc, const uint16_t *frame,
+                       uint32_t frameIndex);
+bool CollectMotionShift(struct MotionCorrection *mc,
+                        struct MotionShift *shift);
+void ApplyMotionShift(const struct MotionCorrection *mc, uint16_t *frame,
+                      const struct MotionShift *shift);
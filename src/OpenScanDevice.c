@@ -4,6 +4,7 @@
 #include "DAQConfig.h"
 #include "DAQError.h"
 #include "DeviceImplData.h"
+#include "Extension.h"
 #include "OpenScanSettings.h"
 
 #include <NIDAQmx.h>
@@ -61,6 +62,7 @@ static OScDev_Error NIDAQEnumerateInstances(OScDev_PtrArray **devices) {
             goto finish;
         }
         OScDev_PtrArray_Append(*devices, device);
+        RegisterExtensionDevice(device);
 
         if (stop == SIZE_MAX)
             break;
@@ -78,8 +80,28 @@ finish:
 }
 
 static OScDev_Error NIDAQReleaseInstance(OScDev_Device *device) {
+    UnregisterExtensionDevice(device);
     ss8_destroy(&GetImplData(device)->deviceName);
+    ss8_destroy(&GetImplData(device)->externalTriggerTerminal);
+    ss8_destroy(&GetImplData(device)->externalClockTerminal);
     ss8_destroy(&GetImplData(device)->aiPhysChans);
+    DestroyEventQueue(&GetImplData(device)->acqEvents);
+    DestroyRawRecording(&GetImplData(device)->rawRecording);
+    DestroyFrameAverager(&GetImplData(device)->frameAverager);
+    DestroyMotionCorrection(&GetImplData(device)->motionCorrection);
+    DestroyFrameCompressor(&GetImplData(device)->frameCompressor);
+    DestroyFrameRing(&GetImplData(device)->frameRing);
+    DestroyFrameDeliveryQueue(&GetImplData(device)->frameDelivery);
+    DestroyFrameProcessor(&GetImplData(device)->frameProcessor);
+    DestroyFrameTrigger(&GetImplData(device)->frameTrigger);
+    DestroyTaskDoneSignal(&GetImplData(device)->scannerConfig.aoDone);
+    DestroyScannerConfig(&GetImplData(device)->scannerConfig);
+    if (GetImplData(device)->acquisition.abortEvent)
+        CloseHandle(GetImplData(device)->acquisition.abortEvent);
+    for (int i = 0; i < MAX_PHYSICAL_CHANS; ++i) {
+        ss8_destroy(&GetImplData(device)->channelCounter[i]);
+        DestroyFrameCorrection(&GetImplData(device)->frameCorrection[i]);
+    }
     free(GetImplData(device));
     return OScDev_OK;
 }
@@ -177,10 +199,14 @@ static OScDev_Error NIDAQGetNumberOfChannels(OScDev_Device *device,
     return OScDev_OK;
 }
 
+// Packed 12-bit frames are not delivered through OpenScanLib (only to the
+// shared memory ring), so report 16-bit samples for them
 static OScDev_Error NIDAQGetBytesPerSample(OScDev_Device *device,
                                            uint32_t *bytesPerSample) {
-    (void)device; // Unused
-    *bytesPerSample = 2;
+    if (GetImplData(device)->pixelDepth == PixelDepth_8Bit)
+        *bytesPerSample = 1;
+    else
+        *bytesPerSample = 2;
     return OScDev_OK;
 }
 
@@ -194,18 +220,8 @@ static OScDev_Error NIDAQArm(OScDev_Device *device, OScDev_Acquisition *acq) {
         return OScDev_Error_ReturnAsCode(OScDev_Error_Create(
             "Unsupported operation (cannot disable clock or scanner)"));
 
-    OScDev_TriggerSource clockStartTriggerSource;
-    OScDev_Acquisition_GetClockStartTriggerSource(acq,
-                                                  &clockStartTriggerSource);
-    if (clockStartTriggerSource != OScDev_TriggerSource_Software)
-        return OScDev_Error_ReturnAsCode(OScDev_Error_Create(
-            "Unsupported operation (trigger source must be software)"));
-
-    OScDev_ClockSource clockSource;
-    OScDev_Acquisition_GetClockSource(acq, &clockSource);
-    if (clockSource != OScDev_ClockSource_Internal)
-        return OScDev_Error_ReturnAsCode(OScDev_Error_Create(
-            "Unsupported operation (clock source must be internal)"));
+    // External start trigger and clock source are taken from acq when the
+    // tasks are set up
 
     return OScDev_Error_ReturnAsCode(
         ArmAcquisition(device, acq, !useDetector));
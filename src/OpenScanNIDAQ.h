@@ -0,0 +1,149 @@
+#pragma once
+
+// Extension API of the OpenScanNIDAQ device module
+//
+// These functions are exported from OpenScanNIDAQ.osdev and provide access to
+// features that do not fit the OpenScan device interface. An application can
+// obtain them with GetProcAddress() on the module. Devices are identified by
+// their OpenScan device name (the DAQmx device name, such as "Dev1").
+//
+// All functions return 0 on success and nonzero if the device is not found.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef OSCNIDAQ_BUILDING_MODULE
+#define OSCNIDAQ_API __declspec(dllexport)
+#else
+#define OSCNIDAQ_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called on the acquisition thread when lines [firstLine, firstLine +
+// numLines) of the given channel (index among enabled channels) have been
+// filled. 'pixels' points to the first pixel of firstLine in the frame buffer
+// and is valid only for the duration of the call.
+typedef void (*OScNIDAQ_LinesCallback)(uint32_t channel, uint32_t firstLine,
+                                       uint32_t numLines,
+                                       const uint16_t *pixels,
+                                       void *userData);
+
+// Set or clear (callback = NULL) the callback for partial frame delivery,
+// which is used when the device setting "Stream Partial Frames" is enabled.
+// Takes effect at the start of the next frame.
+OSCNIDAQ_API int OScNIDAQ_SetLinesCallback(const char *deviceName,
+                                           OScNIDAQ_LinesCallback callback,
+                                           void *userData);
+
+// Called on the acquisition thread with the displacement (in pixels) of each
+// frame relative to the reference frame, when the device setting "Motion
+// Correction" is enabled. 'frame' is the index of the acquired frame (before
+// frame averaging). 'peak' is the normalized phase correlation peak (0-1), a
+// measure of confidence. The shift of a frame is reported before the frame is
+// delivered if "Motion Correction Apply Shift" is enabled, otherwise up to
+// one frame later.
+typedef void (*OScNIDAQ_MotionShiftCallback)(uint32_t frame, double dx,
+                                             double dy, double peak,
+                                             void *userData);
+
+// Set or clear (callback = NULL) the callback for motion shifts
+OSCNIDAQ_API int
+OScNIDAQ_SetMotionShiftCallback(const char *deviceName,
+                                OScNIDAQ_MotionShiftCallback callback,
+                                void *userData);
+
+// Called on the acquisition thread with each delivered channel frame,
+// losslessly compressed, when the device setting "Compression" is enabled.
+// The format is described in the module's FrameCompression.h; use
+// OScNIDAQ_DecompressFrame() to decode it. 'data' is valid only for the
+// duration of the call. 'ratio' is the uncompressed size divided by 'size',
+// and 'megabytesPerSecond' the rate at which the frame was compressed.
+typedef void (*OScNIDAQ_CompressedFrameCallback)(
+    uint32_t channel, uint32_t frame, const void *data, size_t size,
+    double ratio, double megabytesPerSecond, void *userData);
+
+// Set or clear (callback = NULL) the callback for compressed frames
+OSCNIDAQ_API int
+OScNIDAQ_SetCompressedFrameCallback(const char *deviceName,
+                                    OScNIDAQ_CompressedFrameCallback callback,
+                                    void *userData);
+
+// Flags in OScNIDAQ_FrameMetadata
+// Detector samples or acquisition events were lost, reading fell behind
+// (samples were still waiting after a read filled the whole read buffer), or
+// photon counts were not yet available for some scans (counted as zero)
+#define OSCNIDAQ_FRAME_OVERRUN 0x1
+// A detector callback found no samples to read
+#define OSCNIDAQ_FRAME_SHORT_READ 0x2
+
+// Timing and integrity of a delivered frame. Timestamps are in the
+// QueryPerformanceCounter() timebase. With frame averaging, the metadata is
+// that of the last frame averaged.
+struct OScNIDAQ_FrameMetadata {
+    uint32_t frame;    // Index of the acquired frame (before frame averaging)
+    uint32_t sequence; // Index among the frames the device delivered; gaps
+                       // seen by the application are dropped frames
+    // Time of the first detector sample of the frame, estimated on the host
+    // from the number of samples read at each detector callback (the
+    // earliest estimate, which has the least callback latency)
+    int64_t estimatedFrameStartTimestamp;
+    int64_t hostTimestamp; // When the last sample of the frame was read
+    int64_t timestampFrequency;
+    uint64_t samplesRead; // Per channel, from the detector
+    uint32_t detectorCallbacks;
+    uint32_t flags; // OSCNIDAQ_FRAME_*
+};
+
+// Called with the metadata of each delivered frame, on the thread that calls
+// the OpenScan frame callbacks, just before the frame callbacks of the
+// frame. 'metadata' is valid only for the duration of the call.
+typedef void (*OScNIDAQ_FrameMetadataCallback)(
+    const struct OScNIDAQ_FrameMetadata *metadata, void *userData);
+
+// Set or clear (callback = NULL) the callback for frame metadata
+OSCNIDAQ_API int
+OScNIDAQ_SetFrameMetadataCallback(const char *deviceName,
+                                  OScNIDAQ_FrameMetadataCallback callback,
+                                  void *userData);
+
+// Get the time taken by the last arm, and from the last start to the start
+// of the scan hardware, in seconds. With the device setting "Keep Scan Plan
+// Resident" enabled, arming again with an unchanged scan configuration does
+// not touch the scanner, so that only the hardware start remains.
+OSCNIDAQ_API int OScNIDAQ_GetAcquisitionLatencies(const char *deviceName,
+                                                  double *armSeconds,
+                                                  double *startSeconds);
+
+// Get the time taken by the last stop (StopAcquisitionAndWait(), which
+// interrupts the frame being scanned and parks the scanner), in seconds, and
+// the X and Y voltages from which the scanner was last parked.
+OSCNIDAQ_API int OScNIDAQ_GetStopReport(const char *deviceName,
+                                        double *stopSeconds,
+                                        double *parkStartXVolts,
+                                        double *parkStartYVolts);
+
+// Get the statistics of the intervals between frames in timelapse mode
+// (device setting "Frame Interval (ms)" nonzero), for the current or last
+// acquisition: the number of intervals, their mean, and the RMS and maximum
+// deviation of each interval from the nearest multiple of the nominal
+// interval, in seconds; and the trigger pulses that came while the scan was
+// not ready for them (each delays a frame by one interval). The intervals
+// are measured between the estimated times of the first sample of each
+// frame, so the jitter includes the error of that estimate.
+OSCNIDAQ_API int OScNIDAQ_GetFrameIntervalStatistics(
+    const char *deviceName, uint32_t *numIntervals, double *meanSeconds,
+    double *rmsJitterSeconds, double *maxJitterSeconds,
+    uint32_t *missedTriggers);
+
+// Decode a compressed frame into 'pixels', which must hold at least
+// numPixels pixels. Returns nonzero if the data is invalid or the frame is
+// larger than numPixels.
+OSCNIDAQ_API int OScNIDAQ_DecompressFrame(const void *data, size_t size,
+                                          uint16_t *pixels, size_t numPixels);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -1,9 +1,16 @@
 #include "OpenScanSettings.h"
 
 #include "DAQConfig.h"
+#include "Detector.h"
 #include "DeviceImplData.h"
+#include "FrameAveraging.h"
+#include "FrameCompression.h"
+#include "FrameCorrection.h"
+#include "FrameDelivery.h"
+#include "FrameProcessing.h"
 
 #include <OpenScanDeviceLib.h>
+#include <ss8str.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -172,17 +179,25 @@ static OScDev_SettingImpl SettingImpl_InputVoltageRange = {
     .GetFloat64DiscreteValues = GetInputVoltageRangeValues,
 };
 
-struct EnableChannelData {
+struct ChannelSettingData {
     OScDev_Device *device;
     int hwChannel;
+    int index; // Setting-specific
 };
 
-static void ReleaseEnableChannel(OScDev_Setting *setting) {
+static void ReleaseChannelSetting(OScDev_Setting *setting) {
     free(OScDev_Setting_GetImplData(setting));
 }
 
+static OScDev_Error IsWritableImpl_ReadOnly(OScDev_Setting *setting,
+                                            bool *writable) {
+    (void)setting; // Unused
+    *writable = false;
+    return OScDev_OK;
+}
+
 static OScDev_Error GetEnableChannel(OScDev_Setting *setting, bool *value) {
-    struct EnableChannelData *settingData =
+    struct ChannelSettingData *settingData =
         OScDev_Setting_GetImplData(setting);
     struct DeviceImplData *devData = GetImplData(settingData->device);
     *value = devData->channelEnabled[settingData->hwChannel];
@@ -190,7 +205,7 @@ static OScDev_Error GetEnableChannel(OScDev_Setting *setting, bool *value) {
 }
 
 static OScDev_Error SetEnableChannel(OScDev_Setting *setting, bool value) {
-    struct EnableChannelData *settingData =
+    struct ChannelSettingData *settingData =
         OScDev_Setting_GetImplData(setting);
     struct DeviceImplData *devData = GetImplData(settingData->device);
     devData->channelEnabled[settingData->hwChannel] = value;
@@ -201,157 +216,2536 @@ static OScDev_Error SetEnableChannel(OScDev_Setting *setting, bool value) {
 }
 
 static OScDev_SettingImpl SettingImpl_EnableChannel = {
-    .Release = ReleaseEnableChannel,
+    .Release = ReleaseChannelSetting,
     .GetBool = GetEnableChannel,
     .SetBool = SetEnableChannel,
 };
 
-struct TransformSettingData {
-    OScDev_Device *device;
-    int index; // 0-3 = matrix[0-3], 4 = offsetX, 5 = offsetY
+// For settings whose state is in use by the detector callback (or other
+// acquisition threads) while acquiring
+static OScDev_RichError *CheckNotAcquiring(struct DeviceImplData *devData) {
+    bool running;
+    EnterCriticalSection(&devData->acquisition.mutex);
+    running = devData->acquisition.running;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    if (running)
+        return OScDev_Error_Create(
+            "Cannot change this setting while acquisition is running");
+    return OScDev_RichError_OK;
+}
+
+static OScDev_Error GetPhotonCounter(OScDev_Setting *setting, char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    ss8_copy_to_cstr(&devData->channelCounter[settingData->hwChannel], value,
+                     OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetPhotonCounter(OScDev_Setting *setting,
+                                     const char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    ss8_copy_cstr(&devData->channelCounter[settingData->hwChannel], value);
+    ss8_strip_ch(&devData->channelCounter[settingData->hwChannel], ' ');
+
+    // Force recreation of detector tasks next time
+    err = ShutdownDetector(&devData->detectorConfig);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+// Counter input (e.g. "ctr1") whose source terminal receives the photon
+// pulses of this channel; empty to sample the channel's AI
+static OScDev_SettingImpl SettingImpl_PhotonCounter = {
+    .Release = ReleaseChannelSetting,
+    .GetString = GetPhotonCounter,
+    .SetString = SetPhotonCounter,
 };
 
-static double *GetTransformField(struct DeviceImplData *devData, int index) {
-    if (index < 4)
-        return &devData->xformMatrix[index];
-    if (index == 4)
-        return &devData->xformOffsetX;
-    return &devData->xformOffsetY;
+static OScDev_Error GetChannelOffset(OScDev_Setting *setting,
+                                     double *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    *value = devData->channelOffsetVolts[settingData->hwChannel];
+    return OScDev_OK;
 }
 
-static OScDev_Error GetTransform(OScDev_Setting *setting, double *value) {
-    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
-    *value = *GetTransformField(GetImplData(data->device), data->index);
+static OScDev_Error SetChannelOffset(OScDev_Setting *setting, double value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->channelOffsetVolts[settingData->hwChannel] = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetChannelOffsetRange(OScDev_Setting *setting,
+                                          double *min, double *max) {
+    (void)setting; // Unused
+    *min = -10.0;
+    *max = 10.0;
     return OScDev_OK;
 }
 
-static OScDev_Error SetTransform(OScDev_Setting *setting, double value) {
-    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
-    *GetTransformField(GetImplData(data->device), data->index) = value;
+static OScDev_SettingImpl SettingImpl_ChannelOffset = {
+    .Release = ReleaseChannelSetting,
+    .GetFloat64 = GetChannelOffset,
+    .SetFloat64 = SetChannelOffset,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetChannelOffsetRange,
+};
 
-    GetImplData(data->device)->scannerConfig.mustRewriteOutput = true;
+static OScDev_Error GetChannelGain(OScDev_Setting *setting, double *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    *value = devData->channelGain[settingData->hwChannel];
+    return OScDev_OK;
+}
+
+static OScDev_Error SetChannelGain(OScDev_Setting *setting, double value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->channelGain[settingData->hwChannel] = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
 
+static OScDev_Error GetChannelGainRange(OScDev_Setting *setting, double *min,
+                                        double *max) {
+    (void)setting; // Unused
+    *min = 0.1;
+    *max = 10.0;
     return OScDev_OK;
 }
 
-static OScDev_Error GetTransformRange(OScDev_Setting *setting, double *min,
-                                      double *max) {
-    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
-    if (data->index == 0 || data->index == 3) {
-        *min = 0.9;
-        *max = 1.1;
-    } else if (data->index < 4) {
-        *min = -0.1;
-        *max = 0.1;
-    } else {
-        *min = -5.0;
-        *max = 5.0;
+static OScDev_SettingImpl SettingImpl_ChannelGain = {
+    .Release = ReleaseChannelSetting,
+    .GetFloat64 = GetChannelGain,
+    .SetFloat64 = SetChannelGain,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetChannelGainRange,
+};
+
+static OScDev_Error GetChannelDarkLevel(OScDev_Setting *setting,
+                                        double *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    *value = devData->channelDarkLevelVolts[settingData->hwChannel];
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ChannelDarkLevel = {
+    .Release = ReleaseChannelSetting,
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetChannelDarkLevel,
+};
+
+static OScDev_Error GetSamplesPerPixel(OScDev_Setting *setting,
+                                       int32_t *value) {
+    *value = GetSettingDeviceData(setting)->samplesPerPixel;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetSamplesPerPixel(OScDev_Setting *setting,
+                                       int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    // Sets the AI rate, the binning and the buffer sizes
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err) {
+        devData->samplesPerPixel = value;
+        devData->detectorConfig.mustReconfigureTiming = true;
+        devData->detectorConfig.mustReconfigureCallback = true;
+    }
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetSamplesPerPixelValues(OScDev_Setting *setting,
+                                             OScDev_NumArray **values) {
+    (void)setting; // Unused
+    // Whether the resulting AI rate is achievable is checked when the
+    // detector is configured
+    static const uint32_t v[] = {
+        1, 2, 4, 8, 16,
+        UINT32_MAX // End mark
+    };
+    *values = OScDev_NumArray_Create();
+    for (size_t i = 0; v[i] != UINT32_MAX; ++i) {
+        OScDev_NumArray_Append(*values, v[i]);
     }
     return OScDev_OK;
 }
 
-static void ReleaseTransform(OScDev_Setting *setting) {
-    free(OScDev_Setting_GetImplData(setting));
+static OScDev_SettingImpl SettingImpl_SamplesPerPixel = {
+    .GetInt32 = GetSamplesPerPixel,
+    .SetInt32 = SetSamplesPerPixel,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_DiscreteValues,
+    .GetInt32DiscreteValues = GetSamplesPerPixelValues,
+};
+
+static OScDev_Error GetLineRepeats(OScDev_Setting *setting, int32_t *value) {
+    *value = GetSettingDeviceData(setting)->lineRepeats;
+    return OScDev_OK;
 }
 
-static OScDev_SettingImpl SettingImpl_Transform = {
-    .GetFloat64 = GetTransform,
-    .SetFloat64 = SetTransform,
+static OScDev_Error SetLineRepeats(OScDev_Setting *setting, int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    // The detector callback counts lines and averages by this number
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err) {
+        devData->lineRepeats = value;
+        devData->clockConfig.mustReconfigureTiming = true;
+        devData->scannerConfig.mustReconfigureTiming = true;
+        devData->clockConfig.mustRewriteOutput = true;
+        devData->scannerConfig.mustRewriteOutput = true;
+        devData->detectorConfig.mustReconfigureCallback = true;
+    }
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetLineRepeatsRange(OScDev_Setting *setting,
+                                        int32_t *min, int32_t *max) {
+    (void)setting; // Unused
+    *min = 1;
+    *max = 16;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_LineRepeats = {
+    .GetInt32 = GetLineRepeats,
+    .SetInt32 = SetLineRepeats,
     .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
-    .GetFloat64Range = GetTransformRange,
-    .Release = ReleaseTransform,
+    .GetInt32Range = GetLineRepeatsRange,
 };
 
-OScDev_Error NIDAQMakeSettings(OScDev_Device *device,
-                               OScDev_PtrArray **settings) {
-    OScDev_RichError *err;
+static OScDev_Error GetPixelDepth(OScDev_Setting *setting, uint32_t *value) {
+    *value = GetSettingDeviceData(setting)->pixelDepth;
+    return OScDev_OK;
+}
 
-    err = EnumerateAIPhysChans(device);
-    if (err)
-        OScDev_Error_ReturnAsCode(err);
+static OScDev_Error SetPixelDepth(OScDev_Setting *setting, uint32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err) {
+        devData->pixelDepth = (enum PixelDepth)value;
+        // Frame buffers are reallocated for the new element size
+        devData->detectorConfig.mustReconfigureCallback = true;
+    }
+    return OScDev_Error_ReturnAsCode(err);
+}
 
-    *settings = OScDev_PtrArray_Create();
+static OScDev_Error GetPixelDepthNumValues(OScDev_Setting *setting,
+                                           uint32_t *count) {
+    (void)setting; // Unused
+    *count = NumPixelDepths;
+    return OScDev_OK;
+}
 
-    OScDev_Setting *lineDelay;
-    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-        &lineDelay, "Line Delay (pixels)", OScDev_ValueType_Int32,
-        &SettingImpl_LineDelay, device));
-    if (err)
-        goto error;
-    OScDev_PtrArray_Append(*settings, lineDelay);
+static OScDev_Error GetPixelDepthNameForValue(OScDev_Setting *setting,
+                                              uint32_t value, char *name) {
+    (void)setting; // Unused
+    const char *depthName = GetPixelDepthName(value);
+    if (!depthName)
+        return OScDev_Error_ReturnAsCode(
+            OScDev_Error_Create("Invalid pixel depth"));
+    snprintf(name, OScDev_MAX_STR_SIZE, "%s", depthName);
+    return OScDev_OK;
+}
 
-    OScDev_Setting *parkingPositionX;
-    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-        &parkingPositionX, "Parking Position X (pixels)",
-        OScDev_ValueType_Int32, &SettingImpl_ParkingPositionX, device));
-    if (err)
-        goto error;
-    OScDev_PtrArray_Append(*settings, parkingPositionX);
+static OScDev_Error GetPixelDepthValueForName(OScDev_Setting *setting,
+                                              uint32_t *value,
+                                              const char *name) {
+    (void)setting; // Unused
+    for (uint32_t i = 0; i < NumPixelDepths; ++i) {
+        if (strcmp(name, GetPixelDepthName(i)) == 0) {
+            *value = i;
+            return OScDev_OK;
+        }
+    }
+    return OScDev_Error_ReturnAsCode(
+        OScDev_Error_Create("Invalid pixel depth"));
+}
 
-    OScDev_Setting *parkingPositionY;
-    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-        &parkingPositionY, "Parking Position Y (pixels)",
-        OScDev_ValueType_Int32, &SettingImpl_ParkingPositionY, device));
-    if (err)
-        goto error;
-    OScDev_PtrArray_Append(*settings, parkingPositionY);
+static OScDev_SettingImpl SettingImpl_PixelDepth = {
+    .GetEnum = GetPixelDepth,
+    .SetEnum = SetPixelDepth,
+    .GetEnumNumValues = GetPixelDepthNumValues,
+    .GetEnumNameForValue = GetPixelDepthNameForValue,
+    .GetEnumValueForName = GetPixelDepthValueForName,
+};
 
-    {
-        static const char *transformNames[] = {
-            "TransformA",
-            "TransformB",
-            "TransformC",
-            "TransformD",
-            "TransformOffsetXVolts",
-            "TransformOffsetYVolts",
-        };
-        for (int i = 0; i < 6; ++i) {
-            OScDev_Setting *xformSetting;
-            struct TransformSettingData *data =
-                malloc(sizeof(struct TransformSettingData));
-            data->device = device;
-            data->index = i;
-            err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-                &xformSetting, transformNames[i], OScDev_ValueType_Float64,
-                &SettingImpl_Transform, data));
-            if (err)
-                goto error;
-            OScDev_PtrArray_Append(*settings, xformSetting);
-        }
+static OScDev_Error GetDetectorOnScannerClock(OScDev_Setting *setting,
+                                              bool *value) {
+    *value = GetSettingDeviceData(setting)->detectorOnScannerClock;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetDetectorOnScannerClock(OScDev_Setting *setting,
+                                              bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    // Selects the line layout the detector callback works from
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err) {
+        devData->detectorOnScannerClock = value;
+        devData->detectorConfig.mustReconfigureTiming = true;
+        devData->detectorConfig.mustReconfigureTrigger = true;
+        devData->detectorConfig.mustReconfigureCallback = true;
     }
+    return OScDev_Error_ReturnAsCode(err);
+}
 
-    OScDev_Setting *numLinesToBuffer;
-    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-        &numLinesToBuffer, "Acq Buffer Size (lines)", OScDev_ValueType_Int32,
-        &SettingImpl_AcqBufferSize, device));
-    if (err)
-        goto error;
-    OScDev_PtrArray_Append(*settings, numLinesToBuffer);
+static OScDev_SettingImpl SettingImpl_DetectorOnScannerClock = {
+    .GetBool = GetDetectorOnScannerClock,
+    .SetBool = SetDetectorOnScannerClock,
+};
 
-    int nPhysChans = GetNumberOfAIPhysChans(device);
-    for (int i = 0; i < nPhysChans; ++i) {
-        struct EnableChannelData *data =
-            malloc(sizeof(struct EnableChannelData));
-        data->device = device;
-        data->hwChannel = i;
-        char name[64];
-        snprintf(name, sizeof(name), "EnableChannel%d", i);
-        OScDev_Setting *enableChannel;
-        err = OScDev_Error_AsRichError(
-            OScDev_Setting_Create(&enableChannel, name, OScDev_ValueType_Bool,
-                                  &SettingImpl_EnableChannel, data));
-        if (err)
-            goto error;
-        OScDev_PtrArray_Append(*settings, enableChannel);
+static OScDev_Error GetDarkSamplesPerLine(OScDev_Setting *setting,
+                                          int32_t *value) {
+    *value = GetSettingDeviceData(setting)->darkSamplesPerLine;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetDarkSamplesPerLine(OScDev_Setting *setting,
+                                          int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    // The detector callback splits each line by this count
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err) {
+        devData->darkSamplesPerLine = value;
+        devData->detectorConfig.mustReconfigureTiming = true;
+        devData->detectorConfig.mustReconfigureCallback = true;
     }
+    return OScDev_Error_ReturnAsCode(err);
+}
 
-    OScDev_Setting *inputVoltageRange;
-    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
-        &inputVoltageRange, "Input Voltage Range", OScDev_ValueType_Float64,
-        &SettingImpl_InputVoltageRange, device));
-    if (err)
-        goto error;
-    OScDev_PtrArray_Append(*settings, inputVoltageRange);
+static OScDev_Error GetDarkSamplesPerLineValues(OScDev_Setting *setting,
+                                                OScDev_NumArray **values) {
+    (void)setting; // Unused
+    // Dark samples are taken during the X retrace, which must also leave
+    // time for the detector task to rearm before the next line
+    static const uint32_t v[] = {
+        0, 8, 16, 32, 64,
+        UINT32_MAX // End mark
+    };
+    *values = OScDev_NumArray_Create();
+    for (size_t i = 0; v[i] != UINT32_MAX; ++i) {
+        OScDev_NumArray_Append(*values, v[i]);
+    }
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_DarkSamplesPerLine = {
+    .GetInt32 = GetDarkSamplesPerLine,
+    .SetInt32 = SetDarkSamplesPerLine,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_DiscreteValues,
+    .GetInt32DiscreteValues = GetDarkSamplesPerLineValues,
+};
+
+static OScDev_Error GetMeasureDarkOffset(OScDev_Setting *setting,
+                                         bool *value) {
+    *value = GetSettingDeviceData(setting)->measureDarkOffset;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMeasureDarkOffset(OScDev_Setting *setting,
+                                         bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->measureDarkOffset = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_MeasureDarkOffset = {
+    .GetBool = GetMeasureDarkOffset,
+    .SetBool = SetMeasureDarkOffset,
+};
+
+static OScDev_Error GetDarkFrameFile(OScDev_Setting *setting, char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    struct FrameCorrection *corr =
+        &devData->frameCorrection[settingData->hwChannel];
+    ss8_copy_to_cstr(&corr->darkFile, value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetDarkFrameFile(OScDev_Setting *setting,
+                                     const char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        err = LoadDarkFrame(&devData->frameCorrection[settingData->hwChannel],
+                            value);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_DarkFrameFile = {
+    .Release = ReleaseChannelSetting,
+    .GetString = GetDarkFrameFile,
+    .SetString = SetDarkFrameFile,
+};
+
+static OScDev_Error GetFlatFieldFile(OScDev_Setting *setting, char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    struct FrameCorrection *corr =
+        &devData->frameCorrection[settingData->hwChannel];
+    ss8_copy_to_cstr(&corr->flatFile, value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFlatFieldFile(OScDev_Setting *setting,
+                                     const char *value) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        err = LoadFlatField(&devData->frameCorrection[settingData->hwChannel],
+                            value);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_FlatFieldFile = {
+    .Release = ReleaseChannelSetting,
+    .GetString = GetFlatFieldFile,
+    .SetString = SetFlatFieldFile,
+};
+
+static OScDev_Error GetApplyFrameCorrection(OScDev_Setting *setting,
+                                            bool *value) {
+    *value = GetSettingDeviceData(setting)->applyFrameCorrection;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetApplyFrameCorrection(OScDev_Setting *setting,
+                                            bool value) {
+    GetSettingDeviceData(setting)->applyFrameCorrection = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ApplyFrameCorrection = {
+    .GetBool = GetApplyFrameCorrection,
+    .SetBool = SetApplyFrameCorrection,
+};
+
+// One-shot: set to true to store the next acquired frame (uncorrected) as
+// the dark frame; reads true until the dark frame has been stored
+static OScDev_Error GetAcquireDarkReference(OScDev_Setting *setting,
+                                            bool *value) {
+    *value = InterlockedCompareExchange(
+                 &GetSettingDeviceData(setting)->acquireDarkReference, 0,
+                 0) != 0;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetAcquireDarkReference(OScDev_Setting *setting,
+                                            bool value) {
+    InterlockedExchange(&GetSettingDeviceData(setting)->acquireDarkReference,
+                        value ? 1 : 0);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_AcquireDarkReference = {
+    .GetBool = GetAcquireDarkReference,
+    .SetBool = SetAcquireDarkReference,
+};
+
+static OScDev_Error GetComputeFrameStatistics(OScDev_Setting *setting,
+                                              bool *value) {
+    *value = GetSettingDeviceData(setting)->computeFrameStatistics;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetComputeFrameStatistics(OScDev_Setting *setting,
+                                              bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    // Statistics are accumulated as each frame is converted
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->computeFrameStatistics = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_ComputeFrameStatistics = {
+    .GetBool = GetComputeFrameStatistics,
+    .SetBool = SetComputeFrameStatistics,
+};
+
+static OScDev_Error GetAutoContrastSaturation(OScDev_Setting *setting,
+                                              double *value) {
+    *value = GetSettingDeviceData(setting)->autoContrastSaturatedPercent;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetAutoContrastSaturation(OScDev_Setting *setting,
+                                              double value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    devData->autoContrastSaturatedPercent = value;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_Error GetAutoContrastSaturationRange(OScDev_Setting *setting,
+                                                   double *min, double *max) {
+    (void)setting; // Unused
+    *min = 0.0;
+    *max = 10.0;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_AutoContrastSaturation = {
+    .GetFloat64 = GetAutoContrastSaturation,
+    .SetFloat64 = SetAutoContrastSaturation,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetAutoContrastSaturationRange,
+};
+
+static OScDev_Error GetFrameAveraging(OScDev_Setting *setting,
+                                      uint32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameAverager.mode;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameAveraging(OScDev_Setting *setting,
+                                      uint32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.mode = (enum FrameAveragingMode)value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetFrameAveragingNumValues(OScDev_Setting *setting,
+                                               uint32_t *count) {
+    (void)setting; // Unused
+    *count = NumFrameAveragingModes;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFrameAveragingNameForValue(OScDev_Setting *setting,
+                                                  uint32_t value,
+                                                  char *name) {
+    (void)setting; // Unused
+    const char *modeName = GetFrameAveragingModeName(value);
+    if (!modeName)
+        return OScDev_Error_ReturnAsCode(
+            OScDev_Error_Create("Invalid frame averaging mode"));
+    snprintf(name, OScDev_MAX_STR_SIZE, "%s", modeName);
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFrameAveragingValueForName(OScDev_Setting *setting,
+                                                  uint32_t *value,
+                                                  const char *name) {
+    (void)setting; // Unused
+    for (uint32_t i = 0; i < NumFrameAveragingModes; ++i) {
+        if (strcmp(name, GetFrameAveragingModeName(i)) == 0) {
+            *value = i;
+            return OScDev_OK;
+        }
+    }
+    return OScDev_Error_ReturnAsCode(
+        OScDev_Error_Create("Invalid frame averaging mode"));
+}
+
+static OScDev_SettingImpl SettingImpl_FrameAveraging = {
+    .GetEnum = GetFrameAveraging,
+    .SetEnum = SetFrameAveraging,
+    .GetEnumNumValues = GetFrameAveragingNumValues,
+    .GetEnumNameForValue = GetFrameAveragingNameForValue,
+    .GetEnumValueForName = GetFrameAveragingValueForName,
+};
+
+static OScDev_Error GetFramesToAverage(OScDev_Setting *setting,
+                                       int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameAverager.framesToAverage;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFramesToAverage(OScDev_Setting *setting,
+                                       int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.framesToAverage = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetFramesToAverageRange(OScDev_Setting *setting,
+                                            int32_t *min, int32_t *max) {
+    (void)setting; // Unused
+    *min = 1;
+    *max = 1024;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FramesToAverage = {
+    .GetInt32 = GetFramesToAverage,
+    .SetInt32 = SetFramesToAverage,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetFramesToAverageRange,
+};
+
+static OScDev_Error GetAveragingOutputInterval(OScDev_Setting *setting,
+                                               int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameAverager.outputInterval;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetAveragingOutputInterval(OScDev_Setting *setting,
+                                               int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.outputInterval = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetAveragingOutputIntervalRange(OScDev_Setting *setting,
+                                                    int32_t *min,
+                                                    int32_t *max) {
+    (void)setting; // Unused
+    *min = 1;
+    *max = 1024;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_AveragingOutputInterval = {
+    .GetInt32 = GetAveragingOutputInterval,
+    .SetInt32 = SetAveragingOutputInterval,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetAveragingOutputIntervalRange,
+};
+
+static OScDev_Error GetKalmanGain(OScDev_Setting *setting, double *value) {
+    *value = GetSettingDeviceData(setting)->frameAverager.kalmanGain;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetKalmanGain(OScDev_Setting *setting, double value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.kalmanGain = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetKalmanGainRange(OScDev_Setting *setting, double *min,
+                                       double *max) {
+    (void)setting; // Unused
+    *min = 0.0;
+    *max = 1.0;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_KalmanGain = {
+    .GetFloat64 = GetKalmanGain,
+    .SetFloat64 = SetKalmanGain,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetKalmanGainRange,
+};
+
+static OScDev_Error GetKalmanNoiseVariance(OScDev_Setting *setting,
+                                           double *value) {
+    *value = GetSettingDeviceData(setting)->frameAverager.kalmanNoiseVariance;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetKalmanNoiseVariance(OScDev_Setting *setting,
+                                           double value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.kalmanNoiseVariance = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetKalmanNoiseVarianceRange(OScDev_Setting *setting,
+                                                double *min, double *max) {
+    (void)setting; // Unused
+    *min = 0.001;
+    *max = 1.0;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_KalmanNoiseVariance = {
+    .GetFloat64 = GetKalmanNoiseVariance,
+    .SetFloat64 = SetKalmanNoiseVariance,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetKalmanNoiseVarianceRange,
+};
+
+static OScDev_Error GetKalmanProcessVariance(OScDev_Setting *setting,
+                                             double *value) {
+    *value =
+        GetSettingDeviceData(setting)->frameAverager.kalmanProcessVariance;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetKalmanProcessVariance(OScDev_Setting *setting,
+                                             double value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameAverager.kalmanProcessVariance = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetKalmanProcessVarianceRange(OScDev_Setting *setting,
+                                                  double *min, double *max) {
+    (void)setting; // Unused
+    *min = 0.001;
+    *max = 1.0;
+    return OScDev_OK;
+}
+
+// Relative to the noise variance, sets how quickly the estimate follows
+// changes in the scene
+static OScDev_SettingImpl SettingImpl_KalmanProcessVariance = {
+    .GetFloat64 = GetKalmanProcessVariance,
+    .SetFloat64 = SetKalmanProcessVariance,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetKalmanProcessVarianceRange,
+};
+
+static OScDev_Error GetMotionCorrection(OScDev_Setting *setting,
+                                       bool *value) {
+    *value = GetSettingDeviceData(setting)->motionCorrection.enabled;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMotionCorrection(OScDev_Setting *setting, bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->motionCorrection.enabled = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_MotionCorrection = {
+    .GetBool = GetMotionCorrection,
+    .SetBool = SetMotionCorrection,
+};
+
+static OScDev_Error GetMotionCorrectionApplyShift(OScDev_Setting *setting,
+                                                  bool *value) {
+    *value = GetSettingDeviceData(setting)->motionCorrection.applyShift;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMotionCorrectionApplyShift(OScDev_Setting *setting,
+                                                  bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->motionCorrection.applyShift = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_MotionCorrectionApplyShift = {
+    .GetBool = GetMotionCorrectionApplyShift,
+    .SetBool = SetMotionCorrectionApplyShift,
+};
+
+static OScDev_Error GetMotionCorrectionChannel(OScDev_Setting *setting,
+                                               int32_t *value) {
+    *value = GetSettingDeviceData(setting)->motionCorrection.channel;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMotionCorrectionChannel(OScDev_Setting *setting,
+                                               int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->motionCorrection.channel = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetMotionCorrectionChannelRange(OScDev_Setting *setting,
+                                                    int32_t *min,
+                                                    int32_t *max) {
+    (void)setting; // Unused
+    // Index among enabled channels
+    *min = 0;
+    *max = MAX_PHYSICAL_CHANS - 1;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MotionCorrectionChannel = {
+    .GetInt32 = GetMotionCorrectionChannel,
+    .SetInt32 = SetMotionCorrectionChannel,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetMotionCorrectionChannelRange,
+};
+
+static OScDev_Error GetMotionCorrectionDownsampling(OScDev_Setting *setting,
+                                                    int32_t *value) {
+    *value = GetSettingDeviceData(setting)->motionCorrection.downsample;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMotionCorrectionDownsampling(OScDev_Setting *setting,
+                                                    int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->motionCorrection.downsample = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error
+GetMotionCorrectionDownsamplingValues(OScDev_Setting *setting,
+                                      OScDev_NumArray **values) {
+    (void)setting; // Unused
+    // Frames are downsampled further if the result would exceed the largest
+    // FFT size
+    static const uint32_t v[] = {
+        1, 2, 4, 8,
+        UINT32_MAX // End mark
+    };
+    *values = OScDev_NumArray_Create();
+    for (size_t i = 0; v[i] != UINT32_MAX; ++i) {
+        OScDev_NumArray_Append(*values, v[i]);
+    }
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MotionCorrectionDownsampling = {
+    .GetInt32 = GetMotionCorrectionDownsampling,
+    .SetInt32 = SetMotionCorrectionDownsampling,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_DiscreteValues,
+    .GetInt32DiscreteValues = GetMotionCorrectionDownsamplingValues,
+};
+
+static OScDev_Error GetMotionShiftX(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->lastMotionShift.dx;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MotionShiftX = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetMotionShiftX,
+};
+
+static OScDev_Error GetMotionShiftY(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->lastMotionShift.dy;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MotionShiftY = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetMotionShiftY,
+};
+
+static OScDev_Error GetCompression(OScDev_Setting *setting, bool *value) {
+    *value = GetSettingDeviceData(setting)->frameCompressor.enabled;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetCompression(OScDev_Setting *setting, bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameCompressor.enabled = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_Compression = {
+    .GetBool = GetCompression,
+    .SetBool = SetCompression,
+};
+
+static OScDev_Error GetCompressionDeliverRaw(OScDev_Setting *setting,
+                                             bool *value) {
+    *value = GetSettingDeviceData(setting)->frameCompressor.deliverRawFrames;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetCompressionDeliverRaw(OScDev_Setting *setting,
+                                             bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameCompressor.deliverRawFrames = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_CompressionDeliverRaw = {
+    .GetBool = GetCompressionDeliverRaw,
+    .SetBool = SetCompressionDeliverRaw,
+};
+
+static OScDev_Error GetCompressionThreads(OScDev_Setting *setting,
+                                          int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameCompressor.numThreads;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetCompressionThreads(OScDev_Setting *setting,
+                                          int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameCompressor.numThreads = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetCompressionThreadsRange(OScDev_Setting *setting,
+                                               int32_t *min, int32_t *max) {
+    (void)setting; // Unused
+    *min = 1;
+    *max = COMPRESSION_MAX_THREADS;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_CompressionThreads = {
+    .GetInt32 = GetCompressionThreads,
+    .SetInt32 = SetCompressionThreads,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetCompressionThreadsRange,
+};
+
+static OScDev_Error GetCompressionFile(OScDev_Setting *setting, char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->frameCompressor.filePath,
+                     value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetCompressionFile(OScDev_Setting *setting,
+                                       const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        ss8_copy_cstr(&devData->frameCompressor.filePath, value);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_CompressionFile = {
+    .GetString = GetCompressionFile,
+    .SetString = SetCompressionFile,
+};
+
+static OScDev_Error GetCompressionRatio(OScDev_Setting *setting,
+                                        double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->lastCompressionRatio;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_CompressionRatio = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetCompressionRatio,
+};
+
+static OScDev_Error GetCompressionThroughput(OScDev_Setting *setting,
+                                             double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->lastCompressionMBPerSecond;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_CompressionThroughput = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetCompressionThroughput,
+};
+
+static OScDev_Error GetStreamPartialFrames(OScDev_Setting *setting,
+                                           bool *value) {
+    *value = GetSettingDeviceData(setting)->streamPartialFrames;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetStreamPartialFrames(OScDev_Setting *setting,
+                                           bool value) {
+    GetSettingDeviceData(setting)->streamPartialFrames = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_StreamPartialFrames = {
+    .GetBool = GetStreamPartialFrames,
+    .SetBool = SetStreamPartialFrames,
+};
+
+static OScDev_Error GetLineStreamingInterval(OScDev_Setting *setting,
+                                             double *value) {
+    *value = GetSettingDeviceData(setting)->lineStreamingIntervalMs;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetLineStreamingInterval(OScDev_Setting *setting,
+                                             double value) {
+    GetSettingDeviceData(setting)->lineStreamingIntervalMs = value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetLineStreamingIntervalRange(OScDev_Setting *setting,
+                                                  double *min, double *max) {
+    (void)setting; // Unused
+    *min = 0.0;
+    *max = 1000.0;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_LineStreamingInterval = {
+    .GetFloat64 = GetLineStreamingInterval,
+    .SetFloat64 = SetLineStreamingInterval,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetLineStreamingIntervalRange,
+};
+
+static OScDev_Error GetRecordRawSamples(OScDev_Setting *setting, bool *value) {
+    *value = GetSettingDeviceData(setting)->rawRecording.enabled;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetRecordRawSamples(OScDev_Setting *setting, bool value) {
+    GetSettingDeviceData(setting)->rawRecording.enabled = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_RecordRawSamples = {
+    .GetBool = GetRecordRawSamples,
+    .SetBool = SetRecordRawSamples,
+};
+
+static OScDev_Error GetRawRecordingPrefix(OScDev_Setting *setting,
+                                          char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->rawRecording.filePrefix,
+                     value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetRawRecordingPrefix(OScDev_Setting *setting,
+                                          const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        ss8_copy_cstr(&devData->rawRecording.filePrefix, value);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_RawRecordingPrefix = {
+    .GetString = GetRawRecordingPrefix,
+    .SetString = SetRawRecordingPrefix,
+};
+
+static OScDev_Error GetRawRecordingFileSize(OScDev_Setting *setting,
+                                            int32_t *value) {
+    *value = GetSettingDeviceData(setting)->rawRecording.fileSizeMB;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetRawRecordingFileSize(OScDev_Setting *setting,
+                                            int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->rawRecording.fileSizeMB = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetRawRecordingFileSizeValues(OScDev_Setting *setting,
+                                                  OScDev_NumArray **values) {
+    (void)setting; // Unused
+    static const uint32_t v[] = {
+        64, 256, 1024, 4096,
+        UINT32_MAX // End mark
+    };
+    *values = OScDev_NumArray_Create();
+    for (size_t i = 0; v[i] != UINT32_MAX; ++i) {
+        OScDev_NumArray_Append(*values, v[i]);
+    }
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_RawRecordingFileSize = {
+    .GetInt32 = GetRawRecordingFileSize,
+    .SetInt32 = SetRawRecordingFileSize,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_DiscreteValues,
+    .GetInt32DiscreteValues = GetRawRecordingFileSizeValues,
+};
+
+static OScDev_Error GetSharedMemoryRing(OScDev_Setting *setting,
+                                       bool *value) {
+    *value = GetSettingDeviceData(setting)->frameRing.enabled;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetSharedMemoryRing(OScDev_Setting *setting, bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameRing.enabled = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_SharedMemoryRing = {
+    .GetBool = GetSharedMemoryRing,
+    .SetBool = SetSharedMemoryRing,
+};
+
+static OScDev_Error GetSharedMemoryRingName(OScDev_Setting *setting,
+                                            char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->frameRing.name, value,
+                     OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetSharedMemoryRingName(OScDev_Setting *setting,
+                                            const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        ss8_copy_cstr(&devData->frameRing.name, value);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_SharedMemoryRingName = {
+    .GetString = GetSharedMemoryRingName,
+    .SetString = SetSharedMemoryRingName,
+};
+
+static OScDev_Error GetSharedMemoryRingSize(OScDev_Setting *setting,
+                                            int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameRing.sizeMB;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetSharedMemoryRingSize(OScDev_Setting *setting,
+                                            int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameRing.sizeMB = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_SharedMemoryRingSize = {
+    .GetInt32 = GetSharedMemoryRingSize,
+    .SetInt32 = SetSharedMemoryRingSize,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_DiscreteValues,
+    .GetInt32DiscreteValues = GetRawRecordingFileSizeValues,
+};
+
+static OScDev_Error GetFrameDeliveryPolicy(OScDev_Setting *setting,
+                                           uint32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameDelivery.policy;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameDeliveryPolicy(OScDev_Setting *setting,
+                                           uint32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameDelivery.policy = (enum FrameDeliveryPolicy)value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetFrameDeliveryPolicyNumValues(OScDev_Setting *setting,
+                                                    uint32_t *count) {
+    (void)setting; // Unused
+    *count = NumFrameDeliveryPolicies;
+    return OScDev_OK;
+}
+
+static OScDev_Error
+GetFrameDeliveryPolicyNameForValue(OScDev_Setting *setting, uint32_t value,
+                                   char *name) {
+    (void)setting; // Unused
+    const char *policyName = GetFrameDeliveryPolicyName(value);
+    if (!policyName)
+        return OScDev_Error_ReturnAsCode(
+            OScDev_Error_Create("Invalid frame delivery policy"));
+    snprintf(name, OScDev_MAX_STR_SIZE, "%s", policyName);
+    return OScDev_OK;
+}
+
+static OScDev_Error
+GetFrameDeliveryPolicyValueForName(OScDev_Setting *setting, uint32_t *value,
+                                   const char *name) {
+    (void)setting; // Unused
+    for (uint32_t i = 0; i < NumFrameDeliveryPolicies; ++i) {
+        if (strcmp(name, GetFrameDeliveryPolicyName(i)) == 0) {
+            *value = i;
+            return OScDev_OK;
+        }
+    }
+    return OScDev_Error_ReturnAsCode(
+        OScDev_Error_Create("Invalid frame delivery policy"));
+}
+
+static OScDev_SettingImpl SettingImpl_FrameDeliveryPolicy = {
+    .GetEnum = GetFrameDeliveryPolicy,
+    .SetEnum = SetFrameDeliveryPolicy,
+    .GetEnumNumValues = GetFrameDeliveryPolicyNumValues,
+    .GetEnumNameForValue = GetFrameDeliveryPolicyNameForValue,
+    .GetEnumValueForName = GetFrameDeliveryPolicyValueForName,
+};
+
+static OScDev_Error GetFrameDeliveryQueueLength(OScDev_Setting *setting,
+                                                int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameDelivery.capacity;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameDeliveryQueueLength(OScDev_Setting *setting,
+                                                int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameDelivery.capacity = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetFrameDeliveryQueueLengthRange(OScDev_Setting *setting,
+                                                     int32_t *min,
+                                                     int32_t *max) {
+    (void)setting; // Unused
+    *min = 1;
+    *max = 64;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameDeliveryQueueLength = {
+    .GetInt32 = GetFrameDeliveryQueueLength,
+    .SetInt32 = SetFrameDeliveryQueueLength,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetFrameDeliveryQueueLengthRange,
+};
+
+static OScDev_Error GetFrameDeliveryDecimation(OScDev_Setting *setting,
+                                               int32_t *value) {
+    *value = GetSettingDeviceData(setting)->frameDelivery.decimation;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameDeliveryDecimation(OScDev_Setting *setting,
+                                               int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameDelivery.decimation = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error GetFrameDeliveryDecimationRange(OScDev_Setting *setting,
+                                                    int32_t *min,
+                                                    int32_t *max) {
+    (void)setting; // Unused
+    *min = 2;
+    *max = 16;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameDeliveryDecimation = {
+    .GetInt32 = GetFrameDeliveryDecimation,
+    .SetInt32 = SetFrameDeliveryDecimation,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetFrameDeliveryDecimationRange,
+};
+
+static OScDev_Error GetFramesDelivered(OScDev_Setting *setting,
+                                       int32_t *value) {
+    uint32_t delivered, dropped;
+    GetFrameDeliveryCounts(&GetSettingDeviceData(setting)->frameDelivery,
+                           &delivered, &dropped);
+    *value = (int32_t)delivered;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FramesDelivered = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetFramesDelivered,
+};
+
+static OScDev_Error GetFramesDropped(OScDev_Setting *setting,
+                                     int32_t *value) {
+    uint32_t delivered, dropped;
+    GetFrameDeliveryCounts(&GetSettingDeviceData(setting)->frameDelivery,
+                           &delivered, &dropped);
+    *value = (int32_t)dropped;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FramesDropped = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetFramesDropped,
+};
+
+static OScDev_Error GetFrameProcessingThread(OScDev_Setting *setting,
+                                             bool *value) {
+    *value = GetSettingDeviceData(setting)->frameProcessor.enabled;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameProcessingThread(OScDev_Setting *setting,
+                                             bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameProcessor.enabled = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_FrameProcessingThread = {
+    .GetBool = GetFrameProcessingThread,
+    .SetBool = SetFrameProcessingThread,
+};
+
+static OScDev_Error GetAcquisitionBusyTime(OScDev_Setting *setting,
+                                           double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = (double)devData->controlBusyCounts / freq.QuadPart;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_AcquisitionBusyTime = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetAcquisitionBusyTime,
+};
+
+static OScDev_Error GetProcessingBusyTime(OScDev_Setting *setting,
+                                          double *value) {
+    *value = GetFrameProcessorBusySeconds(
+        &GetSettingDeviceData(setting)->frameProcessor);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ProcessingBusyTime = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetProcessingBusyTime,
+};
+
+static OScDev_Error GetDeliveryBusyTime(OScDev_Setting *setting,
+                                        double *value) {
+    *value = GetFrameDeliveryBusySeconds(
+        &GetSettingDeviceData(setting)->frameDelivery);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_DeliveryBusyTime = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetDeliveryBusyTime,
+};
+
+static OScDev_Error GetKeepScanPlanResident(OScDev_Setting *setting,
+                                            bool *value) {
+    *value = GetSettingDeviceData(setting)->keepScanPlanResident;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetKeepScanPlanResident(OScDev_Setting *setting,
+                                            bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->keepScanPlanResident = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_KeepScanPlanResident = {
+    .GetBool = GetKeepScanPlanResident,
+    .SetBool = SetKeepScanPlanResident,
+};
+
+static OScDev_Error GetArmLatency(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = 1e3 * devData->armLatencySec;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ArmLatency = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetArmLatency,
+};
+
+static OScDev_Error GetStartLatency(OScDev_Setting *setting,
+                                    double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = 1e3 * devData->startLatencySec;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_StartLatency = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetStartLatency,
+};
+
+static OScDev_Error GetStopLatency(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = 1e3 * devData->stopLatencySec;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_StopLatency = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetStopLatency,
+};
+
+static OScDev_Error GetParkStartX(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->parkStartXVolts;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ParkStartX = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetParkStartX,
+};
+
+static OScDev_Error GetParkStartY(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = devData->parkStartYVolts;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ParkStartY = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetParkStartY,
+};
+
+static OScDev_Error GetFrameInterval(OScDev_Setting *setting,
+                                     double *value) {
+    *value = 1e3 * GetSettingDeviceData(setting)->frameTrigger.intervalSec;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameInterval(OScDev_Setting *setting, double value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    // The scanner starts on the trigger only when the interval is set
+    if ((value > 0.0) != (devData->frameTrigger.intervalSec > 0.0))
+        devData->scannerConfig.mustReconfigureTrigger = true;
+    devData->frameTrigger.intervalSec = 1e-3 * value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFrameIntervalRange(OScDev_Setting *setting,
+                                          double *min, double *max) {
+    (void)setting; // Unused
+    *min = 0.0;
+    *max = 3600e3;
+    return OScDev_OK;
+}
+
+// 0 to scan the frames back to back
+static OScDev_SettingImpl SettingImpl_FrameInterval = {
+    .GetFloat64 = GetFrameInterval,
+    .SetFloat64 = SetFrameInterval,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetFrameIntervalRange,
+};
+
+static OScDev_Error GetFrameTriggerCounter(OScDev_Setting *setting,
+                                           char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->frameTrigger.counter,
+                     value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameTriggerCounter(OScDev_Setting *setting,
+                                           const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    ss8_copy_cstr(&devData->frameTrigger.counter, value);
+    ss8_strip_ch(&devData->frameTrigger.counter, ' ');
+
+    // Force recreation of the counter task, and retrigger the scanner from
+    // the new counter
+    devData->scannerConfig.mustReconfigureTrigger = true;
+    err = ShutdownFrameTrigger(&devData->frameTrigger);
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+// Counter output (e.g. "ctr3") that generates the frame trigger; it must not
+// be used for photon counting
+static OScDev_SettingImpl SettingImpl_FrameTriggerCounter = {
+    .GetString = GetFrameTriggerCounter,
+    .SetString = SetFrameTriggerCounter,
+};
+
+static OScDev_Error GetParkBetweenFrames(OScDev_Setting *setting,
+                                         bool *value) {
+    *value = GetSettingDeviceData(setting)->frameTrigger.parkBetweenFrames;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetParkBetweenFrames(OScDev_Setting *setting,
+                                         bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->frameTrigger.parkBetweenFrames = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_SettingImpl SettingImpl_ParkBetweenFrames = {
+    .GetBool = GetParkBetweenFrames,
+    .SetBool = SetParkBetweenFrames,
+};
+
+static OScDev_Error GetFrameIntervalMean(OScDev_Setting *setting,
+                                         double *value) {
+    uint32_t numIntervals, missed;
+    double meanSec, rmsSec, maxSec;
+    GetFrameIntervalStatistics(&GetSettingDeviceData(setting)->frameTrigger,
+                               &numIntervals, &meanSec, &rmsSec, &maxSec,
+                               &missed);
+    *value = 1e3 * meanSec;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameIntervalMean = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetFrameIntervalMean,
+};
+
+static OScDev_Error GetFrameIntervalJitterRMS(OScDev_Setting *setting,
+                                              double *value) {
+    uint32_t numIntervals, missed;
+    double meanSec, rmsSec, maxSec;
+    GetFrameIntervalStatistics(&GetSettingDeviceData(setting)->frameTrigger,
+                               &numIntervals, &meanSec, &rmsSec, &maxSec,
+                               &missed);
+    *value = 1e3 * rmsSec;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameIntervalJitterRMS = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetFrameIntervalJitterRMS,
+};
+
+static OScDev_Error GetFrameIntervalJitterMax(OScDev_Setting *setting,
+                                              double *value) {
+    uint32_t numIntervals, missed;
+    double meanSec, rmsSec, maxSec;
+    GetFrameIntervalStatistics(&GetSettingDeviceData(setting)->frameTrigger,
+                               &numIntervals, &meanSec, &rmsSec, &maxSec,
+                               &missed);
+    *value = 1e3 * maxSec;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameIntervalJitterMax = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetFrameIntervalJitterMax,
+};
+
+static OScDev_Error GetMissedFrameTriggers(OScDev_Setting *setting,
+                                           int32_t *value) {
+    uint32_t numIntervals, missed;
+    double meanSec, rmsSec, maxSec;
+    GetFrameIntervalStatistics(&GetSettingDeviceData(setting)->frameTrigger,
+                               &numIntervals, &meanSec, &rmsSec, &maxSec,
+                               &missed);
+    *value = (int32_t)missed;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MissedFrameTriggers = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetMissedFrameTriggers,
+};
+
+static OScDev_Error GetExternalTriggerTerminal(OScDev_Setting *setting,
+                                               char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->externalTriggerTerminal,
+                     value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetExternalTriggerTerminal(OScDev_Setting *setting,
+                                               const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    ss8_copy_cstr(&devData->externalTriggerTerminal, value);
+    ss8_strip_ch(&devData->externalTriggerTerminal, ' ');
+    devData->scannerConfig.mustReconfigureTrigger = true;
+    return OScDev_OK;
+}
+
+// Terminal (e.g. "PFI0") on which the start trigger arrives when the
+// acquisition uses an external trigger source
+static OScDev_SettingImpl SettingImpl_ExternalTriggerTerminal = {
+    .GetString = GetExternalTriggerTerminal,
+    .SetString = SetExternalTriggerTerminal,
+};
+
+static OScDev_Error GetExternalTriggerFallingEdge(OScDev_Setting *setting,
+                                                  bool *value) {
+    *value = GetSettingDeviceData(setting)->externalTriggerFallingEdge;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetExternalTriggerFallingEdge(OScDev_Setting *setting,
+                                                  bool value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    devData->externalTriggerFallingEdge = value;
+    devData->scannerConfig.mustReconfigureTrigger = true;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ExternalTriggerFallingEdge = {
+    .GetBool = GetExternalTriggerFallingEdge,
+    .SetBool = SetExternalTriggerFallingEdge,
+};
+
+static OScDev_Error GetExternalClockTerminal(OScDev_Setting *setting,
+                                             char *value) {
+    ss8_copy_to_cstr(&GetSettingDeviceData(setting)->externalClockTerminal,
+                     value, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetExternalClockTerminal(OScDev_Setting *setting,
+                                             const char *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (err)
+        return OScDev_Error_ReturnAsCode(err);
+    ss8_copy_cstr(&devData->externalClockTerminal, value);
+    ss8_strip_ch(&devData->externalClockTerminal, ' ');
+    devData->clockConfig.mustReconfigureTiming = true;
+    devData->scannerConfig.mustReconfigureTiming = true;
+    return OScDev_OK;
+}
+
+// Terminal (e.g. "PFI1") carrying the pixel clock when the acquisition uses
+// an external clock source; its rate must equal the pixel rate
+static OScDev_SettingImpl SettingImpl_ExternalClockTerminal = {
+    .GetString = GetExternalClockTerminal,
+    .SetString = SetExternalClockTerminal,
+};
+
+static OScDev_Error GetMaxConsecutiveFrameErrors(OScDev_Setting *setting,
+                                                 int32_t *value) {
+    *value = GetSettingDeviceData(setting)->maxConsecutiveFrameErrors;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMaxConsecutiveFrameErrors(OScDev_Setting *setting,
+                                                 int32_t value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    OScDev_RichError *err = CheckNotAcquiring(devData);
+    if (!err)
+        devData->maxConsecutiveFrameErrors = value;
+    return OScDev_Error_ReturnAsCode(err);
+}
+
+static OScDev_Error
+GetMaxConsecutiveFrameErrorsRange(OScDev_Setting *setting, int32_t *min,
+                                  int32_t *max) {
+    (void)setting; // Unused
+    *min = 0;
+    *max = 1000;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MaxConsecutiveFrameErrors = {
+    .GetInt32 = GetMaxConsecutiveFrameErrors,
+    .SetInt32 = SetMaxConsecutiveFrameErrors,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetMaxConsecutiveFrameErrorsRange,
+};
+
+static OScDev_Error GetDiscardedFrames(OScDev_Setting *setting,
+                                       int32_t *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = (int32_t)devData->discardedFrames;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_DiscardedFrames = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetDiscardedFrames,
+};
+
+static OScDev_Error GetOverrunFrames(OScDev_Setting *setting,
+                                     int32_t *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = (int32_t)devData->overrunFrames;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_OverrunFrames = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetOverrunFrames,
+};
+
+static OScDev_Error GetShortReadFrames(OScDev_Setting *setting,
+                                       int32_t *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = (int32_t)devData->shortReadFrames;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_ShortReadFrames = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetShortReadFrames,
+};
+
+static OScDev_Error GetSamplesLost(OScDev_Setting *setting, double *value) {
+    struct DeviceImplData *devData = GetSettingDeviceData(setting);
+    EnterCriticalSection(&devData->acquisition.mutex);
+    *value = (double)devData->samplesLost;
+    LeaveCriticalSection(&devData->acquisition.mutex);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_SamplesLost = {
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetSamplesLost,
+};
+
+enum FrameStatistic {
+    FrameStatistic_Min,
+    FrameStatistic_Max,
+    FrameStatistic_Mean,
+    FrameStatistic_ClippedLow,
+    FrameStatistic_ClippedHigh,
+    FrameStatistic_AutoContrastLow,
+    FrameStatistic_AutoContrastHigh,
+};
+
+// ChannelSettingData.index is the enum FrameStatistic
+static double GetFrameStatisticValue(OScDev_Setting *setting) {
+    struct ChannelSettingData *settingData =
+        OScDev_Setting_GetImplData(setting);
+    struct DeviceImplData *devData = GetImplData(settingData->device);
+
+    EnterCriticalSection(&devData->acquisition.mutex);
+    struct FrameStatisticsSummary summary =
+        devData->lastFrameStatistics[settingData->hwChannel];
+    LeaveCriticalSection(&devData->acquisition.mutex);
+
+    switch ((enum FrameStatistic)settingData->index) {
+    case FrameStatistic_Min:
+        return summary.min;
+    case FrameStatistic_Max:
+        return summary.max;
+    case FrameStatistic_Mean:
+        return summary.mean;
+    case FrameStatistic_ClippedLow:
+        return summary.numClippedLow;
+    case FrameStatistic_ClippedHigh:
+        return summary.numClippedHigh;
+    case FrameStatistic_AutoContrastLow:
+        return summary.autoContrastLow;
+    case FrameStatistic_AutoContrastHigh:
+        return summary.autoContrastHigh;
+    }
+    return 0.0;
+}
+
+static OScDev_Error GetFrameStatisticInt32(OScDev_Setting *setting,
+                                           int32_t *value) {
+    *value = (int32_t)GetFrameStatisticValue(setting);
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFrameStatisticFloat64(OScDev_Setting *setting,
+                                             double *value) {
+    *value = GetFrameStatisticValue(setting);
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameStatisticInt32 = {
+    .Release = ReleaseChannelSetting,
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetInt32 = GetFrameStatisticInt32,
+};
+
+static OScDev_SettingImpl SettingImpl_FrameStatisticFloat64 = {
+    .Release = ReleaseChannelSetting,
+    .IsWritable = IsWritableImpl_ReadOnly,
+    .GetFloat64 = GetFrameStatisticFloat64,
+};
+
+struct TransformSettingData {
+    OScDev_Device *device;
+    int index; // 0-3 = matrix[0-3], 4 = offsetX, 5 = offsetY
+};
+
+static double *GetTransformField(struct DeviceImplData *devData, int index) {
+    if (index < 4)
+        return &devData->xformMatrix[index];
+    if (index == 4)
+        return &devData->xformOffsetX;
+    return &devData->xformOffsetY;
+}
+
+static OScDev_Error GetTransform(OScDev_Setting *setting, double *value) {
+    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
+    *value = *GetTransformField(GetImplData(data->device), data->index);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetTransform(OScDev_Setting *setting, double value) {
+    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
+    *GetTransformField(GetImplData(data->device), data->index) = value;
+
+    GetImplData(data->device)->scannerConfig.mustRewriteOutput = true;
+
+    return OScDev_OK;
+}
+
+static OScDev_Error GetTransformRange(OScDev_Setting *setting, double *min,
+                                      double *max) {
+    struct TransformSettingData *data = OScDev_Setting_GetImplData(setting);
+    if (data->index == 0 || data->index == 3) {
+        *min = 0.9;
+        *max = 1.1;
+    } else if (data->index < 4) {
+        *min = -0.1;
+        *max = 0.1;
+    } else {
+        *min = -5.0;
+        *max = 5.0;
+    }
+    return OScDev_OK;
+}
+
+static void ReleaseTransform(OScDev_Setting *setting) {
+    free(OScDev_Setting_GetImplData(setting));
+}
+
+static OScDev_SettingImpl SettingImpl_Transform = {
+    .GetFloat64 = GetTransform,
+    .SetFloat64 = SetTransform,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetTransformRange,
+    .Release = ReleaseTransform,
+};
+
+OScDev_Error NIDAQMakeSettings(OScDev_Device *device,
+                               OScDev_PtrArray **settings) {
+    OScDev_RichError *err;
+
+    err = EnumerateAIPhysChans(device);
+    if (err)
+        OScDev_Error_ReturnAsCode(err);
+
+    *settings = OScDev_PtrArray_Create();
+
+    OScDev_Setting *lineDelay;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &lineDelay, "Line Delay (pixels)", OScDev_ValueType_Int32,
+        &SettingImpl_LineDelay, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, lineDelay);
+
+    OScDev_Setting *parkingPositionX;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &parkingPositionX, "Parking Position X (pixels)",
+        OScDev_ValueType_Int32, &SettingImpl_ParkingPositionX, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, parkingPositionX);
+
+    OScDev_Setting *parkingPositionY;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &parkingPositionY, "Parking Position Y (pixels)",
+        OScDev_ValueType_Int32, &SettingImpl_ParkingPositionY, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, parkingPositionY);
+
+    {
+        static const char *transformNames[] = {
+            "TransformA",
+            "TransformB",
+            "TransformC",
+            "TransformD",
+            "TransformOffsetXVolts",
+            "TransformOffsetYVolts",
+        };
+        for (int i = 0; i < 6; ++i) {
+            OScDev_Setting *xformSetting;
+            struct TransformSettingData *data =
+                malloc(sizeof(struct TransformSettingData));
+            data->device = device;
+            data->index = i;
+            err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+                &xformSetting, transformNames[i], OScDev_ValueType_Float64,
+                &SettingImpl_Transform, data));
+            if (err)
+                goto error;
+            OScDev_PtrArray_Append(*settings, xformSetting);
+        }
+    }
+
+    OScDev_Setting *numLinesToBuffer;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &numLinesToBuffer, "Acq Buffer Size (lines)", OScDev_ValueType_Int32,
+        &SettingImpl_AcqBufferSize, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, numLinesToBuffer);
+
+    static const struct {
+        const char *nameFormat;
+        OScDev_ValueType valueType;
+        OScDev_SettingImpl *impl;
+        int index;
+    } channelSettings[] = {
+        {"EnableChannel%d", OScDev_ValueType_Bool, &SettingImpl_EnableChannel,
+         0},
+        {"PhotonCounter%d", OScDev_ValueType_String,
+         &SettingImpl_PhotonCounter, 0},
+        {"ChannelOffsetVolts%d", OScDev_ValueType_Float64,
+         &SettingImpl_ChannelOffset, 0},
+        {"ChannelGain%d", OScDev_ValueType_Float64, &SettingImpl_ChannelGain,
+         0},
+        {"ChannelDarkLevelVolts%d", OScDev_ValueType_Float64,
+         &SettingImpl_ChannelDarkLevel, 0},
+        {"DarkFrameFile%d", OScDev_ValueType_String,
+         &SettingImpl_DarkFrameFile, 0},
+        {"FlatFieldFile%d", OScDev_ValueType_String,
+         &SettingImpl_FlatFieldFile, 0},
+        {"ChannelMin%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_Min},
+        {"ChannelMax%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_Max},
+        {"ChannelMean%d", OScDev_ValueType_Float64,
+         &SettingImpl_FrameStatisticFloat64, FrameStatistic_Mean},
+        {"ChannelClippedLow%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_ClippedLow},
+        {"ChannelClippedHigh%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_ClippedHigh},
+        {"ChannelAutoContrastLow%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_AutoContrastLow},
+        {"ChannelAutoContrastHigh%d", OScDev_ValueType_Int32,
+         &SettingImpl_FrameStatisticInt32, FrameStatistic_AutoContrastHigh},
+    };
+    int nPhysChans = GetNumberOfAIPhysChans(device);
+    for (int i = 0; i < nPhysChans; ++i) {
+        for (size_t j = 0;
+             j < sizeof(channelSettings) / sizeof(channelSettings[0]); ++j) {
+            struct ChannelSettingData *data =
+                malloc(sizeof(struct ChannelSettingData));
+            data->device = device;
+            data->hwChannel = i;
+            data->index = channelSettings[j].index;
+            char name[64];
+            snprintf(name, sizeof(name), channelSettings[j].nameFormat, i);
+            OScDev_Setting *channelSetting;
+            err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+                &channelSetting, name, channelSettings[j].valueType,
+                channelSettings[j].impl, data));
+            if (err)
+                goto error;
+            OScDev_PtrArray_Append(*settings, channelSetting);
+        }
+    }
+
+    OScDev_Setting *inputVoltageRange;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &inputVoltageRange, "Input Voltage Range", OScDev_ValueType_Float64,
+        &SettingImpl_InputVoltageRange, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, inputVoltageRange);
+
+    OScDev_Setting *samplesPerPixel;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &samplesPerPixel, "Samples Per Pixel", OScDev_ValueType_Int32,
+        &SettingImpl_SamplesPerPixel, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, samplesPerPixel);
+
+    OScDev_Setting *lineRepeats;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &lineRepeats, "Line Averaging Repeats", OScDev_ValueType_Int32,
+        &SettingImpl_LineRepeats, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, lineRepeats);
+
+    OScDev_Setting *pixelDepth;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &pixelDepth, "Pixel Depth", OScDev_ValueType_Enum,
+        &SettingImpl_PixelDepth, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, pixelDepth);
+
+    OScDev_Setting *detectorOnScannerClock;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &detectorOnScannerClock, "Detector On Scanner Clock",
+        OScDev_ValueType_Bool, &SettingImpl_DetectorOnScannerClock, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, detectorOnScannerClock);
+
+    OScDev_Setting *darkSamplesPerLine;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &darkSamplesPerLine, "Dark Samples Per Line", OScDev_ValueType_Int32,
+        &SettingImpl_DarkSamplesPerLine, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, darkSamplesPerLine);
+
+    OScDev_Setting *measureDarkOffset;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &measureDarkOffset, "Measure Offset From Dark Samples",
+        OScDev_ValueType_Bool, &SettingImpl_MeasureDarkOffset, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, measureDarkOffset);
+
+    OScDev_Setting *applyFrameCorrection;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &applyFrameCorrection, "Apply Dark/Flat Correction",
+        OScDev_ValueType_Bool, &SettingImpl_ApplyFrameCorrection, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, applyFrameCorrection);
+
+    OScDev_Setting *acquireDarkReference;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &acquireDarkReference, "Acquire Dark Reference",
+        OScDev_ValueType_Bool, &SettingImpl_AcquireDarkReference, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, acquireDarkReference);
+
+    OScDev_Setting *computeFrameStatistics;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &computeFrameStatistics, "Compute Frame Statistics",
+        OScDev_ValueType_Bool, &SettingImpl_ComputeFrameStatistics, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, computeFrameStatistics);
+
+    OScDev_Setting *autoContrastSaturation;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &autoContrastSaturation, "Auto-Contrast Saturated Pixels (%)",
+        OScDev_ValueType_Float64, &SettingImpl_AutoContrastSaturation,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, autoContrastSaturation);
+
+    OScDev_Setting *frameAveraging;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameAveraging, "Frame Averaging", OScDev_ValueType_Enum,
+        &SettingImpl_FrameAveraging, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameAveraging);
+
+    OScDev_Setting *framesToAverage;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &framesToAverage, "Frames To Average", OScDev_ValueType_Int32,
+        &SettingImpl_FramesToAverage, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, framesToAverage);
+
+    OScDev_Setting *averagingOutputInterval;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &averagingOutputInterval, "Averaging Output Interval",
+        OScDev_ValueType_Int32, &SettingImpl_AveragingOutputInterval,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, averagingOutputInterval);
+
+    OScDev_Setting *kalmanGain;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &kalmanGain, "Kalman Gain", OScDev_ValueType_Float64,
+        &SettingImpl_KalmanGain, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, kalmanGain);
+
+    OScDev_Setting *kalmanNoiseVariance;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &kalmanNoiseVariance, "Kalman Noise Variance",
+        OScDev_ValueType_Float64, &SettingImpl_KalmanNoiseVariance, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, kalmanNoiseVariance);
+
+    OScDev_Setting *kalmanProcessVariance;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &kalmanProcessVariance, "Kalman Process Variance",
+        OScDev_ValueType_Float64, &SettingImpl_KalmanProcessVariance,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, kalmanProcessVariance);
+
+    OScDev_Setting *motionCorrection;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionCorrection, "Motion Correction", OScDev_ValueType_Bool,
+        &SettingImpl_MotionCorrection, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionCorrection);
+
+    OScDev_Setting *motionCorrectionApplyShift;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionCorrectionApplyShift, "Motion Correction Apply Shift",
+        OScDev_ValueType_Bool, &SettingImpl_MotionCorrectionApplyShift,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionCorrectionApplyShift);
+
+    OScDev_Setting *motionCorrectionChannel;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionCorrectionChannel, "Motion Correction Channel",
+        OScDev_ValueType_Int32, &SettingImpl_MotionCorrectionChannel, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionCorrectionChannel);
+
+    OScDev_Setting *motionCorrectionDownsampling;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionCorrectionDownsampling, "Motion Correction Downsampling",
+        OScDev_ValueType_Int32, &SettingImpl_MotionCorrectionDownsampling,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionCorrectionDownsampling);
+
+    OScDev_Setting *motionShiftX;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionShiftX, "Motion Shift X", OScDev_ValueType_Float64,
+        &SettingImpl_MotionShiftX, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionShiftX);
+
+    OScDev_Setting *motionShiftY;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &motionShiftY, "Motion Shift Y", OScDev_ValueType_Float64,
+        &SettingImpl_MotionShiftY, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, motionShiftY);
+
+    OScDev_Setting *compression;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compression, "Compression", OScDev_ValueType_Bool,
+        &SettingImpl_Compression, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compression);
+
+    OScDev_Setting *compressionDeliverRaw;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compressionDeliverRaw, "Compression Deliver Raw Frames",
+        OScDev_ValueType_Bool, &SettingImpl_CompressionDeliverRaw, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compressionDeliverRaw);
+
+    OScDev_Setting *compressionThreads;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compressionThreads, "Compression Threads", OScDev_ValueType_Int32,
+        &SettingImpl_CompressionThreads, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compressionThreads);
+
+    OScDev_Setting *compressionFile;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compressionFile, "Compression File", OScDev_ValueType_String,
+        &SettingImpl_CompressionFile, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compressionFile);
+
+    OScDev_Setting *compressionRatio;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compressionRatio, "Compression Ratio", OScDev_ValueType_Float64,
+        &SettingImpl_CompressionRatio, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compressionRatio);
+
+    OScDev_Setting *compressionThroughput;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &compressionThroughput, "Compression Throughput (MB/s)",
+        OScDev_ValueType_Float64, &SettingImpl_CompressionThroughput, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, compressionThroughput);
+
+    OScDev_Setting *sharedMemoryRing;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &sharedMemoryRing, "Shared Memory Ring", OScDev_ValueType_Bool,
+        &SettingImpl_SharedMemoryRing, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, sharedMemoryRing);
+
+    OScDev_Setting *sharedMemoryRingName;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &sharedMemoryRingName, "Shared Memory Ring Name",
+        OScDev_ValueType_String, &SettingImpl_SharedMemoryRingName, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, sharedMemoryRingName);
+
+    OScDev_Setting *sharedMemoryRingSize;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &sharedMemoryRingSize, "Shared Memory Ring Size (MB)",
+        OScDev_ValueType_Int32, &SettingImpl_SharedMemoryRingSize, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, sharedMemoryRingSize);
+
+    OScDev_Setting *frameDeliveryPolicy;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameDeliveryPolicy, "Frame Delivery Policy", OScDev_ValueType_Enum,
+        &SettingImpl_FrameDeliveryPolicy, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameDeliveryPolicy);
+
+    OScDev_Setting *frameDeliveryQueueLength;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameDeliveryQueueLength, "Frame Delivery Queue Length",
+        OScDev_ValueType_Int32, &SettingImpl_FrameDeliveryQueueLength,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameDeliveryQueueLength);
+
+    OScDev_Setting *frameDeliveryDecimation;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameDeliveryDecimation, "Frame Delivery Decimation",
+        OScDev_ValueType_Int32, &SettingImpl_FrameDeliveryDecimation,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameDeliveryDecimation);
+
+    OScDev_Setting *framesDelivered;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &framesDelivered, "Frames Delivered", OScDev_ValueType_Int32,
+        &SettingImpl_FramesDelivered, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, framesDelivered);
+
+    OScDev_Setting *framesDropped;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &framesDropped, "Frames Dropped", OScDev_ValueType_Int32,
+        &SettingImpl_FramesDropped, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, framesDropped);
+
+    OScDev_Setting *frameProcessingThread;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameProcessingThread, "Frame Processing Thread",
+        OScDev_ValueType_Bool, &SettingImpl_FrameProcessingThread, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameProcessingThread);
+
+    OScDev_Setting *acquisitionBusyTime;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &acquisitionBusyTime, "Acquisition Thread Busy Time (s)",
+        OScDev_ValueType_Float64, &SettingImpl_AcquisitionBusyTime, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, acquisitionBusyTime);
+
+    OScDev_Setting *processingBusyTime;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &processingBusyTime, "Processing Thread Busy Time (s)",
+        OScDev_ValueType_Float64, &SettingImpl_ProcessingBusyTime, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, processingBusyTime);
+
+    OScDev_Setting *deliveryBusyTime;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &deliveryBusyTime, "Delivery Thread Busy Time (s)",
+        OScDev_ValueType_Float64, &SettingImpl_DeliveryBusyTime, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, deliveryBusyTime);
+
+    OScDev_Setting *keepScanPlanResident;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &keepScanPlanResident, "Keep Scan Plan Resident",
+        OScDev_ValueType_Bool, &SettingImpl_KeepScanPlanResident, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, keepScanPlanResident);
+
+    OScDev_Setting *armLatency;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &armLatency, "Arm Latency (ms)", OScDev_ValueType_Float64,
+        &SettingImpl_ArmLatency, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, armLatency);
+
+    OScDev_Setting *startLatency;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &startLatency, "Start Latency (ms)", OScDev_ValueType_Float64,
+        &SettingImpl_StartLatency, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, startLatency);
+
+    OScDev_Setting *stopLatency;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &stopLatency, "Stop Latency (ms)", OScDev_ValueType_Float64,
+        &SettingImpl_StopLatency, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, stopLatency);
+
+    OScDev_Setting *parkStartX;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &parkStartX, "Park Start X (V)", OScDev_ValueType_Float64,
+        &SettingImpl_ParkStartX, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, parkStartX);
+
+    OScDev_Setting *parkStartY;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &parkStartY, "Park Start Y (V)", OScDev_ValueType_Float64,
+        &SettingImpl_ParkStartY, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, parkStartY);
+
+    OScDev_Setting *frameInterval;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameInterval, "Frame Interval (ms)", OScDev_ValueType_Float64,
+        &SettingImpl_FrameInterval, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameInterval);
+
+    OScDev_Setting *frameTriggerCounter;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameTriggerCounter, "Frame Trigger Counter",
+        OScDev_ValueType_String, &SettingImpl_FrameTriggerCounter, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameTriggerCounter);
+
+    OScDev_Setting *parkBetweenFrames;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &parkBetweenFrames, "Park Between Frames", OScDev_ValueType_Bool,
+        &SettingImpl_ParkBetweenFrames, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, parkBetweenFrames);
+
+    OScDev_Setting *frameIntervalMean;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameIntervalMean, "Frame Interval Mean (ms)",
+        OScDev_ValueType_Float64, &SettingImpl_FrameIntervalMean, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameIntervalMean);
+
+    OScDev_Setting *frameIntervalJitterRMS;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameIntervalJitterRMS, "Frame Interval Jitter RMS (ms)",
+        OScDev_ValueType_Float64, &SettingImpl_FrameIntervalJitterRMS,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameIntervalJitterRMS);
+
+    OScDev_Setting *frameIntervalJitterMax;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameIntervalJitterMax, "Frame Interval Jitter Max (ms)",
+        OScDev_ValueType_Float64, &SettingImpl_FrameIntervalJitterMax,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameIntervalJitterMax);
+
+    OScDev_Setting *missedFrameTriggers;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &missedFrameTriggers, "Missed Frame Triggers",
+        OScDev_ValueType_Int32, &SettingImpl_MissedFrameTriggers, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, missedFrameTriggers);
+
+    OScDev_Setting *externalTriggerTerminal;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &externalTriggerTerminal, "External Trigger Terminal",
+        OScDev_ValueType_String, &SettingImpl_ExternalTriggerTerminal,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, externalTriggerTerminal);
+
+    OScDev_Setting *externalTriggerFallingEdge;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &externalTriggerFallingEdge, "External Trigger On Falling Edge",
+        OScDev_ValueType_Bool, &SettingImpl_ExternalTriggerFallingEdge,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, externalTriggerFallingEdge);
+
+    OScDev_Setting *externalClockTerminal;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &externalClockTerminal, "External Clock Terminal",
+        OScDev_ValueType_String, &SettingImpl_ExternalClockTerminal, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, externalClockTerminal);
+
+    OScDev_Setting *maxConsecutiveFrameErrors;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &maxConsecutiveFrameErrors, "Max Consecutive Frame Errors",
+        OScDev_ValueType_Int32, &SettingImpl_MaxConsecutiveFrameErrors,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, maxConsecutiveFrameErrors);
+
+    OScDev_Setting *discardedFrames;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &discardedFrames, "Frames Discarded After Errors",
+        OScDev_ValueType_Int32, &SettingImpl_DiscardedFrames, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, discardedFrames);
+
+    OScDev_Setting *overrunFrames;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &overrunFrames, "Overrun Frames", OScDev_ValueType_Int32,
+        &SettingImpl_OverrunFrames, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, overrunFrames);
+
+    OScDev_Setting *shortReadFrames;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &shortReadFrames, "Short Read Frames", OScDev_ValueType_Int32,
+        &SettingImpl_ShortReadFrames, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, shortReadFrames);
+
+    OScDev_Setting *samplesLost;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &samplesLost, "Samples Lost", OScDev_ValueType_Float64,
+        &SettingImpl_SamplesLost, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, samplesLost);
+
+    OScDev_Setting *streamPartialFrames;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &streamPartialFrames, "Stream Partial Frames", OScDev_ValueType_Bool,
+        &SettingImpl_StreamPartialFrames, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, streamPartialFrames);
+
+    OScDev_Setting *lineStreamingInterval;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &lineStreamingInterval, "Line Streaming Interval (ms)",
+        OScDev_ValueType_Float64, &SettingImpl_LineStreamingInterval,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, lineStreamingInterval);
+
+    OScDev_Setting *recordRawSamples;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &recordRawSamples, "Record Raw Samples", OScDev_ValueType_Bool,
+        &SettingImpl_RecordRawSamples, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, recordRawSamples);
+
+    OScDev_Setting *rawRecordingPrefix;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &rawRecordingPrefix, "Raw Recording File Prefix",
+        OScDev_ValueType_String, &SettingImpl_RawRecordingPrefix, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, rawRecordingPrefix);
+
+    OScDev_Setting *rawRecordingFileSize;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &rawRecordingFileSize, "Raw Recording File Size (MB)",
+        OScDev_ValueType_Int32, &SettingImpl_RawRecordingFileSize, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, rawRecordingFileSize);
 
     return OScDev_OK;
 
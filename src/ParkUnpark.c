@@ -31,6 +31,18 @@ OScDev_RichError *ConfigureUnparkTiming(OScDev_Device *device,
         return err;
     }
 
+    // Park and unpark start as soon as started, even in timelapse mode
+    err = CreateDAQmxError(DAQmxDisableStartTrig(config->aoTask));
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to disable trigger for unpark");
+        return err;
+    }
+
+    // The raster must be loaded again after unpark
+    config->mustReconfigureTiming = true;
+    config->mustReconfigureTrigger = true;
+    config->mustRewriteOutput = true;
+
     return OScDev_RichError_OK;
 }
 
@@ -52,6 +64,17 @@ OScDev_RichError *ConfigureParkTiming(OScDev_Device *device,
         return err;
     }
 
+    err = CreateDAQmxError(DAQmxDisableStartTrig(config->aoTask));
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to disable trigger for park");
+        return err;
+    }
+
+    // The raster must be loaded again after park
+    config->mustReconfigureTiming = true;
+    config->mustReconfigureTrigger = true;
+    config->mustRewriteOutput = true;
+
     return OScDev_RichError_OK;
 }
 
@@ -66,6 +89,10 @@ OScDev_RichError *WriteUnparkOutput(OScDev_Device *device,
         (double *)malloc(sizeof(double) * totalElementsPerFramePerChan * 2);
 
     GenerateGalvoUnparkWaveform(&params, xyWaveformFrame);
+    GetImplData(device)->prevXParkVoltage =
+        xyWaveformFrame[totalElementsPerFramePerChan - 1];
+    GetImplData(device)->prevYParkVoltage =
+        xyWaveformFrame[(totalElementsPerFramePerChan * 2) - 1];
 
     int32 numWritten = 0;
     OScDev_RichError *err = CreateDAQmxError(DAQmxWriteAnalogF64(
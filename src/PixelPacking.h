@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 12-bit pixels are packed in pairs into 3 bytes: bits 0-7 of the first
+// pixel, bits 8-11 of the first pixel in the low nibble and bits 0-3 of the
+// second pixel in the high nibble, then bits 4-11 of the second pixel. A
+// frame of n pixels takes (n * 12 + 7) / 8 bytes.
+
+// Store the 12-bit value at index p. Adjacent pixels share the middle byte,
+// and may be stored in either order by separate calls.
+static inline void StorePacked12BitPixel(void *frame, size_t p,
+                                         uint32_t value) {
+    uint8_t *bytes = (uint8_t *)frame + p / 2 * 3;
+    if (p % 2 == 0) {
+        bytes[0] = (uint8_t)value;
+        bytes[1] = (uint8_t)((bytes[1] & 0xf0) | ((value >> 8) & 0x0f));
+    } else {
+        bytes[1] = (uint8_t)((bytes[1] & 0x0f) | ((value & 0x0f) << 4));
+        bytes[2] = (uint8_t)(value >> 4);
+    }
+}
+
+static inline uint16_t LoadPacked12BitPixel(const void *frame, size_t p) {
+    const uint8_t *bytes = (const uint8_t *)frame + p / 2 * 3;
+    if (p % 2 == 0)
+        return (uint16_t)(bytes[0] | (bytes[1] & 0x0f) << 8);
+    return (uint16_t)(bytes[1] >> 4 | bytes[2] << 4);
+}
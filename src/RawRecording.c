@@ -0,0 +1,303 @@
+#include "RawRecording.h"
+
+#include "DAQConfig.h"
+#include "DeviceImplData.h"
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Windows.h>
+
+// Each file is created at its full size (header + fileSizeMB) and mapped
+// into memory. When the detector callback finds that the current file cannot
+// hold another read, it hands the file to the background thread (which
+// flushes, truncates, and closes it) and switches to the spare file that the
+// background thread has already created. If no spare is ready, the samples
+// are still processed but not recorded, and counted as dropped.
+
+void InitializeRawRecording(struct RawRecording *rec) {
+    memset(rec, 0, sizeof(*rec));
+    ss8_init(&rec->filePrefix);
+    rec->fileSizeMB = 1024;
+    InitializeCriticalSection(&rec->lock);
+    InitializeConditionVariable(&rec->cv);
+    InitializeConditionVariable(&rec->retiredCv);
+}
+
+void DestroyRawRecording(struct RawRecording *rec) {
+    ss8_destroy(&rec->filePrefix);
+    DeleteCriticalSection(&rec->lock);
+}
+
+static void GetRecordingFileName(struct RawRecording *rec, uint32_t index,
+                                 ss8str *name) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%04u.raw", index);
+    ss8_copy(name, &rec->filePrefix);
+    ss8_cat_cstr(name, suffix);
+}
+
+static bool OpenRecordingFile(struct RawRecording *rec, uint32_t index,
+                              struct RawRecordingFile *f) {
+    memset(f, 0, sizeof(*f));
+    uint64_t fileSize =
+        RAW_RECORDING_HEADER_SIZE + (uint64_t)rec->fileSizeMB * 1024 * 1024;
+
+    ss8str name;
+    ss8_init(&name);
+    GetRecordingFileName(rec, index, &name);
+    f->file = CreateFileA(ss8_cstr(&name), GENERIC_READ | GENERIC_WRITE,
+                          FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL);
+    ss8_destroy(&name);
+    if (f->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READWRITE,
+                                    (DWORD)(fileSize >> 32),
+                                    (DWORD)(fileSize & 0xffffffff), NULL);
+    if (!f->mapping) {
+        CloseHandle(f->file);
+        return false;
+    }
+
+    f->view = MapViewOfFile(f->mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!f->view) {
+        CloseHandle(f->mapping);
+        CloseHandle(f->file);
+        return false;
+    }
+
+    struct RawRecordingHeader header = rec->header;
+    header.fileIndex = index;
+    memcpy(f->view, &header, sizeof(header));
+    f->dataCapacity = (size_t)(fileSize - RAW_RECORDING_HEADER_SIZE);
+    f->dataSize = 0;
+    return true;
+}
+
+// Write the final data size, flush, and truncate the file to its contents
+static void FinalizeRecordingFile(struct RawRecordingFile *f) {
+    struct RawRecordingHeader *header = (struct RawRecordingHeader *)f->view;
+    header->dataBytes = f->dataSize;
+    FlushViewOfFile(f->view, 0);
+    UnmapViewOfFile(f->view);
+    CloseHandle(f->mapping);
+
+    LARGE_INTEGER end;
+    end.QuadPart = RAW_RECORDING_HEADER_SIZE + (LONGLONG)f->dataSize;
+    SetFilePointerEx(f->file, end, NULL, FILE_BEGIN);
+    SetEndOfFile(f->file);
+    CloseHandle(f->file);
+    memset(f, 0, sizeof(*f));
+}
+
+static DWORD WINAPI RecordingThread(void *param) {
+    struct RawRecording *rec = param;
+
+    EnterCriticalSection(&rec->lock);
+    for (;;) {
+        if (rec->numRetired > 0) {
+            struct RawRecordingFile f = rec->retired[0];
+            --rec->numRetired;
+            memmove(rec->retired, rec->retired + 1,
+                    sizeof(rec->retired[0]) * rec->numRetired);
+            WakeAllConditionVariable(&rec->retiredCv);
+            LeaveCriticalSection(&rec->lock);
+            FinalizeRecordingFile(&f);
+            EnterCriticalSection(&rec->lock);
+            continue;
+        }
+
+        if (rec->stopRequested)
+            break;
+
+        if (!rec->spareReady && !rec->spareFailed) {
+            uint32_t index = rec->nextFileIndex++;
+            LeaveCriticalSection(&rec->lock);
+            struct RawRecordingFile f;
+            bool ok = OpenRecordingFile(rec, index, &f);
+            EnterCriticalSection(&rec->lock);
+            if (ok) {
+                rec->spare = f;
+                rec->spareReady = true;
+            } else {
+                rec->spareFailed = true;
+                OScDev_Log_Error(rec->device,
+                                 "Failed to create raw recording file");
+            }
+            continue;
+        }
+
+        SleepConditionVariableCS(&rec->cv, &rec->lock, INFINITE);
+    }
+    LeaveCriticalSection(&rec->lock);
+    return 0;
+}
+
+// Switch to the spare file; called on the detector callback thread
+static void RollOverRecordingFile(struct RawRecording *rec) {
+    EnterCriticalSection(&rec->lock);
+    if (rec->current.view) {
+        if (rec->numRetired < RAW_RECORDING_MAX_RETIRED) {
+            rec->retired[rec->numRetired++] = rec->current;
+            memset(&rec->current, 0, sizeof(rec->current));
+        }
+        // Otherwise the background thread is far behind; keep the (full)
+        // current file and drop samples until it catches up.
+    }
+    if (!rec->current.view && rec->spareReady) {
+        rec->current = rec->spare;
+        rec->spareReady = false;
+    }
+    LeaveCriticalSection(&rec->lock);
+    WakeConditionVariable(&rec->cv);
+}
+
+OScDev_RichError *StartRawRecording(OScDev_Device *device,
+                                    struct RawRecording *rec,
+                                    OScDev_Acquisition *acq) {
+    if (!rec->enabled || GetImplData(device)->scannerOnly ||
+        GetNumberOfEnabledAIChannels(device) == 0)
+        return OScDev_RichError_OK;
+    if (ss8_is_empty(&rec->filePrefix))
+        return OScDev_Error_Create(
+            "Raw recording file prefix must be set to record raw samples");
+
+    struct RawRecordingHeader *header = &rec->header;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, "OSNIDAQR", 8);
+    header->version = RAW_RECORDING_VERSION;
+    header->headerSize = RAW_RECORDING_HEADER_SIZE;
+    header->sampleFormat = RawSampleFormat_Float64;
+    // Only the AI samples are recorded, not photon counts
+    header->numChannels = GetNumberOfEnabledAIChannels(device);
+    int ch = 0;
+    for (int hwChannel = 0; hwChannel < MAX_PHYSICAL_CHANS; ++hwChannel) {
+        if (GetImplData(device)->channelEnabled[hwChannel] &&
+            !IsPhotonCountingChannel(device, hwChannel))
+            header->hwChannels[ch++] = hwChannel;
+    }
+    for (; ch < RAW_RECORDING_MAX_CHANNELS; ++ch)
+        header->hwChannels[ch] = -1;
+    header->pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
+    header->resolution = OScDev_Acquisition_GetResolution(acq);
+    header->zoomFactor = OScDev_Acquisition_GetZoomFactor(acq);
+    OScDev_Acquisition_GetROI(acq, &header->xOffset, &header->yOffset,
+                              &header->width, &header->height);
+    header->lineDelay = GetImplData(device)->lineDelay;
+    header->samplesPerPixel = GetImplData(device)->samplesPerPixel;
+    header->lineRepeats = GetImplData(device)->lineRepeats;
+    header->leadingSamplesPerLine = GetImplData(device)->lineLeadingSamples;
+    header->samplesPerChanPerLine =
+        GetImplData(device)->detectorSamplesPerLine;
+    header->inputVoltageRange = GetImplData(device)->inputVoltageRange;
+    for (int i = 0; i < RAW_RECORDING_MAX_CHANNELS; ++i) {
+        header->channelOffsetVolts[i] =
+            GetImplData(device)->channelOffsetVolts[i];
+        header->channelGain[i] = GetImplData(device)->channelGain[i];
+    }
+
+    rec->device = device;
+    rec->droppedSamples = 0;
+    rec->stopRequested = false;
+    rec->nextFileIndex = 0;
+    rec->spareReady = false;
+    rec->spareFailed = false;
+    rec->numRetired = 0;
+    memset(&rec->current, 0, sizeof(rec->current));
+
+    // Open the first file synchronously so that errors are reported now
+    if (!OpenRecordingFile(rec, rec->nextFileIndex++, &rec->current))
+        return OScDev_Error_Create("Failed to create raw recording file");
+
+    DWORD id;
+    rec->thread = CreateThread(NULL, 0, RecordingThread, rec, 0, &id);
+    if (!rec->thread) {
+        // Nothing has been recorded, so remove the first file
+        FinalizeRecordingFile(&rec->current);
+        ss8str name;
+        ss8_init(&name);
+        GetRecordingFileName(rec, 0, &name);
+        DeleteFileA(ss8_cstr(&name));
+        ss8_destroy(&name);
+        return OScDev_Error_Create("Cannot start raw recording thread");
+    }
+    rec->active = true;
+    return OScDev_RichError_OK;
+}
+
+// Must not be called while the detector task is running
+void StopRawRecording(OScDev_Device *device, struct RawRecording *rec) {
+    if (!rec->active)
+        return;
+    rec->active = false;
+
+    EnterCriticalSection(&rec->lock);
+    if (rec->current.view) {
+        // Wait for room in the retired list (the thread keeps draining it)
+        while (rec->numRetired == RAW_RECORDING_MAX_RETIRED)
+            SleepConditionVariableCS(&rec->retiredCv, &rec->lock, INFINITE);
+        rec->retired[rec->numRetired++] = rec->current;
+        memset(&rec->current, 0, sizeof(rec->current));
+    }
+    rec->stopRequested = true;
+    LeaveCriticalSection(&rec->lock);
+    WakeConditionVariable(&rec->cv);
+
+    WaitForSingleObject(rec->thread, INFINITE);
+    CloseHandle(rec->thread);
+    rec->thread = NULL;
+
+    // Remove the unused spare, if any
+    if (rec->spareReady) {
+        FinalizeRecordingFile(&rec->spare);
+        rec->spareReady = false;
+        ss8str name;
+        ss8_init(&name);
+        GetRecordingFileName(rec, rec->nextFileIndex - 1, &name);
+        DeleteFileA(ss8_cstr(&name));
+        ss8_destroy(&name);
+    }
+
+    if (rec->droppedSamples > 0) {
+        char msg[OScDev_MAX_STR_LEN + 1];
+        snprintf(msg, OScDev_MAX_STR_LEN,
+                 "Raw recording dropped %llu samples (disk too slow)",
+                 (unsigned long long)rec->droppedSamples);
+        OScDev_Log_Warning(device, msg);
+    }
+}
+
+// Return where to read up to maxSamples samples into the recording, or NULL
+// if not recording (or there is no room)
+float64 *BeginRawRecordingWrite(struct RawRecording *rec, size_t maxSamples) {
+    if (!rec->active)
+        return NULL;
+
+    size_t bytes = sizeof(float64) * maxSamples;
+    if (!rec->current.view ||
+        rec->current.dataCapacity - rec->current.dataSize < bytes) {
+        RollOverRecordingFile(rec);
+        if (!rec->current.view ||
+            rec->current.dataCapacity - rec->current.dataSize < bytes)
+            return NULL;
+    }
+    return (float64 *)(rec->current.view + RAW_RECORDING_HEADER_SIZE +
+                       rec->current.dataSize);
+}
+
+void EndRawRecordingWrite(struct RawRecording *rec, bool written,
+                          size_t numSamples) {
+    if (!rec->active)
+        return;
+    if (written)
+        rec->current.dataSize += sizeof(float64) * numSamples;
+    else
+        rec->droppedSamples += numSamples;
+}
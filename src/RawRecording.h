@@ -0,0 +1,111 @@
+#pragma once
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+#include <ss8str.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+#define RAW_RECORDING_HEADER_SIZE 4096
+
+// Incremented whenever the header layout changes:
+// 1: First version
+// 2: Added samplesPerPixel (AI oversampling)
+// 3: Added leadingSamplesPerLine (detector on the scanner clock)
+// 4: Added lineRepeats (line averaging)
+#define RAW_RECORDING_VERSION 4
+#define RAW_RECORDING_MAX_CHANNELS 8
+#define RAW_RECORDING_MAX_RETIRED 4
+
+enum RawSampleFormat {
+    RawSampleFormat_Float64 = 1, // Volts, channels interleaved
+};
+
+// Header at the start of each recording file; the samples follow at offset
+// RAW_RECORDING_HEADER_SIZE. All fields are little-endian and naturally
+// aligned, with the padding spelled out, so that the layout does not depend
+// on the compiler (272 bytes; the byte offsets around the padding are noted).
+struct RawRecordingHeader {
+    char magic[8]; // "OSNIDAQR"
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t sampleFormat; // enum RawSampleFormat
+    uint32_t numChannels;
+    int32_t hwChannels[RAW_RECORDING_MAX_CHANNELS]; // -1 if unused
+    double pixelRateHz;
+    uint32_t resolution; // 64
+    uint32_t reserved0;
+    double zoomFactor; // 72
+    uint32_t xOffset;
+    uint32_t yOffset;
+    uint32_t width;
+    uint32_t height;
+    uint32_t lineDelay;
+    uint32_t samplesPerPixel;
+    uint32_t lineRepeats; // Lines in the file per image line
+    uint32_t leadingSamplesPerLine; // Before the first pixel
+    uint32_t samplesPerChanPerLine; // Including dark and leading samples
+    uint32_t reserved1;
+    double inputVoltageRange; // 120
+    double channelOffsetVolts[RAW_RECORDING_MAX_CHANNELS];
+    double channelGain[RAW_RECORDING_MAX_CHANNELS];
+    uint32_t fileIndex; // 256
+    uint32_t reserved2;
+    uint64_t dataBytes; // 264; written when the file is closed
+};
+
+struct RawRecordingFile {
+    HANDLE file;
+    HANDLE mapping;
+    uint8_t *view;
+    size_t dataCapacity; // Bytes available after header
+    size_t dataSize;     // Bytes written after header
+};
+
+// Streams raw samples into a series of preallocated, memory-mapped files.
+// The detector callback reads samples directly into the mapped file; a
+// background thread prepares the next file and finalizes full ones, so that
+// the callback never waits for disk I/O.
+// See RawRecording.c
+struct RawRecording {
+    // Settings
+    bool enabled;
+    ss8str filePrefix;
+    uint32_t fileSizeMB;
+
+    // Valid while recording
+    bool active;
+    OScDev_Device *device; // For logging
+    struct RawRecordingHeader header; // Template for each file
+    struct RawRecordingFile current;  // Accessed only by detector callback
+    uint64_t droppedSamples;
+
+    // Shared with the background thread
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cv;
+    CONDITION_VARIABLE retiredCv; // An entry has left the retired list
+    HANDLE thread;
+    bool stopRequested;
+    uint32_t nextFileIndex;
+    struct RawRecordingFile spare;
+    bool spareReady;
+    bool spareFailed;
+    struct RawRecordingFile retired[RAW_RECORDING_MAX_RETIRED];
+    int numRetired;
+};
+
+void InitializeRawRecording(struct RawRecording *rec);
+void DestroyRawRecording(struct RawRecording *rec);
+
+OScDev_RichError *StartRawRecording(OScDev_Device *device,
+                                    struct RawRecording *rec,
+                                    OScDev_Acquisition *acq);
+void StopRawRecording(OScDev_Device *device, struct RawRecording *rec);
+
+float64 *BeginRawRecordingWrite(struct RawRecording *rec, size_t maxSamples);
+void EndRawRecordingWrite(struct RawRecording *rec, bool written,
+                          size_t numSamples);
@@ -3,6 +3,8 @@
 #include "DAQConfig.h"
 #include "DAQError.h"
 #include "DeviceImplData.h"
+#include "FrameTrigger.h"
+#include "TaskDone.h"
 #include "Waveform.h"
 
 #include <NIDAQmx.h>
@@ -22,9 +24,13 @@ static OScDev_RichError *ConfigureScannerTiming(OScDev_Device *device,
 
     int32 totalElementsPerFramePerChan = GetScannerWaveformSize(&params);
 
+    ss8str clockSrc;
+    ss8_init(&clockSrc);
+    GetSampleClockSource(device, &clockSrc);
     err = CreateDAQmxError(DAQmxCfgSampClkTiming(
-        config->aoTask, "", pixelRateHz, DAQmx_Val_Rising,
+        config->aoTask, ss8_cstr(&clockSrc), pixelRateHz, DAQmx_Val_Rising,
         DAQmx_Val_FiniteSamps, totalElementsPerFramePerChan));
+    ss8_destroy(&clockSrc);
     if (err) {
         err = OScDev_Error_Wrap(err, "Failed to configure timing for scanner");
         return err;
@@ -33,6 +39,40 @@ static OScDev_RichError *ConfigureScannerTiming(OScDev_Device *device,
     return OScDev_RichError_OK;
 }
 
+// Start on the frame trigger in timelapse mode (the frame trigger itself
+// waits for any external trigger), else on the external trigger if
+// requested, else as soon as started
+static OScDev_RichError *
+ConfigureScannerTrigger(OScDev_Device *device, struct ScannerConfig *config) {
+    struct FrameTrigger *trig = &GetImplData(device)->frameTrigger;
+    OScDev_RichError *err;
+    if (trig->intervalSec > 0.0) {
+        ss8str trigSrc;
+        ss8_init(&trigSrc);
+        GetFrameTriggerTerminal(device, trig, &trigSrc);
+        err = CreateDAQmxError(DAQmxCfgDigEdgeStartTrig(
+            config->aoTask, ss8_cstr(&trigSrc), DAQmx_Val_Rising));
+        ss8_destroy(&trigSrc);
+    } else if (GetImplData(device)->configuredExternalTrigger) {
+        ss8str trigSrc;
+        ss8_init(&trigSrc);
+        GetExternalTriggerSource(device, &trigSrc);
+        err = CreateDAQmxError(DAQmxCfgDigEdgeStartTrig(
+            config->aoTask, ss8_cstr(&trigSrc),
+            GetImplData(device)->externalTriggerFallingEdge
+                ? DAQmx_Val_Falling
+                : DAQmx_Val_Rising));
+        ss8_destroy(&trigSrc);
+    } else {
+        err = CreateDAQmxError(DAQmxDisableStartTrig(config->aoTask));
+    }
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to configure scanner trigger");
+        return err;
+    }
+    return OScDev_RichError_OK;
+}
+
 static OScDev_RichError *WriteScannerOutput(OScDev_Device *device,
                                             struct ScannerConfig *config,
                                             OScDev_Acquisition *acq) {
@@ -58,6 +98,12 @@ static OScDev_RichError *WriteScannerOutput(OScDev_Device *device,
         goto cleanup;
     }
 
+    // Keep the waveform in case a frame is aborted
+    free(config->rasterWaveform);
+    config->rasterWaveform = xyWaveformFrame;
+    config->rasterSamplesPerChan = totalElementsPerFramePerChan;
+    return OScDev_RichError_OK;
+
 cleanup:
     free(xyWaveformFrame);
     return err;
@@ -90,22 +136,39 @@ OScDev_RichError *SetUpScanner(OScDev_Device *device,
             goto error;
         }
 
+        err = RegisterTaskDoneSignal(config->aoTask, &config->aoDone);
+        if (err)
+            goto error;
+
         config->mustReconfigureTiming = true;
+        config->mustReconfigureTrigger = true;
         config->mustRewriteOutput = true;
         mustCommit = true;
     }
 
-    err = ConfigureScannerTiming(device, config, acq);
-    if (err)
-        goto error;
-    config->mustReconfigureTiming = false;
-    mustCommit = true;
+    if (config->mustReconfigureTiming) {
+        err = ConfigureScannerTiming(device, config, acq);
+        if (err)
+            goto error;
+        config->mustReconfigureTiming = false;
+        mustCommit = true;
+    }
 
-    err = WriteScannerOutput(device, config, acq);
-    if (err)
-        goto error;
-    config->mustRewriteOutput = false;
-    mustCommit = true;
+    if (config->mustReconfigureTrigger) {
+        err = ConfigureScannerTrigger(device, config);
+        if (err)
+            goto error;
+        config->mustReconfigureTrigger = false;
+        mustCommit = true;
+    }
+
+    if (config->mustRewriteOutput) {
+        err = WriteScannerOutput(device, config, acq);
+        if (err)
+            goto error;
+        config->mustRewriteOutput = false;
+        mustCommit = true;
+    }
 
     if (mustCommit) {
         err = CreateDAQmxError(
@@ -141,6 +204,7 @@ OScDev_RichError *ShutdownScanner(struct ScannerConfig *config) {
 
 OScDev_RichError *StartScanner(struct ScannerConfig *config) {
     OScDev_RichError *err;
+    ResetTaskDoneSignal(&config->aoDone);
     err = CreateDAQmxError(DAQmxStartTask(config->aoTask));
     if (err) {
         err = OScDev_Error_Wrap(err, "Failed to start scanner task");
@@ -161,6 +225,54 @@ OScDev_RichError *StopScanner(struct ScannerConfig *config) {
     return OScDev_RichError_OK;
 }
 
+// After the first frame has started on the external trigger, start the
+// following frames as soon as started. The task is committed again so that
+// the next start is not delayed; the trigger is configured again when next
+// set up.
+OScDev_RichError *DisableScannerTrigger(struct ScannerConfig *config) {
+    config->mustReconfigureTrigger = true;
+    OScDev_RichError *err =
+        CreateDAQmxError(DAQmxDisableStartTrig(config->aoTask));
+    if (!err)
+        err = CreateDAQmxError(
+            DAQmxTaskControl(config->aoTask, DAQmx_Val_Task_Commit));
+    if (err) {
+        err = OScDev_Error_Wrap(err, "Failed to disable scanner trigger");
+        ShutdownScanner(config); // Force re-setup next time
+        return err;
+    }
+    return OScDev_RichError_OK;
+}
+
+// Stop the raster in the middle of a frame and get the last voltages output
+// (unchanged if the raster had not started)
+OScDev_RichError *AbortScanner(struct ScannerConfig *config, double *xVolts,
+                               double *yVolts) {
+    OScDev_RichError *err = StopScanner(config);
+    if (err)
+        return err;
+
+    uInt64 generated = 0;
+    err = CreateDAQmxError(
+        DAQmxGetWriteTotalSampPerChanGenerated(config->aoTask, &generated));
+    if (err)
+        return OScDev_Error_Wrap(
+            err, "Failed to get number of scanner samples generated");
+
+    if (generated > 0 && config->rasterWaveform) {
+        uInt64 index = (generated - 1) % config->rasterSamplesPerChan;
+        *xVolts = config->rasterWaveform[index];
+        *yVolts =
+            config->rasterWaveform[index + config->rasterSamplesPerChan];
+    }
+    return OScDev_RichError_OK;
+}
+
+void DestroyScannerConfig(struct ScannerConfig *config) {
+    free(config->rasterWaveform);
+    config->rasterWaveform = NULL;
+}
+
 OScDev_RichError *CreateScannerTask(OScDev_Device *device,
                                     struct ScannerConfig *config) {
     if (!(config)->aoTask) {
@@ -186,6 +298,14 @@ OScDev_RichError *CreateScannerTask(OScDev_Device *device,
                     device, "Failed to clean up scanner task after error");
             return err;
         }
+
+        err = RegisterTaskDoneSignal(config->aoTask, &config->aoDone);
+        if (err) {
+            if (ShutdownScanner(config))
+                OScDev_Log_Error(
+                    device, "Failed to clean up scanner task after error");
+            return err;
+        }
     }
     return OScDev_RichError_OK;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "TaskDone.h"
+
 #include <NIDAQmx.h>
 #include <OpenScanDeviceLib.h>
 
@@ -7,7 +9,13 @@
 // See Scanner.c
 struct ScannerConfig {
     TaskHandle aoTask;
+    struct TaskDoneSignal aoDone; // Set when the waveform is finished
+    // The raster last written to aoTask (X samples, then Y), kept to find
+    // where the galvos were when a frame is aborted
+    double *rasterWaveform;
+    int32 rasterSamplesPerChan;
     bool mustReconfigureTiming;
+    bool mustReconfigureTrigger;
     bool mustRewriteOutput;
 };
 
@@ -17,6 +25,10 @@ OScDev_RichError *SetUpScanner(OScDev_Device *device,
 OScDev_RichError *ShutdownScanner(struct ScannerConfig *config);
 OScDev_RichError *StartScanner(struct ScannerConfig *config);
 OScDev_RichError *StopScanner(struct ScannerConfig *config);
+OScDev_RichError *DisableScannerTrigger(struct ScannerConfig *config);
+OScDev_RichError *AbortScanner(struct ScannerConfig *config, double *xVolts,
+                               double *yVolts);
+void DestroyScannerConfig(struct ScannerConfig *config);
 
 OScDev_RichError *CreateScannerTask(OScDev_Device *device,
                                     struct ScannerConfig *config);
@@ -0,0 +1,111 @@
+#include "TaskDone.h"
+
+#include "DAQError.h"
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+// The done event must be registered while the task is not running, so it is
+// registered once when the task is created; it remains registered until the
+// task is cleared. The signal is reset before each start of the task.
+
+#define MAX_TASK_DONE_SIGNALS 4
+
+void InitializeTaskDoneSignal(struct TaskDoneSignal *signal) {
+    signal->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    signal->status = 0;
+}
+
+void DestroyTaskDoneSignal(struct TaskDoneSignal *signal) {
+    if (signal->event)
+        CloseHandle(signal->event);
+    signal->event = NULL;
+}
+
+// Called on a DAQmx thread
+static int32 TaskDoneCallback(TaskHandle task, int32 status,
+                              void *callbackData) {
+    (void)task; // Unused
+    struct TaskDoneSignal *signal = callbackData;
+    InterlockedExchange(&signal->status, status);
+    SetEvent(signal->event);
+    return 0;
+}
+
+OScDev_RichError *RegisterTaskDoneSignal(TaskHandle task,
+                                         struct TaskDoneSignal *signal) {
+    if (!signal->event)
+        return OScDev_Error_Create("Cannot create task done event");
+    OScDev_RichError *err = CreateDAQmxError(
+        DAQmxRegisterDoneEvent(task, 0, TaskDoneCallback, signal));
+    if (err)
+        return OScDev_Error_Wrap(err, "Failed to register task done event");
+    return OScDev_RichError_OK;
+}
+
+void ResetTaskDoneSignal(struct TaskDoneSignal *signal) {
+    InterlockedExchange(&signal->status, 0);
+    ResetEvent(signal->event);
+}
+
+// Wait until all of the given tasks are done; return the error of the first
+// task that failed. If interruptEvent (unless NULL) is signaled first, set
+// *interrupted and return without error.
+OScDev_RichError *WaitForTaskDoneSignals(struct TaskDoneSignal *const *signals,
+                                         uint32_t count, DWORD timeoutMs,
+                                         HANDLE interruptEvent,
+                                         bool *interrupted) {
+    HANDLE events[MAX_TASK_DONE_SIGNALS + 1];
+    if (count > MAX_TASK_DONE_SIGNALS)
+        return OScDev_Error_Create("Too many task done signals");
+    *interrupted = false;
+
+    // Wait for any of the remaining tasks or the interruption, until no
+    // task remains
+    LARGE_INTEGER freq, start, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (;;) {
+        DWORD numEvents = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (WaitForSingleObject(signals[i]->event, 0) != WAIT_OBJECT_0)
+                events[numEvents++] = signals[i]->event;
+        }
+        if (numEvents == 0)
+            break;
+        bool canInterrupt = interruptEvent != NULL;
+        if (canInterrupt)
+            events[numEvents++] = interruptEvent;
+
+        QueryPerformanceCounter(&now);
+        LONGLONG elapsedMs =
+            1000 * (now.QuadPart - start.QuadPart) / freq.QuadPart;
+        if (elapsedMs >= (LONGLONG)timeoutMs)
+            return OScDev_Error_Create(
+                "Timed out waiting for tasks to finish");
+        DWORD result = WaitForMultipleObjects(
+            numEvents, events, FALSE, timeoutMs - (DWORD)elapsedMs);
+        if (result == WAIT_TIMEOUT)
+            return OScDev_Error_Create(
+                "Timed out waiting for tasks to finish");
+        if (result == WAIT_FAILED)
+            return OScDev_Error_Create("Failed to wait for tasks to finish");
+        if (canInterrupt && result == WAIT_OBJECT_0 + numEvents - 1) {
+            *interrupted = true;
+            return OScDev_RichError_OK;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        int32 status = (int32)InterlockedCompareExchange(&signals[i]->status,
+                                                         0, 0);
+        if (status < 0)
+            return CreateDAQmxError(status);
+    }
+    return OScDev_RichError_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <NIDAQmx.h>
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Windows.h>
+
+// Event set by DAQmx when a finite task finishes, so that the acquisition
+// thread can wait for the hardware instead of sleeping for an estimated time
+// See TaskDone.c
+struct TaskDoneSignal {
+    HANDLE event;         // Manual reset; set when the task is done
+    volatile LONG status; // DAQmx status reported with the done event
+};
+
+void InitializeTaskDoneSignal(struct TaskDoneSignal *signal);
+void DestroyTaskDoneSignal(struct TaskDoneSignal *signal);
+
+OScDev_RichError *RegisterTaskDoneSignal(TaskHandle task,
+                                         struct TaskDoneSignal *signal);
+void ResetTaskDoneSignal(struct TaskDoneSignal *signal);
+OScDev_RichError *WaitForTaskDoneSignals(struct TaskDoneSignal *const *signals,
+                                         uint32_t count, DWORD timeoutMs,
+                                         HANDLE interruptEvent,
+                                         bool *interrupted);
@@ -53,40 +53,45 @@ static void GenerateXGalvoWaveform(int32_t effectiveScanLen,
     }
 }
 
-// Generate Y waveform for one frame
-static void GenerateYGalvoWaveform(int32_t linesPerFrame, int32_t retraceLen,
-                                   size_t xLength, double scanStart,
-                                   double scanEnd, double *waveform) {
+// Generate Y waveform for one frame, holding each line for lineRepeats X
+// periods
+static void GenerateYGalvoWaveform(int32_t linesPerFrame, int32_t lineRepeats,
+                                   int32_t retraceLen, size_t xLength,
+                                   double scanStart, double scanEnd,
+                                   double *waveform) {
     (void)retraceLen; // Unused
 
     double scanAmplitude = scanEnd - scanStart;
     double step = scanAmplitude / linesPerFrame;
+    int32_t scanLines = linesPerFrame * lineRepeats;
 
     // Generate staircase for one frame
-    for (int j = 0; j < linesPerFrame; ++j) {
+    for (int s = 0; s < scanLines; ++s) {
+        int j = s / lineRepeats;
         for (unsigned i = 0; i < xLength; ++i) {
-            waveform[i + j * xLength] = scanStart + step * j;
+            waveform[i + s * xLength] = scanStart + step * j;
             // stop at last x retrace
-            if ((j >= linesPerFrame - 1) && (i >= xLength - X_RETRACE_LEN)) {
+            if ((s >= scanLines - 1) && (i >= xLength - X_RETRACE_LEN)) {
                 break;
             }
         }
     }
 
-    // Smooth Y transitions during each line's X retrace
+    // Smooth Y transitions during the X retrace of the last repeat of each
+    // line
     for (int j = 0; j < linesPerFrame - 1; ++j) {
         double yThis = scanStart + step * j;
         double yNext = scanStart + step * (j + 1);
+        int lastScan = (j + 1) * lineRepeats - 1;
         SplineInterpolate(X_RETRACE_LEN, yThis, yNext, 0, 0,
-                          waveform + (j + 1) * xLength - X_RETRACE_LEN);
+                          waveform + (lastScan + 1) * xLength - X_RETRACE_LEN);
     }
 
     // Generate the rescan curve at end of frame
     if (X_RETRACE_LEN > 0) {
         double lastLineY = scanStart + step * (linesPerFrame - 1);
         SplineInterpolate(X_RETRACE_LEN, lastLineY, scanStart, 0, 0,
-                          waveform + (linesPerFrame * xLength) -
-                              X_RETRACE_LEN);
+                          waveform + (scanLines * xLength) - X_RETRACE_LEN);
     }
 }
 
@@ -95,7 +100,7 @@ void GenerateLineClock(const struct WaveformParams *parameters,
                        uint8_t *lineClock) {
     uint32_t lineDelay = parameters->undershoot;
     uint32_t width = parameters->width;
-    uint32_t height = parameters->height;
+    uint32_t height = GetScanLinesPerFrame(parameters);
 
     uint32_t x_length = lineDelay + width + X_RETRACE_LEN;
     for (uint32_t j = 0; j < height; j++)
@@ -111,7 +116,7 @@ void GenerateFLIMLineClock(const struct WaveformParams *parameters,
                            uint8_t *lineClockFLIM) {
     uint32_t lineDelay = parameters->undershoot;
     uint32_t width = parameters->width;
-    uint32_t height = parameters->height;
+    uint32_t height = GetScanLinesPerFrame(parameters);
 
     uint32_t x_length = lineDelay + width + X_RETRACE_LEN;
     for (uint32_t j = 0; j < height; j++)
@@ -125,7 +130,7 @@ void GenerateFLIMFrameClock(const struct WaveformParams *parameters,
                             uint8_t *frameClockFLIM) {
     uint32_t lineDelay = parameters->undershoot;
     uint32_t width = parameters->width;
-    uint32_t height = parameters->height;
+    uint32_t height = GetScanLinesPerFrame(parameters);
 
     uint32_t x_length = lineDelay + width + X_RETRACE_LEN;
 
@@ -135,19 +140,24 @@ void GenerateFLIMFrameClock(const struct WaveformParams *parameters,
                 ((j == height - 1) && (i > lineDelay + width)) ? 1 : 0;
 }
 
+// Number of X periods per frame, including repeats of each line
+uint32_t GetScanLinesPerFrame(const struct WaveformParams *parameters) {
+    return parameters->height * parameters->lineRepeats;
+}
+
 int32_t GetLineWaveformSize(const struct WaveformParams *parameters) {
     return parameters->undershoot + parameters->width + X_RETRACE_LEN;
 }
 
 int32_t GetClockWaveformSize(const struct WaveformParams *parameters) {
     uint32_t elementsPerLine = GetLineWaveformSize(parameters);
-    uint32_t height = parameters->height;
+    uint32_t height = GetScanLinesPerFrame(parameters);
     return elementsPerLine * height;
 }
 
 int32_t GetScannerWaveformSize(const struct WaveformParams *parameters) {
     uint32_t elementsPerLine = GetLineWaveformSize(parameters);
-    uint32_t height = parameters->height;
+    uint32_t height = GetScanLinesPerFrame(parameters);
     uint32_t yLen = height;
     return elementsPerLine * yLen; // including y retrace portion
 }
@@ -191,14 +201,14 @@ void GenerateGalvoWaveformFrame(const struct WaveformParams *parameters,
     double yEnd = yStart + linesPerFrame / (zoom * resolution);
 
     size_t xLength = undershoot + pixelsPerLine + X_RETRACE_LEN;
-    size_t yLength = linesPerFrame;
+    size_t yLength = GetScanLinesPerFrame(parameters);
 
     double *xWaveform = (double *)malloc(sizeof(double) * xLength);
     double *yWaveform = (double *)malloc(sizeof(double) * (yLength * xLength));
     GenerateXGalvoWaveform(pixelsPerLine, X_RETRACE_LEN, undershoot, xStart,
                            xEnd, xWaveform);
-    GenerateYGalvoWaveform(linesPerFrame, X_RETRACE_LEN, xLength, yStart, yEnd,
-                           yWaveform);
+    GenerateYGalvoWaveform(linesPerFrame, parameters->lineRepeats,
+                           X_RETRACE_LEN, xLength, yStart, yEnd, yWaveform);
 
     for (unsigned j = 0; j < yLength; ++j) {
         for (unsigned i = 0; i < xLength; ++i) {
@@ -267,23 +277,21 @@ void GenerateGalvoUnparkWaveform(const struct WaveformParams *parameters,
     free(yWaveform);
 }
 
-// Generate waveform from start to parking after one frame
+// Generate waveform to parking from the last voltages output: the start of
+// the raster after a complete frame, or wherever a frame was aborted
 void GenerateGalvoParkWaveform(const struct WaveformParams *parameters,
                                double *xyWaveformFrame) {
     uint32_t resolution = parameters->resolution;
     double zoom = parameters->zoom;
-    uint32_t xOffset = parameters->xOffset;
-    uint32_t yOffset = parameters->yOffset;
-    int32_t undershoot = parameters->undershoot;
     int32_t xPark = parameters->xPark;
     int32_t yPark = parameters->yPark;
     const double *m = parameters->xformMatrix;
     double tx = parameters->xformOffsetX;
     double ty = parameters->xformOffsetY;
 
-    double xStart =
-        (-0.5 * resolution + xOffset - undershoot) / (zoom * resolution);
-    double yStart = (-0.5 * resolution + yOffset) / (zoom * resolution);
+    double xStart, yStart;
+    InverseTransform2x2(m, tx, ty, parameters->prevXParkVoltage,
+                        parameters->prevYParkVoltage, &xStart, &yStart);
     double xEnd = (-0.5 * resolution + xPark) / (zoom * resolution);
     double yEnd = (-0.5 * resolution + yPark) / (zoom * resolution);
 
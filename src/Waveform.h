@@ -3,8 +3,9 @@
 #include <stdint.h>
 
 struct WaveformParams {
-    uint32_t width;  // PixelsPerLine
-    uint32_t height; // numScanLines
+    uint32_t width;       // PixelsPerLine
+    uint32_t height;      // Lines in the image
+    uint32_t lineRepeats; // Times each line is scanned (line averaging)
     uint32_t resolution;
     double zoom;
     uint32_t undershoot; // also LineDelay for clock waveforms
@@ -25,6 +26,7 @@ void GenerateFLIMLineClock(const struct WaveformParams *parameters,
                            uint8_t *lineClockFLIM);
 void GenerateFLIMFrameClock(const struct WaveformParams *parameters,
                             uint8_t *frameClockFLIM);
+uint32_t GetScanLinesPerFrame(const struct WaveformParams *parameters);
 int32_t GetLineWaveformSize(const struct WaveformParams *parameters);
 int32_t GetClockWaveformSize(const struct WaveformParams *parameters);
 int32_t GetScannerWaveformSize(const struct WaveformParams *parameters);
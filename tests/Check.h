@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Report a failed condition on stderr; return the condition
+static inline bool Check(bool condition, const char *what) {
+    if (!condition)
+        fprintf(stderr, "FAILED: %s\n", what);
+    return condition;
+}
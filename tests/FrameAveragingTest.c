@@ -0,0 +1,87 @@
+#include "../src/FrameAveraging.h"
+
+#include "Check.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_PIXELS 64
+
+// The mean of each group of frames is delivered once per group
+static bool TestMean(void) {
+    struct FrameAverager avg;
+    InitializeFrameAverager(&avg);
+    avg.mode = FrameAveragingMode_Mean;
+    avg.framesToAverage = 4;
+    OScDev_RichError *err = ResetFrameAverager(&avg, 1, NUM_PIXELS);
+    bool ok = Check(!err, "mean: reset");
+
+    uint16_t frame[NUM_PIXELS];
+    uint16_t *frames[1] = {frame};
+    for (uint32_t i = 0; ok && i < 4; ++i) {
+        for (size_t p = 0; p < NUM_PIXELS; ++p)
+            frame[p] = (uint16_t)(100 * (i + 1) + p);
+        bool delivered = AccumulateFrame(&avg, frames);
+        ok = Check(delivered == (i == 3), "mean: delivered on 4th frame");
+    }
+    for (size_t p = 0; ok && p < NUM_PIXELS; ++p)
+        ok = Check(frame[p] == (uint16_t)(250 + p), "mean: value");
+
+    DestroyFrameAverager(&avg);
+    return ok;
+}
+
+// Fed a constant scene, the Kalman estimate converges to it, and the error
+// variance settles at the fixed point of the predict/update recursion
+static bool RunKalman(double noiseVariance, double *steadyGain) {
+    struct FrameAverager avg;
+    InitializeFrameAverager(&avg);
+    avg.mode = FrameAveragingMode_Kalman;
+    avg.kalmanGain = 0.8;
+    avg.kalmanNoiseVariance = noiseVariance;
+    avg.kalmanProcessVariance = 0.01;
+    OScDev_RichError *err = ResetFrameAverager(&avg, 1, NUM_PIXELS);
+    bool ok = Check(!err, "kalman: reset");
+
+    uint16_t frame[NUM_PIXELS];
+    uint16_t *frames[1] = {frame};
+    for (int i = 0; ok && i < 200; ++i) {
+        // Alternate around 1000 at first, then hold steady
+        for (size_t p = 0; p < NUM_PIXELS; ++p)
+            frame[p] = (uint16_t)(i < 20 ? 1000 + (i % 2 ? 50 : -50) : 1000);
+        ok = Check(AccumulateFrame(&avg, frames), "kalman: delivered");
+    }
+    for (size_t p = 0; ok && p < NUM_PIXELS; ++p)
+        ok = Check(frame[p] == 1000, "kalman: converges to the scene");
+
+    // x = predicted variance at the fixed point: x^2 = Q x + Q R
+    double q = avg.kalmanProcessVariance;
+    double r = noiseVariance;
+    double x = (q + sqrt(q * q + 4.0 * q * r)) / 2.0;
+    double expected = x * r / (x + r);
+    ok = ok && Check(fabs(avg.kalmanVariance - expected) < 1e-9,
+                     "kalman: steady-state variance");
+    *steadyGain = x / (x + r);
+
+    DestroyFrameAverager(&avg);
+    return ok;
+}
+
+static bool TestKalman(void) {
+    double lowNoiseGain, highNoiseGain;
+    bool ok = RunKalman(0.01, &lowNoiseGain);
+    ok = RunKalman(0.5, &highNoiseGain) && ok;
+    // More noise must mean trusting the observations less
+    return ok && Check(highNoiseGain < lowNoiseGain - 0.1,
+                       "kalman: gain depends on noise variance");
+}
+
+int main(void) {
+    bool ok = TestMean();
+    ok = TestKalman() && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,120 @@
+#include "../src/FrameCompression.h"
+
+#include "Check.h"
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Not a multiple of COMPRESSION_LINES_PER_BLOCK, so the last block is short
+#define WIDTH 100
+#define HEIGHT 37
+#define NUM_PIXELS (WIDTH * HEIGHT)
+
+enum Pattern {
+    Pattern_Constant,
+    Pattern_Gradient,
+    Pattern_Noise12Bit,
+    Pattern_Noise16Bit, // Mostly escaped residuals
+    NumPatterns,
+};
+
+static const char *const patternNames[] = {
+    "constant",
+    "gradient",
+    "12-bit noise",
+    "16-bit noise",
+};
+
+static void FillFrame(uint16_t *pixels, enum Pattern pattern, uint32_t seed) {
+    for (uint32_t y = 0; y < HEIGHT; ++y) {
+        for (uint32_t x = 0; x < WIDTH; ++x) {
+            uint16_t *pixel = &pixels[(size_t)y * WIDTH + x];
+            seed = seed * 1664525u + 1013904223u;
+            switch (pattern) {
+            case Pattern_Constant:
+                *pixel = 4321;
+                break;
+            case Pattern_Gradient:
+                *pixel = (uint16_t)(1000 + 37 * x + 11 * y + (seed >> 30));
+                break;
+            case Pattern_Noise12Bit:
+                *pixel = (uint16_t)(seed >> 20);
+                break;
+            default:
+                *pixel = (uint16_t)(seed >> 16);
+                break;
+            }
+        }
+    }
+}
+
+// Compress a series of frames of each pattern in turn and decode each back
+static bool TestRoundTrip(uint32_t numThreads) {
+    uint16_t *pixels = malloc(sizeof(uint16_t) * NUM_PIXELS);
+    uint16_t *decoded = malloc(sizeof(uint16_t) * NUM_PIXELS);
+    if (!Check(pixels && decoded, "allocate frames")) {
+        free(pixels);
+        free(decoded);
+        return false;
+    }
+
+    struct FrameCompressor comp;
+    InitializeFrameCompressor(&comp);
+    comp.enabled = true;
+    comp.numThreads = numThreads;
+    OScDev_RichError *err = StartFrameCompressor(&comp, WIDTH, HEIGHT);
+    bool ok = Check(!err, "start");
+    if (err)
+        OScDev_Error_Destroy(err);
+
+    for (uint32_t frame = 0; ok && frame < 3 * NumPatterns; ++frame) {
+        enum Pattern pattern = (enum Pattern)(frame % NumPatterns);
+        char what[64];
+        snprintf(what, sizeof(what), "%s, frame %u, %u threads",
+                 patternNames[pattern], (unsigned)frame,
+                 (unsigned)numThreads);
+
+        FillFrame(pixels, pattern, frame + 1);
+        CompressFrame(&comp, pixels, frame, frame % 2);
+
+        struct CompressedFrameHeader header;
+        memcpy(&header, comp.output, sizeof(header));
+        ok = Check(header.frame == frame && header.channel == frame % 2 &&
+                       header.width == WIDTH && header.height == HEIGHT,
+                   "header");
+
+        memset(decoded, 0, sizeof(uint16_t) * NUM_PIXELS);
+        ok = ok && Check(DecompressFrame(comp.output, comp.outputSize,
+                                         decoded, NUM_PIXELS),
+                         "decompress");
+        ok = ok && Check(memcmp(decoded, pixels,
+                                sizeof(uint16_t) * NUM_PIXELS) == 0,
+                         what);
+
+        // Truncated data must be rejected rather than read past the end
+        ok = ok && Check(!DecompressFrame(comp.output, comp.outputSize - 1,
+                                          decoded, NUM_PIXELS),
+                         "reject truncated frame");
+    }
+    ok = ok && Check(!DecompressFrame(comp.output, comp.outputSize, decoded,
+                                      NUM_PIXELS - 1),
+                     "reject frame larger than buffer");
+
+    StopFrameCompressor(&comp);
+    DestroyFrameCompressor(&comp);
+    free(pixels);
+    free(decoded);
+    return ok;
+}
+
+int main(void) {
+    bool ok = TestRoundTrip(1);
+    ok = TestRoundTrip(4) && ok;
+    ok = TestRoundTrip(COMPRESSION_MAX_THREADS) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
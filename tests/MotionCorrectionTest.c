@@ -0,0 +1,102 @@
+#include "../src/MotionCorrection.h"
+
+#include "Check.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIDTH 256
+#define HEIGHT 192
+#define NUM_BLOBS 300
+
+// Textured scene of many small Gaussian blobs at pseudo-random positions,
+// moved by (dx, dy)
+
+static void RenderScene(uint16_t *frame, double dx, double dy) {
+    for (size_t p = 0; p < (size_t)WIDTH * HEIGHT; ++p)
+        frame[p] = 1000;
+    uint32_t seed = 12345;
+    for (int b = 0; b < NUM_BLOBS; ++b) {
+        double params[4];
+        for (int i = 0; i < 4; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            params[i] = (seed >> 8) / 16777216.0;
+        }
+        double cx = params[0] * WIDTH + dx;
+        double cy = params[1] * HEIGHT + dy;
+        double r = 1.5 + 2.5 * params[2];
+        double brightness = 2000.0 + 8000.0 * params[3];
+        int reach = (int)ceil(4.0 * r);
+        for (int y = (int)cy - reach; y <= (int)cy + reach; ++y) {
+            if (y < 0 || y >= HEIGHT)
+                continue;
+            for (int x = (int)cx - reach; x <= (int)cx + reach; ++x) {
+                if (x < 0 || x >= WIDTH)
+                    continue;
+                double ex = x - cx, ey = y - cy;
+                double v =
+                    brightness * exp(-(ex * ex + ey * ey) / (2.0 * r * r));
+                uint16_t *pixel = &frame[(size_t)y * WIDTH + x];
+                *pixel = (uint16_t)fmin(65535.0, *pixel + v + 0.5);
+            }
+        }
+    }
+}
+
+// Register a copy of the scene moved by (dx, dy) against the original
+static bool TestShift(uint32_t downsample, double dx, double dy) {
+    char what[64];
+    snprintf(what, sizeof(what), "shift (%g, %g) at downsample %u", dx, dy,
+             (unsigned)downsample);
+
+    uint16_t *frame = malloc(sizeof(uint16_t) * WIDTH * HEIGHT);
+    if (!Check(frame != NULL, "allocate frame"))
+        return false;
+
+    struct MotionCorrection mc;
+    InitializeMotionCorrection(&mc);
+    mc.enabled = true;
+    mc.downsample = downsample;
+    bool ok = Check(StartMotionCorrection(&mc, WIDTH, HEIGHT), "start");
+
+    struct MotionShift shift = {0};
+    if (ok) {
+        RenderScene(frame, 0.0, 0.0);
+        SubmitMotionFrame(&mc, frame, 0);
+        ok = Check(CollectMotionShift(&mc, &shift), "collect reference");
+    }
+    if (ok) {
+        RenderScene(frame, dx, dy);
+        SubmitMotionFrame(&mc, frame, 1);
+        ok = Check(CollectMotionShift(&mc, &shift), "collect shift");
+    }
+    if (ok) {
+        double tolerance = 0.5 * downsample;
+        ok = Check(shift.frame == 1, "frame index");
+        if (!Check(fabs(shift.dx - dx) <= tolerance &&
+                       fabs(shift.dy - dy) <= tolerance,
+                   what)) {
+            fprintf(stderr, "  got (%g, %g)\n", shift.dx, shift.dy);
+            ok = false;
+        }
+        ok = ok && Check(shift.peak > 0.0 && shift.peak <= 1.0, "peak");
+    }
+
+    StopMotionCorrection(&mc);
+    DestroyMotionCorrection(&mc);
+    free(frame);
+    return ok;
+}
+
+int main(void) {
+    bool ok = TestShift(1, 0.0, 0.0);
+    ok = TestShift(1, 5.0, -3.0) && ok;
+    ok = TestShift(1, -7.4, 2.6) && ok;
+    ok = TestShift(2, 12.0, 6.0) && ok;
+    ok = TestShift(2, -9.0, 5.0) && ok;
+    ok = TestShift(4, -16.0, 8.0) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
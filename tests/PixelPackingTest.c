@@ -0,0 +1,64 @@
+#include "../src/PixelPacking.h"
+
+#include "Check.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_VALUES 4096
+
+// Every 12-bit value, at both even and odd indices, comes back unchanged
+// regardless of the order in which the pixels are stored or what the
+// buffer held before
+static bool TestRoundTrip(bool reverse, uint8_t fill) {
+    // One extra pixel so that each value also lands at the other parity
+    enum { numPixels = NUM_VALUES + 1 };
+    uint8_t packed[(numPixels * 12 + 7) / 8];
+    memset(packed, fill, sizeof(packed));
+    for (size_t i = 0; i < numPixels; ++i) {
+        size_t p = reverse ? numPixels - 1 - i : i;
+        StorePacked12BitPixel(packed, p, (uint32_t)(p % NUM_VALUES));
+    }
+
+    bool ok = true;
+    for (size_t p = 0; ok && p < numPixels; ++p)
+        ok = Check(LoadPacked12BitPixel(packed, p) ==
+                       (uint16_t)(p % NUM_VALUES),
+                   reverse ? "round trip (reverse order)" : "round trip");
+    return ok;
+}
+
+// Overwriting one pixel leaves its neighbor sharing the middle byte intact
+static bool TestNeighbors(void) {
+    uint8_t packed[3] = {0};
+    bool ok = true;
+    for (uint32_t a = 0; ok && a < NUM_VALUES; a += 7) {
+        for (uint32_t b = 0; ok && b < NUM_VALUES; b += 13) {
+            StorePacked12BitPixel(packed, 0, a);
+            StorePacked12BitPixel(packed, 1, b);
+            ok = Check(LoadPacked12BitPixel(packed, 0) == (uint16_t)a &&
+                           LoadPacked12BitPixel(packed, 1) == (uint16_t)b,
+                       "neighbors");
+        }
+    }
+    return ok;
+}
+
+// The layout documented in PixelPacking.h
+static bool TestLayout(void) {
+    uint8_t packed[3];
+    StorePacked12BitPixel(packed, 0, 0xabc);
+    StorePacked12BitPixel(packed, 1, 0x123);
+    return Check(packed[0] == 0xbc && packed[1] == 0x3a && packed[2] == 0x12,
+                 "layout");
+}
+
+int main(void) {
+    bool ok = TestRoundTrip(false, 0x00);
+    ok = TestRoundTrip(true, 0xff) && ok;
+    ok = TestNeighbors() && ok;
+    ok = TestLayout() && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}